@@ -30,13 +30,12 @@
 static bool
 bloom_src(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 	uint32_t fold, addr;
 	__be32 mask;
 	char *mem;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -56,13 +55,12 @@ bloom_src(arguments_t args, struct qbuff * buff)
 static bool
 bloom_dst(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 	uint32_t fold, addr;
 	__be32 mask;
 	char *mem;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -81,13 +79,12 @@ bloom_dst(arguments_t args, struct qbuff * buff)
 static bool
 bloom(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 	uint32_t fold, addr;
 	__be32 mask;
 	char *mem;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -205,6 +202,161 @@ static int bloom_init(arguments_t args)
 }
 
 
+/* ipv6: the address (masked with the prefix) is xor-folded to 32 bits
+ * and then hashed with the same functions used for ipv4 */
+
+static inline uint32_t
+bloom6_key(const struct in6_addr *addr, int prefix)
+{
+	struct in6_addr net;
+	ipv6_addr_prefix(&net, addr, prefix);
+	return ipv6_addr_hash(&net);
+}
+
+
+static inline bool
+bloom6_test(char *mem, uint32_t fold, const struct in6_addr *addr, int prefix)
+{
+	uint32_t key = bloom6_key(addr, prefix);
+
+	return ( BF_TEST(mem, hfun1(key) & fold) &&
+	         BF_TEST(mem, hfun2(key) & fold) &&
+	         BF_TEST(mem, hfun3(key) & fold) &&
+	         BF_TEST(mem, hfun4(key) & fold) );
+}
+
+
+static bool
+bloom6_src(arguments_t args, struct qbuff * buff)
+{
+	const struct ipv6hdr *ip6;
+
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
+		return false;
+
+	return bloom6_test(GET_ARG_1(char *, args), GET_ARG_0(uint32_t, args), &ip6->saddr, GET_ARG_2(int, args));
+}
+
+
+static bool
+bloom6_dst(arguments_t args, struct qbuff * buff)
+{
+	const struct ipv6hdr *ip6;
+
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
+		return false;
+
+	return bloom6_test(GET_ARG_1(char *, args), GET_ARG_0(uint32_t, args), &ip6->daddr, GET_ARG_2(int, args));
+}
+
+
+static bool
+bloom6(arguments_t args, struct qbuff * buff)
+{
+	const struct ipv6hdr *ip6;
+	uint32_t fold;
+	char *mem;
+	int prefix;
+
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
+		return false;
+
+	fold   = GET_ARG_0(uint32_t, args);
+	mem    = GET_ARG_1(char *,   args);
+	prefix = GET_ARG_2(int,      args);
+
+	if ((buff->monad->ep_ctx & EPOINT_DST) && bloom6_test(mem, fold, &ip6->daddr, prefix))
+		return true;
+
+	if ((buff->monad->ep_ctx & EPOINT_SRC) && bloom6_test(mem, fold, &ip6->saddr, prefix))
+		return true;
+
+	return false;
+}
+
+
+static ActionQbuff
+bloom6_filter(arguments_t args, struct qbuff * buff)
+{
+	if (bloom6(args, buff))
+		return Pass(buff);
+	return Drop(buff);
+}
+
+
+static ActionQbuff
+bloom6_src_filter(arguments_t args, struct qbuff * buff)
+{
+	if (bloom6_src(args, buff))
+		return Pass(buff);
+	return Drop(buff);
+}
+
+static ActionQbuff
+bloom6_dst_filter(arguments_t args, struct qbuff * buff)
+{
+	if (bloom6_dst(args, buff))
+		return Pass(buff);
+	return Drop(buff);
+}
+
+
+static int bloom6_init(arguments_t args)
+{
+	unsigned int m = GET_ARG_0(unsigned int, args);
+	size_t n = LEN_ARRAY_1(args);
+	struct in6_addr *ips = GET_ARRAY_1(struct in6_addr, args);
+	int prefix = clamp(GET_ARG_2(int, args), 0, 128);
+	size_t i;
+
+	char *mem;
+
+	m = clp2(m);
+
+	/* set bloom filter fold mask */
+
+	SET_ARG_0(args, m-1);
+
+	if (m > (1UL << 24)) {
+		printk(KERN_INFO "[PFQ|init] bloom6 filter: maximum number of bins exceeded (2^24)!\n");
+		return -EPERM;
+	}
+
+	mem = kzalloc(m >> 3, GFP_KERNEL);
+	if (!mem) {
+		printk(KERN_INFO "[PFQ|init] bloom6 filter: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	/* set bloom filter memory */
+
+	SET_ARG_1(args, mem);
+
+	/* set (clamped) network prefix */
+
+	SET_ARG_2(args, prefix);
+
+	pr_devel("[PFQ|init] bloom6 filter@%p: k=4, n=%zu, m=%u size=%u prefix=%d bytes.\n", mem, n, m, m>>3, prefix);
+
+	for(i = 0; i < n; i++)
+	{
+		uint32_t key = bloom6_key(ips+i, prefix);
+
+		BF_SET(mem, hfun1(key) & (m-1));
+		BF_SET(mem, hfun2(key) & (m-1));
+		BF_SET(mem, hfun3(key) & (m-1));
+		BF_SET(mem, hfun4(key) & (m-1));
+
+		pr_devel("[PFQ|init] bloom6 filter: -> set address %pI6c\n", ips+i);
+	}
+
+	return 0;
+}
+
+
 static int bloom_fini(arguments_t args)
 {
 	char *mem = GET_ARG_1(char *, args);
@@ -224,5 +376,12 @@ struct pfq_lang_function_descr bloom_functions[] = {
 	{"bloom_filter",	"CInt -> [Word32] -> CInt -> Qbuff -> Action Qbuff",	bloom_filter,		bloom_init,	bloom_fini},
 	{"bloom_src_filter",	"CInt -> [Word32] -> CInt -> Qbuff -> Action Qbuff",	bloom_src_filter,	bloom_init,	bloom_fini},
 	{"bloom_dst_filter",	"CInt -> [Word32] -> CInt -> Qbuff -> Action Qbuff",	bloom_dst_filter,	bloom_init,	bloom_fini},
+
+	{"bloom6",		"CInt -> [IPv6] -> CInt -> Qbuff -> Bool",		bloom6,			bloom6_init,	bloom_fini},
+	{"bloom6_src",		"CInt -> [IPv6] -> CInt -> Qbuff -> Bool",		bloom6_src,		bloom6_init,	bloom_fini},
+	{"bloom6_dst",		"CInt -> [IPv6] -> CInt -> Qbuff -> Bool",		bloom6_dst,		bloom6_init,	bloom_fini},
+	{"bloom6_filter",	"CInt -> [IPv6] -> CInt -> Qbuff -> Action Qbuff",	bloom6_filter,		bloom6_init,	bloom_fini},
+	{"bloom6_src_filter",	"CInt -> [IPv6] -> CInt -> Qbuff -> Action Qbuff",	bloom6_src_filter,	bloom6_init,	bloom_fini},
+	{"bloom6_dst_filter",	"CInt -> [IPv6] -> CInt -> Qbuff -> Action Qbuff",	bloom6_dst_filter,	bloom6_init,	bloom_fini},
 	{ NULL }};
 
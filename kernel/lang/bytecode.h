@@ -0,0 +1,122 @@
+/***************************************************************
+ *
+ * (C) 2011-16 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#ifndef PFQ_LANG_BYTECODE_H
+#define PFQ_LANG_BYTECODE_H
+
+#include <linux/types.h>
+
+/*
+ * pfq-lang bytecode: computation trees are lowered by the engine into a flat
+ * array of instructions. Built-in filters and predicates have their own
+ * opcode, combinators and control functions are turned into short-circuit
+ * jumps, any other function is called through op_function/op_predicate.
+ */
+
+enum pfq_lang_opcode
+{
+	op_none = 0,		/* not a built-in: called through its pointer */
+
+	/* control flow */
+
+	op_halt,
+	op_jump,
+	op_jump_if_true,
+	op_jump_if_false,
+
+	/* generic calls */
+
+	op_function,
+	op_predicate,
+
+	/* filters: drop the qbuff if the condition is false (or true) */
+
+	op_filter,
+	op_filter_not,
+
+	/* built-in predicates (set the condition) */
+
+	op_is_ip,
+	op_is_udp,
+	op_is_tcp,
+	op_is_icmp,
+	op_is_flow,
+	op_has_vlan,
+	op_is_frag,
+	op_is_first_frag,
+	op_is_more_frag,
+	op_is_broadcast,
+	op_is_multicast,
+	op_is_ip_host,
+	op_is_ip_broadcast,
+	op_is_ip_multicast,
+	op_is_incoming_host,
+	op_is_l3_proto,
+	op_is_l4_proto,
+	op_has_port,
+	op_has_src_port,
+	op_has_dst_port,
+	op_has_addr,
+	op_has_src_addr,
+	op_has_dst_addr,
+	op_has_vid,
+	op_has_mark,
+	op_has_state,
+	op_not,
+
+	/* pseudo opcodes: lowered by the compiler, never executed */
+
+	op_unit,
+	op_and,
+	op_or,
+	op_conditional,
+	op_when,
+	op_unless,
+
+	op_max
+};
+
+
+/* kind of built-in function (how a predicate opcode is lowered) */
+
+#define PFQ_LANG_PREDICATE	0
+#define PFQ_LANG_FILTER		1	/* Qbuff -> Action Qbuff: drop if false */
+#define PFQ_LANG_FILTER_NOT	2	/* Qbuff -> Action Qbuff: drop if true */
+
+
+struct pfq_lang_functional;
+
+struct pfq_lang_insn
+{
+	struct pfq_lang_functional  *fun;	/* function/predicate and its arguments */
+	struct pfq_lang_insn const  *target;	/* jump target */
+	int			     opcode;
+};
+
+
+/* upper bound of the code length for a computation of n functions */
+
+#define PFQ_LANG_CODE_LEN(n)	(4*(n) + 1)
+
+
+#endif /* PFQ_LANG_BYTECODE_H */
@@ -26,6 +26,9 @@
 #include <lang/symtable.h>
 #include <lang/signature.h>
 #include <lang/module.h>
+#include <lang/bytecode.h>
+#include <lang/predicate.h>
+#include <lang/types.h>
 
 #include <pfq/global.h>
 #include <pfq/printk.h>
@@ -54,6 +57,106 @@ pfq_lang_signature_by_user_symbol(const char __user *symb)
 }
 
 
+/* built-in functions known to the bytecode compiler */
+
+static struct pfq_lang_builtin
+{
+	const char *	symbol;
+	int		opcode;
+	int		kind;
+
+} pfq_lang_builtins[] =
+{
+	/* filters */
+
+	{ "unit",		op_unit,		PFQ_LANG_FILTER     },
+	{ "ip",			op_is_ip,		PFQ_LANG_FILTER     },
+	{ "udp",		op_is_udp,		PFQ_LANG_FILTER     },
+	{ "tcp",		op_is_tcp,		PFQ_LANG_FILTER     },
+	{ "icmp",		op_is_icmp,		PFQ_LANG_FILTER     },
+	{ "flow",		op_is_flow,		PFQ_LANG_FILTER     },
+	{ "vlan",		op_has_vlan,		PFQ_LANG_FILTER     },
+	{ "no_frag",		op_is_frag,		PFQ_LANG_FILTER_NOT },
+	{ "no_more_frag",	op_is_more_frag,	PFQ_LANG_FILTER_NOT },
+	{ "port",		op_has_port,		PFQ_LANG_FILTER     },
+	{ "src_port",		op_has_src_port,	PFQ_LANG_FILTER     },
+	{ "dst_port",		op_has_dst_port,	PFQ_LANG_FILTER     },
+	{ "addr",		op_has_addr,		PFQ_LANG_FILTER     },
+	{ "src_addr",		op_has_src_addr,	PFQ_LANG_FILTER     },
+	{ "dst_addr",		op_has_dst_addr,	PFQ_LANG_FILTER     },
+	{ "l3_proto",		op_is_l3_proto,		PFQ_LANG_FILTER     },
+	{ "l4_proto",		op_is_l4_proto,		PFQ_LANG_FILTER     },
+	{ "filter",		op_filter,		PFQ_LANG_FILTER     },
+	{ "mac_broadcast",	op_is_broadcast,	PFQ_LANG_FILTER_NOT },
+	{ "mac_multicast",	op_is_multicast,	PFQ_LANG_FILTER_NOT },
+	{ "incoming_host",	op_is_incoming_host,	PFQ_LANG_FILTER_NOT },
+	{ "ip_host",		op_is_ip_host,		PFQ_LANG_FILTER_NOT },
+	{ "ip_broadcast",	op_is_ip_broadcast,	PFQ_LANG_FILTER_NOT },
+	{ "ip_multicast",	op_is_ip_multicast,	PFQ_LANG_FILTER_NOT },
+
+	/* predicates */
+
+	{ "is_ip",		op_is_ip,		PFQ_LANG_PREDICATE  },
+	{ "is_tcp",		op_is_tcp,		PFQ_LANG_PREDICATE  },
+	{ "is_udp",		op_is_udp,		PFQ_LANG_PREDICATE  },
+	{ "is_icmp",		op_is_icmp,		PFQ_LANG_PREDICATE  },
+	{ "is_flow",		op_is_flow,		PFQ_LANG_PREDICATE  },
+	{ "has_vlan",		op_has_vlan,		PFQ_LANG_PREDICATE  },
+	{ "is_frag",		op_is_frag,		PFQ_LANG_PREDICATE  },
+	{ "is_first_frag",	op_is_first_frag,	PFQ_LANG_PREDICATE  },
+	{ "is_more_frag",	op_is_more_frag,	PFQ_LANG_PREDICATE  },
+	{ "is_l3_proto",	op_is_l3_proto,		PFQ_LANG_PREDICATE  },
+	{ "is_l4_proto",	op_is_l4_proto,		PFQ_LANG_PREDICATE  },
+	{ "has_port",		op_has_port,		PFQ_LANG_PREDICATE  },
+	{ "has_src_port",	op_has_src_port,	PFQ_LANG_PREDICATE  },
+	{ "has_dst_port",	op_has_dst_port,	PFQ_LANG_PREDICATE  },
+	{ "has_vid",		op_has_vid,		PFQ_LANG_PREDICATE  },
+	{ "has_mark",		op_has_mark,		PFQ_LANG_PREDICATE  },
+	{ "has_state",		op_has_state,		PFQ_LANG_PREDICATE  },
+	{ "has_addr",		op_has_addr,		PFQ_LANG_PREDICATE  },
+	{ "has_src_addr",	op_has_src_addr,	PFQ_LANG_PREDICATE  },
+	{ "has_dst_addr",	op_has_dst_addr,	PFQ_LANG_PREDICATE  },
+	{ "is_broadcast",	op_is_broadcast,	PFQ_LANG_PREDICATE  },
+	{ "is_multicast",	op_is_multicast,	PFQ_LANG_PREDICATE  },
+	{ "is_incoming_host",	op_is_incoming_host,	PFQ_LANG_PREDICATE  },
+	{ "is_ip_host",		op_is_ip_host,		PFQ_LANG_PREDICATE  },
+	{ "is_ip_broadcast",	op_is_ip_broadcast,	PFQ_LANG_PREDICATE  },
+	{ "is_ip_multicast",	op_is_ip_multicast,	PFQ_LANG_PREDICATE  },
+
+	/* combinators */
+
+	{ "and",		op_and,			PFQ_LANG_PREDICATE  },
+	{ "or",			op_or,			PFQ_LANG_PREDICATE  },
+	{ "not",		op_not,			PFQ_LANG_PREDICATE  },
+
+	/* control */
+
+	{ "conditional",	op_conditional,		PFQ_LANG_PREDICATE  },
+	{ "when",		op_when,		PFQ_LANG_PREDICATE  },
+	{ "unless",		op_unless,		PFQ_LANG_PREDICATE  },
+
+	{ NULL }
+};
+
+
+static int
+pfq_lang_builtin_opcode(const char *symbol, int *kind)
+{
+	struct pfq_lang_builtin const *b;
+
+	for(b = pfq_lang_builtins; b->symbol; b++)
+	{
+		if (!strcmp(b->symbol, symbol)) {
+			*kind = b->kind;
+			return b->opcode;
+		}
+	}
+
+	*kind = PFQ_LANG_PREDICATE;
+	return op_none;
+}
+
+
 static void *
 pod_memory_get(void **ptr, size_t size)
 {
@@ -139,27 +242,391 @@ strdup_user(const char __user *str)
 }
 
 
-static inline ActionQbuff
-pfq_lang_bind(struct qbuff * buff, struct pfq_lang_functional_node *node)
+/*
+ * bytecode interpreter: threaded dispatch through a jump table, each
+ * instruction jumps directly to the handler of the next one...
+ */
+
+static ActionQbuff
+pfq_lang_exec(struct pfq_lang_insn const *pc, struct qbuff *buff)
+{
+	static void * const jumptable[op_max] =
+	{
+		[op_none ... op_max-1]	= &&op_invalid,
+
+		[op_halt]		= &&op_halt,
+		[op_jump]		= &&op_jump,
+		[op_jump_if_true]	= &&op_jump_if_true,
+		[op_jump_if_false]	= &&op_jump_if_false,
+		[op_function]		= &&op_function,
+		[op_predicate]		= &&op_predicate,
+		[op_filter]		= &&op_filter,
+		[op_filter_not]		= &&op_filter_not,
+		[op_is_ip]		= &&op_is_ip,
+		[op_is_udp]		= &&op_is_udp,
+		[op_is_tcp]		= &&op_is_tcp,
+		[op_is_icmp]		= &&op_is_icmp,
+		[op_is_flow]		= &&op_is_flow,
+		[op_has_vlan]		= &&op_has_vlan,
+		[op_is_frag]		= &&op_is_frag,
+		[op_is_first_frag]	= &&op_is_first_frag,
+		[op_is_more_frag]	= &&op_is_more_frag,
+		[op_is_broadcast]	= &&op_is_broadcast,
+		[op_is_multicast]	= &&op_is_multicast,
+		[op_is_ip_host]		= &&op_is_ip_host,
+		[op_is_ip_broadcast]	= &&op_is_ip_broadcast,
+		[op_is_ip_multicast]	= &&op_is_ip_multicast,
+		[op_is_incoming_host]	= &&op_is_incoming_host,
+		[op_is_l3_proto]	= &&op_is_l3_proto,
+		[op_is_l4_proto]	= &&op_is_l4_proto,
+		[op_has_port]		= &&op_has_port,
+		[op_has_src_port]	= &&op_has_src_port,
+		[op_has_dst_port]	= &&op_has_dst_port,
+		[op_has_addr]		= &&op_has_addr,
+		[op_has_src_addr]	= &&op_has_src_addr,
+		[op_has_dst_addr]	= &&op_has_dst_addr,
+		[op_has_vid]		= &&op_has_vid,
+		[op_has_mark]		= &&op_has_mark,
+		[op_has_state]		= &&op_has_state,
+		[op_not]		= &&op_not,
+	};
+
+	bool cond = false;
+
+#define DISPATCH()	goto *jumptable[pc->opcode]
+#define NEXT()		do { pc++; DISPATCH(); } while(0)
+
+	DISPATCH();
+
+op_jump:
+	pc = pc->target;
+	DISPATCH();
+op_jump_if_true:
+	if (cond) {
+		pc = pc->target;
+		DISPATCH();
+	}
+	NEXT();
+op_jump_if_false:
+	if (!cond) {
+		pc = pc->target;
+		DISPATCH();
+	}
+	NEXT();
+
+op_function:
+	buff = ((function_ptr_t)pc->fun->run)(pc->fun, buff).qbuff;
+	if (!buff || is_drop(buff->monad->fanout))
+		return Pass(buff);
+	NEXT();
+op_predicate:
+	cond = ((predicate_ptr_t)pc->fun->run)(pc->fun, buff);
+	NEXT();
+
+op_filter:
+	if (!cond)
+		return Drop(buff);
+	NEXT();
+op_filter_not:
+	if (cond)
+		return Drop(buff);
+	NEXT();
+
+op_is_ip:		cond = is_ip(buff);		NEXT();
+op_is_udp:		cond = is_udp(buff);		NEXT();
+op_is_tcp:		cond = is_tcp(buff);		NEXT();
+op_is_icmp:		cond = is_icmp(buff);		NEXT();
+op_is_flow:		cond = is_flow(buff);		NEXT();
+op_has_vlan:		cond = has_vlan(buff);		NEXT();
+op_is_frag:		cond = is_frag(buff);		NEXT();
+op_is_first_frag:	cond = is_first_frag(buff);	NEXT();
+op_is_more_frag:	cond = is_more_frag(buff);	NEXT();
+op_is_broadcast:	cond = is_broadcast(buff);	NEXT();
+op_is_multicast:	cond = is_multicast(buff);	NEXT();
+op_is_ip_host:		cond = is_ip_host(buff);	NEXT();
+op_is_ip_broadcast:	cond = is_ip_broadcast(buff);	NEXT();
+op_is_ip_multicast:	cond = is_ip_multicast(buff);	NEXT();
+op_is_incoming_host:	cond = is_incoming_host(buff);	NEXT();
+
+op_is_l3_proto:		cond = is_l3_proto(buff, GET_ARG(uint16_t, pc->fun));	NEXT();
+op_is_l4_proto:		cond = is_l4_proto(buff, GET_ARG(uint8_t, pc->fun));	NEXT();
+op_has_port:		cond = has_port(buff, GET_ARG(uint16_t, pc->fun));	NEXT();
+op_has_src_port:	cond = has_src_port(buff, GET_ARG(uint16_t, pc->fun));	NEXT();
+op_has_dst_port:	cond = has_dst_port(buff, GET_ARG(uint16_t, pc->fun));	NEXT();
+op_has_vid:		cond = has_vid(buff, GET_ARG(int, pc->fun));		NEXT();
+op_has_mark:		cond = get_mark(buff) == GET_ARG(uint32_t, pc->fun);	NEXT();
+op_has_state:		cond = get_state(buff) == GET_ARG(uint32_t, pc->fun);	NEXT();
+
+op_has_addr: {
+	struct CIDR_ *data = GET_PTR_0(struct CIDR_, pc->fun);
+	cond = has_addr(buff, data->addr, data->mask);
+	NEXT();
+}
+op_has_src_addr: {
+	struct CIDR_ *data = GET_PTR_0(struct CIDR_, pc->fun);
+	cond = has_src_addr(buff, data->addr, data->mask);
+	NEXT();
+}
+op_has_dst_addr: {
+	struct CIDR_ *data = GET_PTR_0(struct CIDR_, pc->fun);
+	cond = has_dst_addr(buff, data->addr, data->mask);
+	NEXT();
+}
+
+op_not:
+	cond = !cond;
+	NEXT();
+
+op_invalid:
+	WARN_ONCE(1, "[PFQ] pfq-lang: invalid opcode %d!\n", pc->opcode);
+	return Drop(buff);
+
+op_halt:
+	return Pass(buff);
+
+#undef NEXT
+#undef DISPATCH
+}
+
+
+/*
+ * bytecode compiler: lower the linked computation tree into a flat array of
+ * instructions. Drops terminate the whole computation (as in the tree walk),
+ * hence the functions of a nested expression are inlined in sequence.
+ */
+
+struct pfq_lang_compiler
+{
+	struct pfq_lang_computation_tree *comp;
+	size_t len;
+	size_t cap;
+};
+
+
+static struct pfq_lang_insn *
+pfq_lang_emit(struct pfq_lang_compiler *cc, int opcode, struct pfq_lang_functional *fun)
+{
+	struct pfq_lang_insn *insn;
+
+	if (cc->len == cc->cap)
+		return NULL;
+
+	insn = &cc->comp->code[cc->len++];
+	insn->opcode = opcode;
+	insn->fun = fun;
+	insn->target = NULL;
+	return insn;
+}
+
+
+static inline struct pfq_lang_insn const *
+pfq_lang_label(struct pfq_lang_compiler *cc)
+{
+	return &cc->comp->code[cc->len];
+}
+
+
+static inline struct pfq_lang_functional_node *
+pfq_lang_node(struct pfq_lang_functional *fun)
 {
-	return EVAL_FUNCTION((function_t){&node->fun}, buff);
+	return container_of(fun, struct pfq_lang_functional_node, fun);
 }
 
 
-ActionQbuff
-pfq_lang_run(struct qbuff * buff, struct pfq_lang_computation_tree *prg)
+static int pfq_lang_compile_chain(struct pfq_lang_compiler *cc, struct pfq_lang_functional *fun, size_t depth, bool top);
+
+
+static int
+pfq_lang_compile_predicate(struct pfq_lang_compiler *cc, struct pfq_lang_functional *fun, size_t depth)
 {
-	return pfq_lang_bind(buff, prg->entry_point);
+	struct pfq_lang_functional_node *node = pfq_lang_node(fun);
+	struct pfq_lang_insn *jmp;
+
+	if (depth > cc->comp->size)
+		return -ELOOP;
+
+	switch(node->opcode)
+	{
+	case op_and:
+	case op_or: {
+		if (pfq_lang_compile_predicate(cc, GET_ARG_0(predicate_t, fun).fun, depth+1) < 0)
+			return -ENOSPC;
+		jmp = pfq_lang_emit(cc, node->opcode == op_and ? op_jump_if_false : op_jump_if_true, NULL);
+		if (!jmp)
+			return -ENOSPC;
+		if (pfq_lang_compile_predicate(cc, GET_ARG_1(predicate_t, fun).fun, depth+1) < 0)
+			return -ENOSPC;
+		jmp->target = pfq_lang_label(cc);
+		return 0;
+	}
+	case op_not: {
+		if (pfq_lang_compile_predicate(cc, GET_ARG_0(predicate_t, fun).fun, depth+1) < 0)
+			return -ENOSPC;
+		return pfq_lang_emit(cc, op_not, NULL) ? 0 : -ENOSPC;
+	}
+	default:
+		if (node->opcode >= op_is_ip && node->opcode < op_not)
+			return pfq_lang_emit(cc, node->opcode, fun) ? 0 : -ENOSPC;
+
+		return pfq_lang_emit(cc, op_predicate, fun) ? 0 : -ENOSPC;
+	}
+}
+
+
+static int
+pfq_lang_compile_function(struct pfq_lang_compiler *cc, struct pfq_lang_functional *fun, size_t depth)
+{
+	struct pfq_lang_functional_node *node = pfq_lang_node(fun);
+	struct pfq_lang_insn *jmp, *jmp2;
+
+	switch(node->opcode)
+	{
+	case op_unit:
+		return 0;
+
+	case op_filter: {
+		if (pfq_lang_compile_predicate(cc, GET_ARG_0(predicate_t, fun).fun, depth+1) < 0)
+			return -ENOSPC;
+		return pfq_lang_emit(cc, op_filter, NULL) ? 0 : -ENOSPC;
+	}
+
+	case op_conditional: {
+		if (pfq_lang_compile_predicate(cc, GET_ARG_0(predicate_t, fun).fun, depth+1) < 0)
+			return -ENOSPC;
+		if (!(jmp = pfq_lang_emit(cc, op_jump_if_false, NULL)))
+			return -ENOSPC;
+		if (pfq_lang_compile_chain(cc, GET_ARG_1(function_t, fun).fun, depth+1, false) < 0)
+			return -ENOSPC;
+		if (!(jmp2 = pfq_lang_emit(cc, op_jump, NULL)))
+			return -ENOSPC;
+		jmp->target = pfq_lang_label(cc);
+		if (pfq_lang_compile_chain(cc, GET_ARG_2(function_t, fun).fun, depth+1, false) < 0)
+			return -ENOSPC;
+		jmp2->target = pfq_lang_label(cc);
+		return 0;
+	}
+
+	case op_when:
+	case op_unless: {
+		if (pfq_lang_compile_predicate(cc, GET_ARG_0(predicate_t, fun).fun, depth+1) < 0)
+			return -ENOSPC;
+		if (!(jmp = pfq_lang_emit(cc, node->opcode == op_when ? op_jump_if_false : op_jump_if_true, NULL)))
+			return -ENOSPC;
+		if (pfq_lang_compile_chain(cc, GET_ARG_1(function_t, fun).fun, depth+1, false) < 0)
+			return -ENOSPC;
+		jmp->target = pfq_lang_label(cc);
+		return 0;
+	}
+
+	default:
+		if (node->opcode >= op_is_ip && node->opcode < op_not) {
+			if (!pfq_lang_emit(cc, node->opcode, fun))
+				return -ENOSPC;
+			return pfq_lang_emit(cc, node->kind == PFQ_LANG_FILTER_NOT ? op_filter_not : op_filter, NULL) ? 0 : -ENOSPC;
+		}
+
+		return pfq_lang_emit(cc, op_function, fun) ? 0 : -ENOSPC;
+	}
+}
+
+
+static int
+pfq_lang_compile_chain(struct pfq_lang_compiler *cc, struct pfq_lang_functional *fun, size_t depth, bool top)
+{
+	if (depth > cc->comp->size)
+		return -ELOOP;
+
+	for(; fun; fun = fun->next)
+	{
+		if (top)
+			pfq_lang_node(fun)->code = pfq_lang_label(cc);
+
+		if (pfq_lang_compile_function(cc, fun, depth) < 0)
+			return -ENOSPC;
+	}
+
+	return 0;
+}
+
+
+static int
+pfq_lang_compile(struct pfq_lang_computation_tree *comp)
+{
+	struct pfq_lang_compiler cc = { comp, 0, PFQ_LANG_CODE_LEN(comp->size) };
+	size_t n;
+
+	if (pfq_lang_compile_chain(&cc, &comp->entry_point->fun, 0, true) < 0 ||
+	    !pfq_lang_emit(&cc, op_halt, NULL)) {
+
+		/* too large (or cyclic): fall back to the tree evaluation */
+
+		for(n = 0; n < comp->size; n++)
+			comp->node[n].code = NULL;
+
+		comp->code_len = 0;
+		return -ENOSPC;
+	}
+
+	comp->code_len = cc.len;
+	return 0;
+}
+
+
+/*
+ * Run the computation over the qbuffs selected by mask: the leading functions
+ * of the kleisli chain that provide a batch implementation are evaluated
+ * stage by stage over the whole batch, the rest of the chain is evaluated
+ * per packet. On return, mask holds the qbuffs that survived the computation.
+ */
+
+void
+pfq_lang_run_batch(struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask, struct pfq_lang_computation_tree *prg)
+{
+	struct pfq_lang_functional *fun = &prg->entry_point->fun;
+	struct pfq_lang_insn const *code;
+	struct qbuff *buff;
+	size_t n;
+
+	/* batch stages */
+
+	while (fun) {
+		struct pfq_lang_functional_node *node = container_of(fun, struct pfq_lang_functional_node, fun);
+		if (!node->batch)
+			break;
+
+		node->batch(fun, buffs, mask);
+		fun = fun->next;
+	}
+
+	if (!fun)
+		return;
+
+	/* scalar stages */
+
+	code = container_of(fun, struct pfq_lang_functional_node, fun)->code;
+
+	for_each_qbuff_with_mask(mask, buffs, buff, n)
+	{
+		ActionQbuff a = likely(code) ? pfq_lang_exec(code, buff)
+					     : EVAL_FUNCTION((function_t){fun}, buff);
+
+		if (!a.qbuff || is_drop(a.qbuff->monad->fanout))
+			qbuff_mask_clear(mask, n);
+	}
 }
 
 
 struct pfq_lang_computation_tree *
 pfq_lang_computation_alloc (struct pfq_lang_computation_descr const *descr)
 {
-        struct pfq_lang_computation_tree * c = kzalloc(sizeof(size_t) + descr->size * sizeof(struct pfq_lang_functional_node),
+        struct pfq_lang_computation_tree * c = kzalloc(sizeof(struct pfq_lang_computation_tree) +
+						       descr->size * sizeof(struct pfq_lang_functional_node) +
+						       PFQ_LANG_CODE_LEN(descr->size) * sizeof(struct pfq_lang_insn),
 						  GFP_KERNEL);
-	if (c)
+	if (c) {
 		c->size = descr->size;
+		c->code = (struct pfq_lang_insn *)&c->node[descr->size];
+	}
 
         return c;
 }
@@ -396,7 +863,7 @@ pfq_lang_check_computation_descr(struct pfq_lang_computation_descr const *descr)
 
 static void *
 resolve_user_symbol(struct symtable *table, const char __user *symb, const char **signature,
-		    init_ptr_t *init, fini_ptr_t *fini)
+		    init_ptr_t *init, fini_ptr_t *fini, batch_ptr_t *batch, int *opcode, int *kind)
 {
 	struct symtable_entry *entry;
         char *symbol;
@@ -416,6 +883,8 @@ resolve_user_symbol(struct symtable *table, const char __user *symb, const char
         *signature = entry->signature;
 	*init = entry->init;
 	*fini = entry->fini;
+	*batch = entry->batch;
+	*opcode = pfq_lang_builtin_opcode(symbol, kind);
 
         kfree(symbol);
         return entry->function;
@@ -499,12 +968,14 @@ pfq_lang_computation_rtlink(struct pfq_lang_computation_descr const *descr, stru
 		struct pfq_lang_functional_node *next;
 		const char *signature;
 		init_ptr_t init, fini;
+		batch_ptr_t batch;
+		int opcode, kind;
 		void *addr;
                 size_t i;
 
                 fun = &descr->fun[n];
 
-		addr = resolve_user_symbol(&global->functions, fun->symbol, &signature, &init, &fini);
+		addr = resolve_user_symbol(&global->functions, fun->symbol, &signature, &init, &fini, &batch, &opcode, &kind);
 		if (addr == NULL) {
 			printk(KERN_INFO "[PFQ] %zu: rtlink: bad descriptor!\n", n);
 			return -EPERM;
@@ -514,6 +985,10 @@ pfq_lang_computation_rtlink(struct pfq_lang_computation_descr const *descr, stru
 
 		comp->node[n].init = init;
 		comp->node[n].fini = fini;
+		comp->node[n].batch = batch;
+		comp->node[n].opcode = opcode;
+		comp->node[n].kind = kind;
+		comp->node[n].code = NULL;
 
 		comp->node[n].fun.run  = addr;
                 comp->node[n].fun.next = next ? &next->fun : NULL;
@@ -623,6 +1098,13 @@ pfq_lang_computation_rtlink(struct pfq_lang_computation_descr const *descr, stru
 		}
 	}
 
+	/* lower the tree into bytecode */
+
+	if (pfq_lang_compile(comp) < 0)
+		printk(KERN_INFO "[PFQ] pfq_lang_computation_rtlink: bytecode too large, tree evaluation enabled.\n");
+	else
+		pr_devel("[PFQ] pfq_lang_computation_rtlink: %zu instructions.\n", comp->code_len);
+
 	return 0;
 }
 
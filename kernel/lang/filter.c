@@ -107,6 +107,38 @@ filter_dst_addr(arguments_t args, struct qbuff * b)
 	return has_dst_addr(b, data->addr, data->mask) ? Pass(b) : Drop(b);
 }
 
+static int filter_addr6_init(arguments_t args)
+{
+	struct CIDR6 *data;
+	CIDR6_INIT(args, 0);
+	data = GET_PTR_0(struct CIDR6, args);
+	pr_devel("[PFQ|init] filter: addr:%pI6c prefix:%d\n", &data->addr, data->prefix);
+	return 0;
+}
+
+
+static ActionQbuff
+filter_addr6(arguments_t args, struct qbuff * b)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	return has_addr6(b, &data->addr, data->prefix) ? Pass(b) : Drop(b);
+}
+
+
+static ActionQbuff
+filter_src_addr6(arguments_t args, struct qbuff * b)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	return has_src_addr6(b, &data->addr, data->prefix) ? Pass(b) : Drop(b);
+}
+
+static ActionQbuff
+filter_dst_addr6(arguments_t args, struct qbuff * b)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	return has_dst_addr6(b, &data->addr, data->prefix) ? Pass(b) : Drop(b);
+}
+
 static ActionQbuff
 filter_no_frag(arguments_t args, struct qbuff * b)
 {
@@ -159,36 +191,258 @@ filter_incoming_host(arguments_t args, struct qbuff * b)
 }
 
 
+/* batch implementations: the qbuffs that do not pass the filter are removed from the mask */
+
+static void
+batch_unit(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+}
+
+static void
+batch_filter_ip(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_ip(b));
+}
+
+static void
+batch_filter_ip6(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_ip6(b));
+}
+
+static void
+batch_filter_udp(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_udp(b));
+}
+
+static void
+batch_filter_tcp(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_tcp(b));
+}
+
+static void
+batch_filter_icmp(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_icmp(b));
+}
+
+static void
+batch_filter_icmp6(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_icmp6(b));
+}
+
+static void
+batch_filter_flow(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_flow(b));
+}
+
+static void
+batch_filter_vlan(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_vlan(b));
+}
+
+static void
+batch_filter_no_frag(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_frag(b));
+}
+
+static void
+batch_filter_no_more_frag(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_more_frag(b));
+}
+
+static void
+batch_filter_port(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	const uint16_t port = GET_ARG(uint16_t, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_port(b, port));
+}
+
+static void
+batch_filter_src_port(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	const uint16_t port = GET_ARG(uint16_t, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_src_port(b, port));
+}
+
+static void
+batch_filter_dst_port(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	const uint16_t port = GET_ARG(uint16_t, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_dst_port(b, port));
+}
+
+static void
+batch_filter_addr(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct CIDR_ *data = GET_PTR_0(struct CIDR_, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_addr(b, data->addr, data->mask));
+}
+
+static void
+batch_filter_src_addr(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct CIDR_ *data = GET_PTR_0(struct CIDR_, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_src_addr(b, data->addr, data->mask));
+}
+
+static void
+batch_filter_dst_addr(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct CIDR_ *data = GET_PTR_0(struct CIDR_, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_dst_addr(b, data->addr, data->mask));
+}
+
+static void
+batch_filter_addr6(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_addr6(b, &data->addr, data->prefix));
+}
+
+static void
+batch_filter_src_addr6(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_src_addr6(b, &data->addr, data->prefix));
+}
+
+static void
+batch_filter_dst_addr6(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, has_dst_addr6(b, &data->addr, data->prefix));
+}
+
+static void
+batch_filter_l3_proto(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	const uint16_t type = GET_ARG(uint16_t, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_l3_proto(b, type));
+}
+
+static void
+batch_filter_l4_proto(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	const uint8_t proto = GET_ARG(uint8_t, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, is_l4_proto(b, proto));
+}
+
+static void
+batch_filter_generic(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	predicate_t pred_ = GET_ARG(predicate_t, args);
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, EVAL_PREDICATE(pred_, b));
+}
+
+static void
+batch_filter_broadcast(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_broadcast(b));
+}
+
+static void
+batch_filter_multicast(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_multicast(b));
+}
+
+static void
+batch_filter_ip_broadcast(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_ip_broadcast(b));
+}
+
+static void
+batch_filter_ip_multicast(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_ip_multicast(b));
+}
+
+static void
+batch_filter_ip_host(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_ip_host(b));
+}
+
+static void
+batch_filter_incoming_host(arguments_t args, struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask *mask)
+{
+	struct qbuff *b;
+	BATCH_FILTER(buffs, mask, b, !is_incoming_host(b));
+}
+
+
 struct pfq_lang_function_descr filter_functions[] = {
 
-        { "unit",	  "Qbuff -> Action Qbuff",	unit		     , NULL, NULL   },
-        { "ip",           "Qbuff -> Action Qbuff",	filter_ip	     , NULL, NULL   },
-        { "udp",          "Qbuff -> Action Qbuff",	filter_udp	     , NULL, NULL   },
-        { "tcp",          "Qbuff -> Action Qbuff",	filter_tcp	     , NULL, NULL   },
-        { "icmp",         "Qbuff -> Action Qbuff",	filter_icmp	     , NULL, NULL   },
-        { "flow",         "Qbuff -> Action Qbuff",	filter_flow	     , NULL, NULL   },
-        { "vlan",         "Qbuff -> Action Qbuff",	filter_vlan	     , NULL, NULL   },
-	{ "no_frag",	  "Qbuff -> Action Qbuff",	filter_no_frag	     , NULL, NULL   },
-	{ "no_more_frag", "Qbuff -> Action Qbuff",	filter_no_more_frag  , NULL, NULL   },
-
-        { "port",	  "Word16 -> Qbuff -> Action Qbuff", filter_port     , NULL, NULL   },
-        { "src_port",	  "Word16 -> Qbuff -> Action Qbuff", filter_src_port , NULL, NULL   },
-        { "dst_port",	  "Word16 -> Qbuff -> Action Qbuff", filter_dst_port , NULL, NULL   },
-
-        { "addr",	  "CIDR -> Qbuff -> Action Qbuff", filter_addr     , filter_addr_init , NULL},
-        { "src_addr",	  "CIDR -> Qbuff -> Action Qbuff", filter_src_addr , filter_addr_init , NULL},
-        { "dst_addr",	  "CIDR -> Qbuff -> Action Qbuff", filter_dst_addr , filter_addr_init , NULL},
-
-	{ "l3_proto",     "Word16 -> Qbuff -> Action Qbuff",           filter_l3_proto , NULL, NULL},
-        { "l4_proto",     "Word8  -> Qbuff -> Action Qbuff",           filter_l4_proto , NULL, NULL},
-        { "filter",       "(Qbuff -> Bool) -> Qbuff -> Action Qbuff",  filter_generic  , NULL, NULL},
-
-	{ "mac_broadcast","Qbuff -> Action Qbuff",	filter_broadcast     , NULL, NULL  },
-	{ "mac_multicast","Qbuff -> Action Qbuff",	filter_multicast     , NULL, NULL  },
-	{ "incoming_host","Qbuff -> Action Qbuff",	filter_incoming_host , NULL, NULL  },
-	{ "ip_host",	  "Qbuff -> Action Qbuff",	filter_ip_host	     , NULL, NULL  },
-	{ "ip_broadcast", "Qbuff -> Action Qbuff",	filter_ip_broadcast  , NULL, NULL  },
-	{ "ip_multicast", "Qbuff -> Action Qbuff",	filter_ip_multicast  , NULL, NULL  },
+        { "unit",	  "Qbuff -> Action Qbuff",	unit		     , NULL, NULL, batch_unit		     },
+        { "ip",           "Qbuff -> Action Qbuff",	filter_ip	     , NULL, NULL, batch_filter_ip	     },
+        { "ip6",          "Qbuff -> Action Qbuff",	filter_ip6	     , NULL, NULL, batch_filter_ip6	     },
+        { "udp",          "Qbuff -> Action Qbuff",	filter_udp	     , NULL, NULL, batch_filter_udp	     },
+        { "tcp",          "Qbuff -> Action Qbuff",	filter_tcp	     , NULL, NULL, batch_filter_tcp	     },
+        { "icmp",         "Qbuff -> Action Qbuff",	filter_icmp	     , NULL, NULL, batch_filter_icmp	     },
+        { "icmp6",        "Qbuff -> Action Qbuff",	filter_icmp6	     , NULL, NULL, batch_filter_icmp6	     },
+        { "flow",         "Qbuff -> Action Qbuff",	filter_flow	     , NULL, NULL, batch_filter_flow	     },
+        { "vlan",         "Qbuff -> Action Qbuff",	filter_vlan	     , NULL, NULL, batch_filter_vlan	     },
+	{ "no_frag",	  "Qbuff -> Action Qbuff",	filter_no_frag	     , NULL, NULL, batch_filter_no_frag	     },
+	{ "no_more_frag", "Qbuff -> Action Qbuff",	filter_no_more_frag  , NULL, NULL, batch_filter_no_more_frag },
+
+        { "port",	  "Word16 -> Qbuff -> Action Qbuff", filter_port     , NULL, NULL, batch_filter_port	 },
+        { "src_port",	  "Word16 -> Qbuff -> Action Qbuff", filter_src_port , NULL, NULL, batch_filter_src_port },
+        { "dst_port",	  "Word16 -> Qbuff -> Action Qbuff", filter_dst_port , NULL, NULL, batch_filter_dst_port },
+
+        { "addr",	  "CIDR -> Qbuff -> Action Qbuff", filter_addr     , filter_addr_init , NULL, batch_filter_addr     },
+        { "src_addr",	  "CIDR -> Qbuff -> Action Qbuff", filter_src_addr , filter_addr_init , NULL, batch_filter_src_addr },
+        { "dst_addr",	  "CIDR -> Qbuff -> Action Qbuff", filter_dst_addr , filter_addr_init , NULL, batch_filter_dst_addr },
+
+        { "addr6",	  "CIDR6 -> Qbuff -> Action Qbuff", filter_addr6     , filter_addr6_init , NULL, batch_filter_addr6     },
+        { "src_addr6",	  "CIDR6 -> Qbuff -> Action Qbuff", filter_src_addr6 , filter_addr6_init , NULL, batch_filter_src_addr6 },
+        { "dst_addr6",	  "CIDR6 -> Qbuff -> Action Qbuff", filter_dst_addr6 , filter_addr6_init , NULL, batch_filter_dst_addr6 },
+
+	{ "l3_proto",     "Word16 -> Qbuff -> Action Qbuff",           filter_l3_proto , NULL, NULL, batch_filter_l3_proto },
+        { "l4_proto",     "Word8  -> Qbuff -> Action Qbuff",           filter_l4_proto , NULL, NULL, batch_filter_l4_proto },
+        { "filter",       "(Qbuff -> Bool) -> Qbuff -> Action Qbuff",  filter_generic  , NULL, NULL, batch_filter_generic  },
+
+	{ "mac_broadcast","Qbuff -> Action Qbuff",	filter_broadcast     , NULL, NULL, batch_filter_broadcast     },
+	{ "mac_multicast","Qbuff -> Action Qbuff",	filter_multicast     , NULL, NULL, batch_filter_multicast     },
+	{ "incoming_host","Qbuff -> Action Qbuff",	filter_incoming_host , NULL, NULL, batch_filter_incoming_host },
+	{ "ip_host",	  "Qbuff -> Action Qbuff",	filter_ip_host	     , NULL, NULL, batch_filter_ip_host	      },
+	{ "ip_broadcast", "Qbuff -> Action Qbuff",	filter_ip_broadcast  , NULL, NULL, batch_filter_ip_broadcast  },
+	{ "ip_multicast", "Qbuff -> Action Qbuff",	filter_ip_multicast  , NULL, NULL, batch_filter_ip_multicast  },
 
         { NULL }};
 
@@ -34,6 +34,12 @@ filter_ip(arguments_t args, struct qbuff * b)
         return is_ip(b) ? Pass(b) : Drop(b);
 }
 
+static inline ActionQbuff
+filter_ip6(arguments_t args, struct qbuff * b)
+{
+        return is_ip6(b) ? Pass(b) : Drop(b);
+}
+
 static inline ActionQbuff
 filter_udp(arguments_t args, struct qbuff * b)
 {
@@ -52,6 +58,12 @@ filter_icmp(arguments_t args, struct qbuff * b)
         return is_icmp(b) ? Pass(b) : Drop(b);
 }
 
+static inline ActionQbuff
+filter_icmp6(arguments_t args, struct qbuff * b)
+{
+        return is_icmp6(b) ? Pass(b) : Drop(b);
+}
+
 static inline ActionQbuff
 filter_flow(arguments_t args, struct qbuff * b)
 {
@@ -0,0 +1,73 @@
+/***************************************************************
+ *
+ * (C) 2011-16 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/random.h>
+
+#include <lang/hash.h>
+
+
+/* Toeplitz with a 16-bit periodic key: the 32-bit key window of each input
+ * byte only depends on the parity of its position, so the hash reduces to
+ * one table lookup per byte.
+ */
+
+static uint32_t pfq_toeplitz_table[2][256];
+
+u64 pfq_lang_hash_key;
+
+
+void pfq_lang_hash_init(void)
+{
+	const u64 key = 0x6d5a6d5a6d5a6d5aULL;
+	int p, b, k;
+
+	for(p = 0; p < 2; p++)
+	{
+		for(b = 0; b < 256; b++)
+		{
+			uint32_t v = 0;
+			for(k = 0; k < 8; k++)
+			{
+				if (b & (0x80 >> k))
+					v ^= (uint32_t)(key >> (32 - (p * 8 + k)));
+			}
+			pfq_toeplitz_table[p][b] = v;
+		}
+	}
+
+	get_random_bytes(&pfq_lang_hash_key, sizeof(pfq_lang_hash_key));
+}
+
+
+uint32_t
+pfq_lang_hash_toeplitz(const uint8_t *data, size_t len)
+{
+	uint32_t hash = 0;
+	size_t n;
+
+	for(n = 0; n < len; n++)
+		hash ^= pfq_toeplitz_table[n & 1][data[n]];
+
+	return hash;
+}
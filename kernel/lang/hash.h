@@ -0,0 +1,80 @@
+/***************************************************************
+ *
+ * (C) 2011-16 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#ifndef PFQ_LANG_HASH_H
+#define PFQ_LANG_HASH_H
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/pf_q.h>
+
+
+/* hash families used by steering functions (Q_STEER_HASH_*):
+ *
+ * xor:      saddr ^ daddr ^ sport ^ dport (legacy, weak)
+ * toeplitz: Toeplitz with the symmetric RSS key (0x6d5a repeated), as computed by NICs
+ * mix:      keyed multiply-xorshift, symmetric in the endpoints
+ */
+
+extern u64 pfq_lang_hash_key;
+
+
+extern void pfq_lang_hash_init(void);
+extern uint32_t pfq_lang_hash_toeplitz(const uint8_t *data, size_t len);
+
+
+static inline
+u64 pfq_lang_mix64(u64 x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+
+/* endpoints are ordered before mixing so that the hash is symmetric,
+ * extra (e.g. the l4 protocol) is spread by a golden ratio multiply */
+
+static inline
+uint32_t pfq_lang_hash_mix(u64 src, u64 dst, u64 extra)
+{
+	u64 lo = min(src, dst), hi = max(src, dst);
+	u64 h = pfq_lang_mix64(lo ^ pfq_lang_hash_key ^ (extra * 0x9e3779b97f4a7c15ULL));
+	h = pfq_lang_mix64(h ^ hi);
+	return (uint32_t)(h >> 32);
+}
+
+
+static inline
+bool pfq_lang_hash_valid(int family)
+{
+	return family == Q_STEER_HASH_XOR ||
+	       family == Q_STEER_HASH_TOEPLITZ ||
+	       family == Q_STEER_HASH_MIX;
+}
+
+
+#endif /* PFQ_LANG_HASH_H */
@@ -98,17 +98,16 @@ log_buff(arguments_t args, struct qbuff * buff)
 static void
 log_ip4_packet(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip)
 	{
 		switch(ip->protocol)
 		{
 		case IPPROTO_UDP: {
-			struct udphdr _udph; const struct udphdr *udp;
-			udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct udphdr), &_udph);
+			const struct udphdr *udp;
+			udp = qbuff_udphdr(buff);
 			if (udp)
 			{
 				printk(KERN_INFO "[pfq-lang] IP4 %pI4.%d > %pI4.%d: UDP\n",
@@ -121,8 +120,8 @@ log_ip4_packet(arguments_t args, struct qbuff * buff)
 			}
 		} break;
 		case IPPROTO_TCP: {
-			struct tcphdr _tcph; const struct tcphdr *tcp;
-			tcp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct tcphdr), &_tcph);
+			const struct tcphdr *tcp;
+			tcp = qbuff_tcphdr(buff);
 			if (tcp)
 			{
 				printk(KERN_INFO "[pfq-lang] IP4 %pI4.%d > %pI4.%d: TCP\n",
@@ -135,8 +134,8 @@ log_ip4_packet(arguments_t args, struct qbuff * buff)
 			}
 		} break;
 		case IPPROTO_ICMP: {
-			struct icmphdr _icmp; const struct icmphdr *icmp;
-			icmp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct icmphdr), &_icmp);
+			const struct icmphdr *icmp;
+			icmp = qbuff_icmphdr(buff);
                         if (icmp)
 			{
 				printk(KERN_INFO "[pfq-lang] IP4 %pI4 > %pI4: ICMP type=%d (code=%d)\n",
@@ -184,7 +183,7 @@ trace(arguments_t args, struct qbuff * buff)
 
 	if (printk_ratelimit())
 	{
-		printk(KERN_INFO "[pfq-lang] TRACE SKB: counter:%u fwd_mask:%lx (num_devs=%zu kernel:%d)\n"
+		printk(KERN_INFO "[pfq-lang] TRACE SKB: counter:%u fwd_mask:%lx (num_devs=%u kernel:%d)\n"
 					, buff->counter
 					, buff->fwd_mask
 					, buff->fwd_dev_num
@@ -26,6 +26,7 @@
 
 #include <lang/monad.h>
 #include <lang/maybe.h>
+#include <lang/bytecode.h>
 
 #include <pfq/sparse.h>
 #include <pfq/kcompat.h>
@@ -86,6 +87,19 @@
 #define LEN_ARRAY_7(a)		(ARGS_TYPE(a)->arg[7].nelem)
 #define LEN_ARRAY(a)		LEN_ARRAY_0(a)
 
+/* batch filter: clear the bit of the qbuffs that do not satisfy the predicate */
+
+#define BATCH_FILTER(buffs, mask, buff, pred) \
+	do { \
+		size_t __n; \
+		for_each_qbuff_with_mask(mask, buffs, buff, __n) \
+		{ \
+			if (!(pred)) \
+				qbuff_mask_clear(mask, __n); \
+		} \
+	} while(0)
+
+
 #define SAFE_CAST(v)		__builtin_choose_expr(sizeof(typeof(v)) <= sizeof(uintptr_t), v, (void)0)
 
 /**** generic functional type ****/
@@ -125,6 +139,7 @@ typedef uint64_t      (*property_ptr_t) (arguments_t, struct qbuff *);
 typedef bool	      (*predicate_ptr_t)(arguments_t, struct qbuff *);
 typedef int	      (*init_ptr_t)	(arguments_t);
 typedef int	      (*fini_ptr_t)	(arguments_t);
+typedef void	      (*batch_ptr_t)	(arguments_t, struct pfq_qbuff_queue *, struct pfq_qbuff_mask *);
 
 typedef struct
 {
@@ -154,6 +169,11 @@ struct pfq_lang_functional_node
 
 	init_ptr_t	      init;
 	fini_ptr_t	      fini;
+	batch_ptr_t	      batch;		/* batch implementation (optional) */
+
+	int		      opcode;		/* built-in opcode (op_none otherwise) */
+	int		      kind;		/* predicate, filter or filter_not */
+	struct pfq_lang_insn const *code;	/* entry in the bytecode (top-level functions only) */
 
 	bool		      initialized;
 };
@@ -163,6 +183,8 @@ struct pfq_lang_computation_tree
 {
 	size_t size;
 	struct pfq_lang_functional_node *entry_point;
+	size_t code_len;			/* 0 if the computation is not compiled */
+	struct pfq_lang_insn *code;
 	struct pfq_lang_functional_node node[];
 };
 
@@ -176,6 +198,7 @@ struct pfq_lang_function_descr
 	void *		ptr;
 	init_ptr_t	init;
 	fini_ptr_t	fini;
+	batch_ptr_t	batch;
 };
 
 /* class predicates */
@@ -31,6 +31,7 @@
 #include <pfq/sparse.h>
 #include <pfq/kcompat.h>
 #include <pfq/qbuff.h>
+#include <pfq/nethdr.h>
 
 /* The Action monad */
 
@@ -66,6 +67,39 @@ typedef struct
 #define EPOINT_SRC	(1<<0)
 #define EPOINT_DST	(1<<1)
 
+/* parsed headers: filled lazily (once per packet) by qbuff_headers() */
+
+struct pfq_lang_headers
+{
+	bool			parsed;
+	uint8_t			ipver;		/* 4, 6 or 0 (not ip) */
+	uint8_t			l4proto;	/* IPPROTO_* (IPPROTO_NONE if not available) */
+	__be16			l3proto;	/* ethertype */
+	__be16			frag_off;	/* ip fragment flags/offset (ipv4 layout, also for ipv6) */
+	uint16_t		vlan_tci;
+	int			l2len;
+	int			l3off;		/* offset of the (shifted) ip header, -1 if none */
+	int			l4off;		/* offset of the transport header, -1 if none */
+
+	const struct iphdr	*ip;		/* pointers into linear data (or to the copies below) */
+	const struct ipv6hdr	*ip6;
+	const void		*l4;		/* udp, tcp, icmp or icmpv6 header, NULL if not available */
+
+	union
+	{
+		struct iphdr	ip;
+		struct ipv6hdr	ip6;
+	} _l3;
+	union
+	{
+		struct udphdr	udp;
+		struct tcphdr	tcp;
+		struct icmphdr	icmp;
+		struct icmp6hdr icmp6;
+	} _l4;
+};
+
+
 /* Action monad */
 
 struct pfq_lang_monad
@@ -77,8 +111,34 @@ struct pfq_lang_monad
 	int			ipoff;
         int			ipproto;
         int			ep_ctx;		/* endpoint context */
+
+	struct pfq_lang_headers hdr;		/* header cache (shared by the groups) */
 };
 
+
+/* reset the monad for a new packet */
+
+static inline
+void pfq_lang_monad_reset(struct pfq_lang_monad *monad)
+{
+	monad->hdr.parsed = false;
+}
+
+/* setup the monad for a computation of the given group (the header cache is preserved) */
+
+static inline
+void pfq_lang_monad_init(struct pfq_lang_monad *monad, struct pfq_group *group)
+{
+	monad->fanout.class_mask = Q_CLASS_DEFAULT;
+	monad->fanout.type = fanout_copy;
+	monad->group = group;
+	monad->state = 0;
+	monad->shift = 0;
+	monad->ipoff = 0;
+	monad->ipproto = IPPROTO_NONE;
+	monad->ep_ctx = EPOINT_SRC | EPOINT_DST;
+}
+
 /* Fanout constructors */
 
 static inline
@@ -33,6 +33,12 @@ pred_is_ip(arguments_t args, struct qbuff * b)
         return  is_ip(b);
 }
 
+static bool
+pred_is_ip6(arguments_t args, struct qbuff * b)
+{
+        return  is_ip6(b);
+}
+
 static bool
 pred_is_udp(arguments_t args, struct qbuff * b)
 {
@@ -51,6 +57,12 @@ pred_is_icmp(arguments_t args, struct qbuff * b)
         return  is_icmp(b);
 }
 
+static bool
+pred_is_icmp6(arguments_t args, struct qbuff * b)
+{
+        return  is_icmp6(b);
+}
+
 static bool
 pred_is_flow(arguments_t args, struct qbuff * b)
 {
@@ -151,6 +163,38 @@ pred_has_dst_addr(arguments_t args, struct qbuff * b)
 	return has_dst_addr(b, data->addr, data->mask);
 }
 
+static int pred_addr6_init(arguments_t args)
+{
+	struct CIDR6 *data;
+	CIDR6_INIT(args, 0);
+	data = GET_PTR_0(struct CIDR6, args);
+	pr_devel("[PFQ|init] predicate: addr:%pI6c prefix:%d\n", &data->addr, data->prefix);
+	return 0;
+}
+
+
+static bool
+pred_has_addr6(arguments_t args, struct qbuff * b)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	return has_addr6(b, &data->addr, data->prefix);
+}
+
+
+static bool
+pred_has_src_addr6(arguments_t args, struct qbuff * b)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	return has_src_addr6(b, &data->addr, data->prefix);
+}
+
+static bool
+pred_has_dst_addr6(arguments_t args, struct qbuff * b)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	return has_dst_addr6(b, &data->addr, data->prefix);
+}
+
 static bool
 pred_is_frag(arguments_t args, struct qbuff * b)
 {
@@ -196,7 +240,7 @@ pred_is_ip_broadcast(arguments_t args, struct qbuff * b)
 static bool
 pred_is_ip_multicast(arguments_t args, struct qbuff * b)
 {
-	return is_ip_broadcast(b);
+	return is_ip_multicast(b);
 }
 
 static bool
@@ -217,9 +261,11 @@ struct pfq_lang_function_descr predicate_functions[] = {
         { "all_bit",	"(Qbuff -> Word64) -> Word64 -> Qbuff -> Bool", all_bit	   , NULL, NULL },
 
         { "is_ip",	   "Qbuff -> Bool", pred_is_ip	       , NULL, NULL },
+        { "is_ip6",	   "Qbuff -> Bool", pred_is_ip6	       , NULL, NULL },
         { "is_tcp",        "Qbuff -> Bool", pred_is_tcp	       , NULL, NULL },
         { "is_udp",        "Qbuff -> Bool", pred_is_udp	       , NULL, NULL },
         { "is_icmp",       "Qbuff -> Bool", pred_is_icmp       , NULL, NULL },
+        { "is_icmp6",      "Qbuff -> Bool", pred_is_icmp6      , NULL, NULL },
         { "is_flow",       "Qbuff -> Bool", pred_is_flow       , NULL, NULL },
         { "has_vlan",      "Qbuff -> Bool", pred_has_vlan      , NULL, NULL },
         { "is_frag",	   "Qbuff -> Bool", pred_is_frag       , NULL, NULL },
@@ -239,6 +285,10 @@ struct pfq_lang_function_descr predicate_functions[] = {
         { "has_src_addr", "CIDR -> Qbuff -> Bool", pred_has_src_addr , pred_addr_init , NULL},
         { "has_dst_addr", "CIDR -> Qbuff -> Bool", pred_has_dst_addr , pred_addr_init , NULL},
 
+        { "has_addr6",     "CIDR6 -> Qbuff -> Bool", pred_has_addr6     , pred_addr6_init , NULL},
+        { "has_src_addr6", "CIDR6 -> Qbuff -> Bool", pred_has_src_addr6 , pred_addr6_init , NULL},
+        { "has_dst_addr6", "CIDR6 -> Qbuff -> Bool", pred_has_dst_addr6 , pred_addr6_init , NULL},
+
         { "is_broadcast",    "Qbuff -> Bool",  pred_is_broadcast	, NULL, NULL },
         { "is_multicast",    "Qbuff -> Bool",  pred_is_multicast	, NULL, NULL },
         { "is_incoming_host","Qbuff -> Bool",  pred_is_incoming_host	, NULL, NULL },
@@ -166,65 +166,47 @@ is_ip(struct qbuff * buff)
 }
 
 static inline bool
-is_udp(struct qbuff * buff)
+is_ip6(struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
-
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
-                return false;
-
-	if (ip->protocol != IPPROTO_UDP)
-                return false;
+	return qbuff_ipv6hdr(buff) != NULL;
+}
 
-        return qbuff_header_available(buff, (int)qbuff_maclen(buff)  + (ip->ihl<<2), sizeof(struct udphdr));
+static inline bool
+is_udp(struct qbuff * buff)
+{
+	return qbuff_udphdr(buff) != NULL;
 }
 
 
 static inline bool
 is_tcp(struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
-
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
-                return false;
-
-	if (ip->protocol != IPPROTO_TCP)
-                return false;
-
-	return qbuff_header_available(buff, (int)qbuff_maclen(buff) + (ip->ihl<<2), sizeof(struct tcphdr));
+	return qbuff_tcphdr(buff) != NULL;
 }
 
 
 static inline bool
 is_icmp(struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
-
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
-                return false;
+	return qbuff_icmphdr(buff) != NULL;
+}
 
-	if (ip->protocol != IPPROTO_ICMP)
-                return false;
 
-	return qbuff_header_available(buff, (int)qbuff_maclen(buff) + (ip->ihl<<2), sizeof(struct icmphdr));
+static inline bool
+is_icmp6(struct qbuff * buff)
+{
+	return qbuff_icmp6hdr(buff) != NULL;
 }
 
 
 static inline bool
 has_addr(struct qbuff * buff, __be32 addr, __be32 mask)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-        bool ctx = buff->monad->ep_ctx;
+        int ctx = buff->monad->ep_ctx;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -236,10 +218,9 @@ has_addr(struct qbuff * buff, __be32 addr, __be32 mask)
 static inline bool
 has_src_addr(struct qbuff * buff, __be32 addr, __be32 mask)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -249,10 +230,9 @@ has_src_addr(struct qbuff * buff, __be32 addr, __be32 mask)
 static inline bool
 has_dst_addr(struct qbuff * buff, __be32 addr, __be32 mask)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -261,155 +241,116 @@ has_dst_addr(struct qbuff * buff, __be32 addr, __be32 mask)
 
 
 static inline bool
-is_flow(struct qbuff * buff)
+has_addr6(struct qbuff * buff, const struct in6_addr *addr, int prefix)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+	const struct ipv6hdr *ip6;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
-		return false;
+        int ctx = buff->monad->ep_ctx;
 
-	if (ip->protocol != IPPROTO_UDP &&
-	    ip->protocol != IPPROTO_TCP)
-                return false;
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
+		return false;
 
-	return qbuff_header_available(buff, (int)qbuff_maclen(buff) + (ip->ihl<<2), ip->protocol == IPPROTO_UDP ?
-				    sizeof(struct udphdr) : sizeof(struct tcphdr));
+	return  (ipv6_prefix_equal(&ip6->saddr, addr, prefix) && (ctx & EPOINT_SRC)) ||
+		(ipv6_prefix_equal(&ip6->daddr, addr, prefix) && (ctx & EPOINT_DST));
 }
 
 
 static inline bool
-is_l3_proto(struct qbuff * buff, uint16_t type)
+has_src_addr6(struct qbuff * buff, const struct in6_addr *addr, int prefix)
 {
-	return qbuff_eth_hdr(buff)->h_proto == __constant_htons(type);
-}
+	const struct ipv6hdr *ip6;
+
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
+		return false;
 
+	return ipv6_prefix_equal(&ip6->saddr, addr, prefix);
+}
 
 static inline bool
-is_l4_proto(struct qbuff * buff, uint8_t protocol)
+has_dst_addr6(struct qbuff * buff, const struct in6_addr *addr, int prefix)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+	const struct ipv6hdr *ip6;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
 		return false;
 
-        return ip->protocol == protocol;
+	return ipv6_prefix_equal(&ip6->daddr, addr, prefix);
 }
 
 
 static inline bool
-is_frag(struct qbuff * buff)
+is_flow(struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+	return qbuff_porthdr(buff) != NULL;
+}
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
-		return false;
 
-        return (ip->frag_off & __constant_htons(IP_MF|IP_OFFSET)) != 0;
+static inline bool
+is_l3_proto(struct qbuff * buff, uint16_t type)
+{
+	return qbuff_headers(buff)->l3proto == htons(type);
 }
 
+
 static inline bool
-is_first_frag(struct qbuff * buff)
+is_l4_proto(struct qbuff * buff, uint8_t protocol)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
-
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	struct pfq_lang_headers *hdr = qbuff_headers(buff);
+	if (hdr->ipver == 0)
 		return false;
 
-        return (ip->frag_off & __constant_htons(IP_MF|IP_OFFSET)) == __constant_htons(IP_MF);
+        return hdr->l4proto == protocol;
 }
 
+
+/* the fragment field is kept in the ipv4 layout for both ip versions */
+
 static inline bool
-is_more_frag(struct qbuff * buff)
+is_frag(struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+        return (qbuff_headers(buff)->frag_off & __constant_htons(IP_MF|IP_OFFSET)) != 0;
+}
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
-		return false;
+static inline bool
+is_first_frag(struct qbuff * buff)
+{
+        return (qbuff_headers(buff)->frag_off & __constant_htons(IP_MF|IP_OFFSET)) == __constant_htons(IP_MF);
+}
 
-	return (ip->frag_off & __constant_htons(IP_OFFSET)) != 0;
+static inline bool
+is_more_frag(struct qbuff * buff)
+{
+	return (qbuff_headers(buff)->frag_off & __constant_htons(IP_OFFSET)) != 0;
 }
 
 static inline bool
 has_src_port(struct qbuff * buff, uint16_t port)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
-
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	const struct udphdr *l4 = qbuff_porthdr(buff);
+	if (l4 == NULL)
 		return false;
 
-	switch(ip->protocol)
-	{
-	case IPPROTO_UDP: {
-		struct udphdr _udph; const struct udphdr *udp;
-		udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct udphdr), &_udph);
-		if (udp == NULL)
-			return false;
-
-		return udp->source == cpu_to_be16(port);
-	}
-	case IPPROTO_TCP: {
-		struct tcphdr _tcph; const struct tcphdr *tcp;
-		tcp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct tcphdr), &_tcph);
-		if (tcp == NULL)
-			return false;
-
-		return tcp->source == cpu_to_be16(port);
-	}
-	}
-
-	return false;
+	return l4->source == cpu_to_be16(port);
 }
 
 static inline bool
 has_dst_port(struct qbuff * buff, uint16_t port)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
-
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	const struct udphdr *l4 = qbuff_porthdr(buff);
+	if (l4 == NULL)
 		return false;
 
-	switch(ip->protocol)
-	{
-	case IPPROTO_UDP: {
-		struct udphdr _udph; const struct udphdr *udp;
-		udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct udphdr), &_udph);
-		if (udp == NULL)
-			return false;
-
-		return udp->dest == cpu_to_be16(port);
-	}
-	case IPPROTO_TCP: {
-		struct tcphdr _tcph; const struct tcphdr *tcp;
-		tcp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(struct tcphdr), &_tcph);
-		if (tcp == NULL)
-			return false;
-
-		return tcp->dest == cpu_to_be16(port);
-	}
-	}
-
-	return false;
+	return l4->dest == cpu_to_be16(port);
 }
 
 
 static inline bool
 has_port(struct qbuff * buff, uint16_t port)
 {
-        bool ctx = buff->monad->ep_ctx;
+        int ctx = buff->monad->ep_ctx;
 
 	return (has_src_port(buff, port) && (ctx & EPOINT_SRC)) ||
 	       (has_dst_port(buff, port) && (ctx & EPOINT_DST));
@@ -419,13 +360,13 @@ has_port(struct qbuff * buff, uint16_t port)
 static inline bool
 has_vlan(struct qbuff * buff)
 {
-	return (qbuff_vlan_tci(buff) & Q_VLAN_VID_MASK);
+	return (qbuff_headers(buff)->vlan_tci & Q_VLAN_VID_MASK);
 }
 
 static inline bool
 has_vid(struct qbuff * buff, int vid)
 {
-	return (qbuff_vlan_tci(buff) & Q_VLAN_VID_MASK) == vid;
+	return (qbuff_headers(buff)->vlan_tci & Q_VLAN_VID_MASK) == vid;
 }
 
 
@@ -433,7 +374,7 @@ static inline bool
 is_broadcast(struct qbuff * buff)
 {
 	struct ethhdr *eth = qbuff_eth_hdr(buff);
-        bool ctx = buff->monad->ep_ctx;
+        int ctx = buff->monad->ep_ctx;
 
 	return (is_broadcast_ether_addr(eth->h_dest)   && (ctx & EPOINT_DST)) ||
 	       (is_broadcast_ether_addr(eth->h_source) && (ctx & EPOINT_SRC));
@@ -443,7 +384,7 @@ static inline bool
 is_multicast(struct qbuff * buff)
 {
 	struct ethhdr *eth = qbuff_eth_hdr(buff);
-        bool ctx = buff->monad->ep_ctx;
+        int ctx = buff->monad->ep_ctx;
 
 	return (is_multicast_ether_addr(eth->h_dest) && (ctx & EPOINT_DST)) ||
 	       (is_multicast_ether_addr(eth->h_source) && (ctx & EPOINT_SRC));
@@ -453,11 +394,10 @@ is_multicast(struct qbuff * buff)
 static inline bool
 is_ip_broadcast(struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
-        bool ctx = buff->monad->ep_ctx;
+        int ctx = buff->monad->ep_ctx;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -469,11 +409,10 @@ is_ip_broadcast(struct qbuff * buff)
 static inline bool
 is_ip_multicast(struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
-        bool ctx = buff->monad->ep_ctx;
+        int ctx = buff->monad->ep_ctx;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -485,10 +424,9 @@ is_ip_multicast(struct qbuff * buff)
 static inline bool
 is_ip_host(struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -499,14 +437,13 @@ is_ip_host(struct qbuff * buff)
 static inline bool
 is_incoming_host(struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 	struct ethhdr *eth = qbuff_eth_hdr(buff);
 
 	if (is_broadcast_ether_addr(eth->h_dest) || is_multicast_ether_addr(eth->h_dest))
 		return true;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return false;
 
@@ -33,10 +33,9 @@
 static uint64_t
 ip_tos(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
@@ -47,10 +46,9 @@ ip_tos(arguments_t args, struct qbuff * buff)
 static uint64_t
 ip_tot_len(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
@@ -61,10 +59,9 @@ ip_tot_len(arguments_t args, struct qbuff * buff)
 static uint64_t
 ip_id(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
@@ -75,10 +72,9 @@ ip_id(arguments_t args, struct qbuff * buff)
 static uint64_t
 ip_ttl(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
@@ -88,10 +84,9 @@ ip_ttl(arguments_t args, struct qbuff * buff)
 static uint64_t
 ip_frag(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
@@ -106,20 +101,18 @@ ip_frag(arguments_t args, struct qbuff * buff)
 static uint64_t
 tcp_source(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct tcphdr _tcp;
 	const struct tcphdr *tcp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
 	if (ip->protocol != IPPROTO_TCP)
 		return NOTHING;
 
-	tcp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_tcp), &_tcp);
+	tcp = qbuff_tcphdr(buff);
 	if (tcp == NULL)
 		return NOTHING;
 
@@ -130,20 +123,18 @@ tcp_source(arguments_t args, struct qbuff * buff)
 static uint64_t
 tcp_dest(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct tcphdr _tcp;
 	const struct tcphdr *tcp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
 	if (ip->protocol != IPPROTO_TCP)
 		return NOTHING;
 
-	tcp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_tcp), &_tcp);
+	tcp = qbuff_tcphdr(buff);
 	if (tcp == NULL)
 		return NOTHING;
 
@@ -153,20 +144,18 @@ tcp_dest(arguments_t args, struct qbuff * buff)
 static uint64_t
 tcp_hdrlen_(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct tcphdr _tcp;
 	const struct tcphdr *tcp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
 	if (ip->protocol != IPPROTO_TCP)
 		return NOTHING;
 
-	tcp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_tcp), &_tcp);
+	tcp = qbuff_tcphdr(buff);
 	if (tcp == NULL)
 		return NOTHING;
 
@@ -180,20 +169,18 @@ tcp_hdrlen_(arguments_t args, struct qbuff * buff)
 static uint64_t
 udp_source(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct udphdr _udp;
 	const struct udphdr *udp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
-	if (ip->protocol != IPPROTO_TCP)
+	if (ip->protocol != IPPROTO_UDP)
 		return NOTHING;
 
-	udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_udp), &_udp);
+	udp = qbuff_udphdr(buff);
 	if (udp == NULL)
 		return NOTHING;
 
@@ -204,20 +191,18 @@ udp_source(arguments_t args, struct qbuff * buff)
 static uint64_t
 udp_dest(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct udphdr _udp;
 	const struct udphdr *udp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
-	if (ip->protocol != IPPROTO_TCP)
+	if (ip->protocol != IPPROTO_UDP)
 		return NOTHING;
 
-	udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_udp), &_udp);
+	udp = qbuff_udphdr(buff);
 	if (udp == NULL)
 		return NOTHING;
 
@@ -227,20 +212,18 @@ udp_dest(arguments_t args, struct qbuff * buff)
 static uint64_t
 udp_len(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct udphdr _udp;
 	const struct udphdr *udp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
-	if (ip->protocol != IPPROTO_TCP)
+	if (ip->protocol != IPPROTO_UDP)
 		return NOTHING;
 
-	udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_udp), &_udp);
+	udp = qbuff_udphdr(buff);
 	if (udp == NULL)
 		return NOTHING;
 
@@ -251,20 +234,18 @@ udp_len(arguments_t args, struct qbuff * buff)
 static uint64_t
 icmp_type(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct icmphdr _icmp;
 	const struct icmphdr *icmp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
 	if (ip->protocol != IPPROTO_ICMP)
 		return NOTHING;
 
-	icmp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_icmp), &_icmp);
+	icmp = qbuff_icmphdr(buff);
 	if (icmp == NULL)
 		return NOTHING;
 
@@ -275,20 +256,18 @@ icmp_type(arguments_t args, struct qbuff * buff)
 static uint64_t
 icmp_code(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	struct icmphdr _icmp;
 	const struct icmphdr *icmp;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return NOTHING;
 
 	if (ip->protocol != IPPROTO_ICMP)
 		return NOTHING;
 
-	icmp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_icmp), &_icmp);
+	icmp = qbuff_icmphdr(buff);
 	if (icmp == NULL)
 		return NOTHING;
 
@@ -141,21 +141,157 @@ qbuff_ip_version(struct qbuff * buff)
 }
 
 
-static inline int
-qbuff_ip_protocol(struct qbuff * buff)
+/* ipv6: walk the extension headers up to the transport one.
+ * The fragment field is stored in the ipv4 layout (IP_MF | offset in 8-byte units)
+ * so that the fragment predicates work for both versions.
+ */
+
+static inline void
+qbuff_parse_ipv6_headers(struct qbuff *buff, struct pfq_lang_headers *hdr)
+{
+	__be16 frag = 0;
+	u8 nexthdr;
+	int off;
+
+	hdr->ip6 = qbuff_header_pointer(buff, buff->monad->ipoff, sizeof(struct ipv6hdr), &hdr->_l3.ip6);
+	if (hdr->ip6 == NULL)
+		return;
+
+	hdr->ipver = 6;
+	hdr->l3off = buff->monad->ipoff;
+
+	nexthdr = hdr->ip6->nexthdr;
+	off = ipv6_skip_exthdr(QBUFF_SKB(buff), hdr->l3off + (int)sizeof(struct ipv6hdr), &nexthdr, &frag);
+	if (off < 0)
+		return;
+
+	if (frag) {
+		u16 f = ntohs(frag);
+		hdr->frag_off = htons(((f & IP6_MF) ? IP_MF : 0) | (f >> 3));
+	}
+
+	hdr->l4off   = off;
+	hdr->l4proto = nexthdr;
+}
+
+
+static inline void
+qbuff_parse_headers(struct qbuff *buff, struct pfq_lang_headers *hdr)
 {
+	size_t size;
+
+	hdr->parsed   = true;
+	hdr->ipver    = 0;
+	hdr->l4proto  = IPPROTO_NONE;
+	hdr->l3proto  = qbuff_eth_hdr(buff)->h_proto;
+	hdr->frag_off = 0;
+	hdr->vlan_tci = qbuff_vlan_tci(buff);
+	hdr->l2len    = (int)qbuff_maclen(buff);
+	hdr->l3off    = -1;
+	hdr->l4off    = -1;
+	hdr->ip       = NULL;
+	hdr->ip6      = NULL;
+	hdr->l4       = NULL;
+
 	switch(qbuff_ip_version(buff))
 	{
 	case 4: {
-		struct iphdr _iph;
-		const struct iphdr *ip;
-		ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-		if (ip)
-			return ip->protocol;
+		hdr->ip = qbuff_header_pointer(buff, buff->monad->ipoff, sizeof(struct iphdr), &hdr->_l3.ip);
+		if (hdr->ip == NULL)
+			return;
+
+		hdr->ipver    = 4;
+		hdr->l3off    = buff->monad->ipoff;
+		hdr->l4off    = hdr->l3off + (hdr->ip->ihl<<2);
+		hdr->l4proto  = hdr->ip->protocol;
+		hdr->frag_off = hdr->ip->frag_off;
 	} break;
+	case 6: {
+		qbuff_parse_ipv6_headers(buff, hdr);
+	} break;
+	default:
+		return;
+	}
+
+	/* non-first fragments carry no transport header */
+
+	if (hdr->frag_off & htons(IP_OFFSET))
+		return;
+
+	switch(hdr->l4proto)
+	{
+	case IPPROTO_UDP:    size = sizeof(struct udphdr);  break;
+	case IPPROTO_TCP:    size = sizeof(struct tcphdr);  break;
+	case IPPROTO_ICMP:   size = sizeof(struct icmphdr); break;
+	case IPPROTO_ICMPV6: size = sizeof(struct icmp6hdr); break;
+	default:	     return;
 	}
 
-	return IPPROTO_NONE;
+	hdr->l4 = qbuff_header_pointer(buff, hdr->l4off, (int)size, &hdr->_l4);
+}
+
+
+/* headers of the packet (parsed on first use) */
+
+static inline struct pfq_lang_headers *
+qbuff_headers(struct qbuff *buff)
+{
+	struct pfq_lang_headers *hdr = &buff->monad->hdr;
+	if (unlikely(!hdr->parsed))
+		qbuff_parse_headers(buff, hdr);
+	return hdr;
+}
+
+
+static inline void
+qbuff_headers_invalidate(struct qbuff *buff)
+{
+	buff->monad->hdr.parsed = false;
+}
+
+
+static inline const struct iphdr *
+qbuff_iphdr(struct qbuff *buff)
+{
+	return qbuff_headers(buff)->ip;
+}
+
+
+static inline const struct ipv6hdr *
+qbuff_ipv6hdr(struct qbuff *buff)
+{
+	return qbuff_headers(buff)->ip6;
+}
+
+
+static inline const void *
+qbuff_l4hdr(struct qbuff *buff, int proto)
+{
+	struct pfq_lang_headers *hdr = qbuff_headers(buff);
+	return hdr->l4proto == proto ? hdr->l4 : NULL;
+}
+
+#define qbuff_udphdr(buff)	((const struct udphdr  *)qbuff_l4hdr(buff, IPPROTO_UDP))
+#define qbuff_tcphdr(buff)	((const struct tcphdr  *)qbuff_l4hdr(buff, IPPROTO_TCP))
+#define qbuff_icmphdr(buff)	((const struct icmphdr *)qbuff_l4hdr(buff, IPPROTO_ICMP))
+#define qbuff_icmp6hdr(buff)	((const struct icmp6hdr *)qbuff_l4hdr(buff, IPPROTO_ICMPV6))
+
+
+/* udp or tcp header: source and dest ports share the same layout */
+
+static inline const struct udphdr *
+qbuff_porthdr(struct qbuff *buff)
+{
+	struct pfq_lang_headers *hdr = qbuff_headers(buff);
+	return hdr->l4proto == IPPROTO_UDP ||
+	       hdr->l4proto == IPPROTO_TCP ? hdr->l4 : NULL;
+}
+
+
+static inline int
+qbuff_ip_protocol(struct qbuff * buff)
+{
+	return qbuff_headers(buff)->l4proto;
 }
 
 
@@ -24,6 +24,7 @@
 #include <lang/module.h>
 #include <lang/types.h>
 #include <lang/qbuff.h>
+#include <lang/hash.h>
 
 #include <pfq/bitops.h>
 #include <pfq/kcompat.h>
@@ -36,45 +37,163 @@
 #define IP_TOS_MASK      0x3
 #define IP_DSCP_MASK     0xfc
 
-static ActionQbuff
-steering_key(arguments_t args, struct qbuff * buff)
+
+/* source and destination addresses of the packet, either ipv4 or ipv6.
+ * ipv6 addresses are xor-folded to 32 bits, so that the hashes below keep
+ * the same (symmetric) properties for both ip versions.
+ */
+
+static inline bool
+steering_ip_addrs(struct qbuff *buff, uint32_t *saddr, uint32_t *daddr)
+{
+	struct pfq_lang_headers *hdr = qbuff_headers(buff);
+
+	if (hdr->ip) {
+		*saddr = (__force uint32_t)hdr->ip->saddr;
+		*daddr = (__force uint32_t)hdr->ip->daddr;
+		return true;
+	}
+
+	if (hdr->ip6) {
+		*saddr = ipv6_addr_hash(&hdr->ip6->saddr);
+		*daddr = ipv6_addr_hash(&hdr->ip6->daddr);
+		return true;
+	}
+
+	return false;
+}
+
+
+static inline bool
+steering_ip_broadcast(struct qbuff *buff)
+{
+	const struct iphdr *ip = qbuff_iphdr(buff);
+
+	return ip && (ip->saddr == (__force __be32)0xffffffff ||
+		      ip->daddr == (__force __be32)0xffffffff);
+}
+
+
+static inline u64
+steering_ip6_key(const struct in6_addr *addr)
+{
+	u64 hi = ((u64)addr->s6_addr32[0] << 32) | addr->s6_addr32[1];
+	u64 lo = ((u64)addr->s6_addr32[2] << 32) | addr->s6_addr32[3];
+	return pfq_lang_mix64(hi ^ pfq_lang_hash_key) ^ lo;
+}
+
+
+/* flow hash of the packet with the given family (Q_STEER_HASH_*).
+ * Ports are included when requested and available.
+ */
+
+static inline bool
+steering_flow_hash(struct qbuff *buff, int family, bool ports, uint32_t *hash)
+{
+	struct pfq_lang_headers *hdr = qbuff_headers(buff);
+	const struct udphdr *udp = ports ? qbuff_porthdr(buff) : NULL;
+	__be16 sport = udp ? udp->source : 0;
+	__be16 dport = udp ? udp->dest : 0;
+
+	switch(family)
+	{
+	case Q_STEER_HASH_TOEPLITZ: {
+
+		uint8_t tuple[2 * sizeof(struct in6_addr) + 2 * sizeof(__be16)];
+		size_t alen;
+
+		if (hdr->ip) {
+			alen = sizeof(__be32);
+			memcpy(tuple, &hdr->ip->saddr, alen);
+			memcpy(tuple + alen, &hdr->ip->daddr, alen);
+		}
+		else if (hdr->ip6) {
+			alen = sizeof(struct in6_addr);
+			memcpy(tuple, &hdr->ip6->saddr, alen);
+			memcpy(tuple + alen, &hdr->ip6->daddr, alen);
+		}
+		else
+			return false;
+
+		if (udp) {
+			memcpy(tuple + 2 * alen, &sport, sizeof(sport));
+			memcpy(tuple + 2 * alen + sizeof(sport), &dport, sizeof(dport));
+			*hash = pfq_lang_hash_toeplitz(tuple, 2 * alen + 2 * sizeof(__be16));
+		}
+		else
+			*hash = pfq_lang_hash_toeplitz(tuple, 2 * alen);
+
+	} return true;
+
+	case Q_STEER_HASH_MIX: {
+
+		u64 src, dst;
+
+		if (hdr->ip) {
+			src = (u64)(__force uint32_t)hdr->ip->saddr << 16;
+			dst = (u64)(__force uint32_t)hdr->ip->daddr << 16;
+		}
+		else if (hdr->ip6) {
+			src = steering_ip6_key(&hdr->ip6->saddr);
+			dst = steering_ip6_key(&hdr->ip6->daddr);
+		}
+		else
+			return false;
+
+		*hash = pfq_lang_hash_mix(src ^ (__force uint16_t)sport,
+					  dst ^ (__force uint16_t)dport, hdr->l4proto);
+	} return true;
+
+	default: {
+
+		uint32_t saddr, daddr;
+
+		if (!steering_ip_addrs(buff, &saddr, &daddr))
+			return false;
+
+		*hash = saddr ^ daddr ^ (__force uint32_t)sport ^ (__force uint32_t)dport;
+	} return true;
+	}
+}
+
+
+static inline uint8_t
+steering_ip_dsfield(struct pfq_lang_headers *hdr)
+{
+	return hdr->ip ? hdr->ip->tos : ipv6_get_dsfield(hdr->ip6);
+}
+
+
+static inline ActionQbuff
+steering_key_(uint64_t key, int family, struct qbuff * buff)
 {
-	uint64_t key = GET_ARG_0(uint64_t, args);
         uint32_t hash, src_hash, dst_hash;
 	uint64_t field;
 
-	struct iphdr   _ip;    struct iphdr const *ip;
-	struct udphdr  _udp;   struct udphdr const *udp;
-	struct icmphdr _icmp;  struct icmphdr const *icmp;
+	struct pfq_lang_headers *hdr;
+	struct udphdr const *udp;
+	struct icmphdr const *icmp;
+	uint32_t saddr, daddr;
 
 	switch(key)
 	{
 	case Q_KEY_IP_SRC|Q_KEY_IP_DST|Q_KEY_IP_PROTO: {
 
-		ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-		if (ip == NULL)
+		if (!steering_flow_hash(buff, family, false, &hash))
 			return Drop(buff);
 
-		return Steering(buff, (__force uint32_t)(ip->saddr ^ ip->daddr));
+		return Steering(buff, hash);
 
 	}
 	case Q_KEY_IP_SRC|Q_KEY_IP_DST|Q_KEY_SRC_PORT|Q_KEY_DST_PORT|Q_KEY_IP_PROTO: {
 
-		ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-		if (ip == NULL)
+		if (qbuff_porthdr(buff) == NULL)
 			return Drop(buff);
 
-		if (ip->protocol != IPPROTO_UDP &&
-		    ip->protocol != IPPROTO_TCP) {
-		    	return Drop(buff);
-		}
-
-		udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_udp), &_udp);
-		if (udp == NULL)
-			return Drop(buff);  /* broken */
+		if (!steering_flow_hash(buff, family, true, &hash))
+			return Drop(buff);
 
-		hash = ip->saddr ^ ip->daddr ^ (__force __be32)udp->source ^ (__force __be32)udp->dest;
-		return Steering(buff, (__force uint32_t)hash);
+		return Steering(buff, hash);
 	}
 
 	}
@@ -111,50 +230,48 @@ steering_key(arguments_t args, struct qbuff * buff)
 
                 case Q_KEY_IP_SRC:
                 {
-                        ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-                        if (ip == NULL)
+                        if (!steering_ip_addrs(buff, &saddr, &daddr))
                                 return Drop(buff);
-	                src_hash = ((src_hash << 5) + src_hash) + ip->saddr;
+	                src_hash = ((src_hash << 5) + src_hash) + saddr;
 
                 } break;
 
                 case Q_KEY_IP_DST:
                 {
-                        ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-                        if (ip == NULL)
+                        if (!steering_ip_addrs(buff, &saddr, &daddr))
                                 return Drop(buff);
-	                dst_hash = ((dst_hash << 5) + dst_hash) + ip->daddr;
+	                dst_hash = ((dst_hash << 5) + dst_hash) + daddr;
 
                 } break;
                 case Q_KEY_IP_PROTO:
                 {
-                        ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-                        if (ip == NULL)
+                        hdr = qbuff_headers(buff);
+                        if (hdr->ipver == 0)
                                 return Drop(buff);
-	                hash = ((hash << 5) + hash) + ip->protocol;
+	                hash = ((hash << 5) + hash) + hdr->l4proto;
 
                 } break;
                 case Q_KEY_IP_ECN:
                 {
-                        ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-                        if (ip == NULL)
+                        hdr = qbuff_headers(buff);
+                        if (hdr->ipver == 0)
                                 return Drop(buff);
-	                hash = ((hash << 5) + hash) + (ip->tos & IP_TOS_MASK);
+	                hash = ((hash << 5) + hash) + (steering_ip_dsfield(hdr) & IP_TOS_MASK);
 
                 } break;
 
                 case Q_KEY_IP_DSCP:
                 {
-                        ip = qbuff_ip_header_pointer(buff, 0, sizeof(_ip), &_ip);
-                        if (ip == NULL)
+                        hdr = qbuff_headers(buff);
+                        if (hdr->ipver == 0)
                                 return Drop(buff);
-	                hash = ((hash << 5) + hash) + (ip->tos & IP_DSCP_MASK);
+	                hash = ((hash << 5) + hash) + (steering_ip_dsfield(hdr) & IP_DSCP_MASK);
 
                 } break;
 
                 case Q_KEY_SRC_PORT:
                 {
-                        udp = qbuff_ip_header_pointer(buff, 0, sizeof(_udp), &_udp);
+                        udp = qbuff_porthdr(buff);
                         if (udp == NULL)
                                 return Drop(buff);
 
@@ -164,7 +281,7 @@ steering_key(arguments_t args, struct qbuff * buff)
 
                 case Q_KEY_DST_PORT:
                 {
-                        udp = qbuff_ip_header_pointer(buff, 0, sizeof(_udp), &_udp);
+                        udp = qbuff_porthdr(buff);
                         if (udp == NULL)
                                 return Drop(buff);
 
@@ -174,7 +291,7 @@ steering_key(arguments_t args, struct qbuff * buff)
 
                 case Q_KEY_ICMP_TYPE:
                 {
-                        icmp = qbuff_ip_header_pointer(buff, 0, sizeof(_icmp), &_icmp);
+                        icmp = qbuff_icmphdr(buff) ?: (struct icmphdr const *)qbuff_icmp6hdr(buff);
                         if (icmp == NULL)
                                 return Drop(buff);
 
@@ -184,7 +301,7 @@ steering_key(arguments_t args, struct qbuff * buff)
 
                 case Q_KEY_ICMP_CODE:
                 {
-                        icmp = qbuff_ip_header_pointer(buff, 0, sizeof(_icmp), &_icmp);
+                        icmp = qbuff_icmphdr(buff) ?: (struct icmphdr const *)qbuff_icmp6hdr(buff);
                         if (icmp == NULL)
                                 return Drop(buff);
 
@@ -199,11 +316,40 @@ steering_key(arguments_t args, struct qbuff * buff)
                 }
         });
 
+	if (family != Q_STEER_HASH_XOR)
+		return Steering(buff, pfq_lang_hash_mix(src_hash, dst_hash, hash));
 
         return Steering(buff, hash ^ src_hash ^ dst_hash);
 }
 
 
+static ActionQbuff
+steering_key(arguments_t args, struct qbuff * buff)
+{
+	return steering_key_(GET_ARG_0(uint64_t, args), Q_STEER_HASH_XOR, buff);
+}
+
+
+static ActionQbuff
+steering_key_hash(arguments_t args, struct qbuff * buff)
+{
+	return steering_key_(GET_ARG_0(uint64_t, args), GET_ARG_1(int, args), buff);
+}
+
+
+static int steering_key_hash_init(arguments_t args)
+{
+	int family = GET_ARG_1(int, args);
+
+	if (!pfq_lang_hash_valid(family)) {
+		printk(KERN_INFO "[pfq-lang] steer_key_hash: unknown hash family %d!\n", family);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+
 static ActionQbuff
 steering_rrobin(arguments_t args, struct qbuff * buff)
 {
@@ -377,37 +523,30 @@ steering_vlan_id(arguments_t args, struct qbuff * buff)
 static ActionQbuff
 steering_p2p(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+	uint32_t saddr, daddr;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	if (!steering_ip_addrs(buff, &saddr, &daddr))
 		return Drop(buff);
 
-	if (ip->saddr == (__force __be32)0xffffffff ||
-	    ip->daddr == (__force __be32)0xffffffff)
+	if (steering_ip_broadcast(buff))
 		return Broadcast(buff);
 
-	return Steering(buff, (__force uint32_t)(ip->saddr ^ ip->daddr));
+	return Steering(buff, saddr ^ daddr);
 }
 
 
 static ActionQbuff
 double_steering_ip(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+	uint32_t saddr, daddr;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	if (!steering_ip_addrs(buff, &saddr, &daddr))
 		return Drop(buff);
 
-	if (ip->saddr == (__force __be32)0xffffffff ||
-	    ip->daddr == (__force __be32)0xffffffff)
+	if (steering_ip_broadcast(buff))
 		return Broadcast(buff);
 
-	return DoubleSteering(buff, (__force uint32_t)ip->saddr,
-				   (__force uint32_t)ip->daddr);
+	return DoubleSteering(buff, saddr, daddr);
 }
 
 static int steering_local_ip_init(arguments_t args)
@@ -420,10 +559,9 @@ static ActionQbuff
 steering_local_ip(arguments_t args, struct qbuff * buff)
 {
 	struct CIDR_ *data = GET_PTR_0(struct CIDR_, args);
-	struct iphdr _iph;
 	const struct iphdr *ip;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return Drop(buff);
 
@@ -474,11 +612,10 @@ steering_local_net(arguments_t args, struct qbuff * buff)
 	__be32 mask    = GET_ARG_1(__be32, args);
 	__be32 submask = GET_ARG_2(__be32, args);
 
-	struct iphdr _iph;
 	const struct iphdr *ip;
 	bool src_net, dst_net;
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
+	ip = qbuff_iphdr(buff);
 	if (ip == NULL)
 		return Drop(buff);
 
@@ -502,31 +639,76 @@ steering_local_net(arguments_t args, struct qbuff * buff)
 }
 
 
+static int steering_local_ip6_init(arguments_t args)
+{
+	CIDR6_INIT(args, 0);
+	return 0;
+}
+
+static ActionQbuff
+steering_local_ip6(arguments_t args, struct qbuff * buff)
+{
+	struct CIDR6 *data = GET_PTR_0(struct CIDR6, args);
+	const struct ipv6hdr *ip6;
+	bool src_net, dst_net;
+
+	ip6 = qbuff_ipv6hdr(buff);
+	if (ip6 == NULL)
+		return Drop(buff);
+
+	src_net = ipv6_prefix_equal(&ip6->saddr, &data->addr, data->prefix);
+	dst_net = ipv6_prefix_equal(&ip6->daddr, &data->addr, data->prefix);
+
+	if (src_net && dst_net)
+		return DoubleSteering(buff, ipv6_addr_hash(&ip6->saddr),
+					    ipv6_addr_hash(&ip6->daddr));
+	if (src_net)
+		return Steering(buff, ipv6_addr_hash(&ip6->saddr));
+
+	if (dst_net)
+		return Steering(buff, ipv6_addr_hash(&ip6->daddr));
+
+	return Drop(buff);
+}
+
+
 static ActionQbuff
 steering_flow(arguments_t args, struct qbuff * buff)
 {
-	struct iphdr _iph;
-	const struct iphdr *ip;
+	uint32_t hash;
 
-	struct udphdr _udp;
-	const struct udphdr *udp;
-	__be32 hash;
+	/* not udp/tcp, or ip fragments without the transport header: addresses only */
 
-	ip = qbuff_ip_header_pointer(buff, 0, sizeof(_iph), &_iph);
-	if (ip == NULL)
+	if (!steering_flow_hash(buff, Q_STEER_HASH_XOR, true, &hash))
 		return Drop(buff);
 
-	if (ip->protocol != IPPROTO_UDP &&
-	    ip->protocol != IPPROTO_TCP) {
-		return Steering(buff, (__force uint32_t)ip->saddr ^ (__force uint32_t)ip->daddr);
-	}
+	return Steering(buff, hash);
+}
 
-	udp = qbuff_ip_header_pointer(buff, (ip->ihl<<2), sizeof(_udp), &_udp);
-	if (udp == NULL)
-		return Drop(buff);  /* broken */
 
-	hash = ip->saddr ^ ip->daddr ^ (__force __be32)udp->source ^ (__force __be32)udp->dest;
-	return Steering(buff, (__force uint32_t)hash);
+static ActionQbuff
+steering_flow_with_hash(arguments_t args, struct qbuff * buff)
+{
+	int family = GET_ARG_0(int, args);
+	uint32_t hash;
+
+	if (!steering_flow_hash(buff, family, true, &hash))
+		return Drop(buff);
+
+	return Steering(buff, hash);
+}
+
+
+static int steering_flow_hash_init(arguments_t args)
+{
+	int family = GET_ARG_0(int, args);
+
+	if (!pfq_lang_hash_valid(family)) {
+		printk(KERN_INFO "[pfq-lang] steer_flow_hash: unknown hash family %d!\n", family);
+		return -EINVAL;
+	}
+
+	return 0;
 }
 
 
@@ -538,9 +720,11 @@ struct pfq_lang_function_descr steering_functions[] = {
 	{ "steer_local_link",  "String -> Qbuff -> Action Qbuff", steering_local_link, steering_local_link_init, NULL },
 	{ "steer_vlan",  "Qbuff -> Action Qbuff", steering_vlan_id , NULL, NULL },
 	{ "steer_local_ip","CIDR -> Qbuff -> Action Qbuff", steering_local_ip, steering_local_ip_init, NULL},
+	{ "steer_local_ip6","CIDR6 -> Qbuff -> Action Qbuff", steering_local_ip6, steering_local_ip6_init, NULL},
 
 	{ "steer_p2p",   "Qbuff -> Action Qbuff", steering_p2p     , NULL, NULL },
 	{ "steer_flow",  "Qbuff -> Action Qbuff", steering_flow    , NULL, NULL },
+	{ "steer_flow_hash", "CInt -> Qbuff -> Action Qbuff", steering_flow_with_hash, steering_flow_hash_init, NULL },
 	{ "steer_to",    "CInt   -> Qbuff -> Action Qbuff", steering_to , NULL, NULL },
 
 	{ "steer_field", "Word32 -> Word32 -> Qbuff -> Action Qbuff", steering_field , NULL, NULL},
@@ -553,6 +737,7 @@ struct pfq_lang_function_descr steering_functions[] = {
 	{ "steer_local_net", "Word32 -> Word32 -> Word32 -> Qbuff -> Action Qbuff", steering_local_net, steering_net_init, NULL },
 
 	{ "steer_key",    "Word64 -> Qbuff -> Action Qbuff", steering_key, NULL, NULL },
+	{ "steer_key_hash", "Word64 -> CInt -> Qbuff -> Action Qbuff", steering_key_hash, steering_key_hash_init, NULL },
 
 	{ NULL }};
 
@@ -53,6 +53,7 @@ __pfq_lang_symtable_free(struct symtable *table)
 		table->entry[n].function = NULL;
 		table->entry[n].init = NULL;
 		table->entry[n].fini = NULL;
+		table->entry[n].batch = NULL;
 	}
 	table->size = 0;
 }
@@ -95,7 +96,7 @@ __pfq_lang_get_free_entry(struct symtable *table)
 
 static int
 __pfq_lang_symtable_register_function(struct symtable *table, const char *symbol, void *fun,
-				 init_ptr_t init, fini_ptr_t fini, const char *signature)
+				 init_ptr_t init, fini_ptr_t fini, batch_ptr_t batch, const char *signature)
 {
 	struct symtable_entry * elem;
 
@@ -123,6 +124,7 @@ __pfq_lang_symtable_register_function(struct symtable *table, const char *symbol
 	elem->function = fun;
         elem->init     = init;
         elem->fini     = fini;
+        elem->batch    = batch;
 	return 0;
 }
 
@@ -138,6 +140,7 @@ __pfq_lang_symtable_unregister_function(struct symtable *table, const char *symb
 			table->entry[n].function = NULL;
 			table->entry[n].init = NULL;
 			table->entry[n].fini = NULL;
+			table->entry[n].batch = NULL;
 			return 0;
 		}
 	}
@@ -170,6 +173,7 @@ pfq_lang_symtable_register_functions(const char *module, struct symtable *table,
 						       , fun[i].ptr
 						       , fun[i].init
 						       , fun[i].fini
+						       , fun[i].batch
 						       , fun[i].signature) < 0)
 		{
                         int j = 0;
@@ -262,12 +266,12 @@ pfq_lang_symtable_search(struct symtable *table, const char *symbol)
 
 int
 pfq_lang_symtable_register_function(const char *module, struct symtable *table, const char *symbol, void *fun,
-				    init_ptr_t init, fini_ptr_t fini, const char *signature)
+				    init_ptr_t init, fini_ptr_t fini, batch_ptr_t batch, const char *signature)
 {
 	int rc;
 
         down_write(&global->symtable_sem);
-	rc = __pfq_lang_symtable_register_function(table, symbol, fun, init, fini, signature);
+	rc = __pfq_lang_symtable_register_function(table, symbol, fun, init, fini, batch, signature);
 	up_write(&global->symtable_sem);
 
 	if (rc == 0 && module)
@@ -35,6 +35,7 @@ struct symtable_entry
 	void *                  function;
 	void *			init;
 	void *			fini;
+	void *			batch;		/* optional batch implementation */
 };
 
 
@@ -50,17 +51,20 @@ struct symtable
 
 struct pfq_lang_functional;
 struct pfq_lang_function_descr;
+struct pfq_qbuff_queue;
+struct pfq_qbuff_mask;
 
 typedef struct pfq_lang_functional * arguments_t;
 typedef int (*init_ptr_t)	(arguments_t);
 typedef int (*fini_ptr_t)	(arguments_t);
+typedef void (*batch_ptr_t)	(arguments_t, struct pfq_qbuff_queue *, struct pfq_qbuff_mask *);
 
 /* symtable */
 
 extern void pfq_lang_symtable_init(void);
 extern void pfq_lang_symtable_free(void);
 
-extern int  pfq_lang_symtable_register_function(const char *module, struct symtable *table, const char *symbol, void * fun, init_ptr_t init, fini_ptr_t fini, const char *signature);
+extern int  pfq_lang_symtable_register_function(const char *module, struct symtable *table, const char *symbol, void * fun, init_ptr_t init, fini_ptr_t fini, batch_ptr_t batch, const char *signature);
 extern int  pfq_lang_symtable_register_functions(const char *module, struct symtable *table, struct pfq_lang_function_descr *fun);
 extern int  pfq_lang_symtable_unregister_function(const char *module, struct symtable *table, const char *symbol);
 extern void pfq_lang_symtable_unregister_functions(const char *module, struct symtable *table, struct pfq_lang_function_descr *fun);
@@ -27,6 +27,8 @@
 
 #include <pfq/kcompat.h>
 
+#include <net/ipv6.h>
+
 
 /* CIDR notation */
 
@@ -56,4 +58,23 @@ void to_CIDR_(struct CIDR *data)
 
 #define CIDR_INIT(a,i)		to_CIDR_((struct CIDR *)&ARGS_TYPE(a)->arg[i].value)
 
+
+/* CIDR notation (ipv6) */
+
+struct CIDR6
+{
+	struct in6_addr addr;
+	int		prefix;
+};
+
+
+static inline
+void to_CIDR6_(struct CIDR6 *data)
+{
+	data->prefix = clamp(data->prefix, 0, 128);
+	ipv6_addr_prefix(&data->addr, &data->addr, data->prefix);
+}
+
+#define CIDR6_INIT(a,i)		to_CIDR6_((struct CIDR6 *)ARGS_TYPE(a)->arg[i].value)
+
 #endif /* PFQ_LANG_TYPES_H */
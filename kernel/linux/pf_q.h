@@ -89,6 +89,11 @@ typedef uint8_t  pfq_qver_t;
 
 #define PFQ_SHARED_QUEUE_SLOT_SIZE(x)		ALIGN(sizeof(struct pfq_pkthdr) + x, PFQ_SLOT_ALIGNMENT)
 #define PFQ_SHARED_QUEUE_NEXT_PKTHDR(hdr, fix) ((struct pfq_pkthdr *)((char *)(hdr) + fix))
+#define PFQ_SHARED_QUEUE_PKTHDR_STRIDE(hdr)	PFQ_SHARED_QUEUE_SLOT_SIZE((hdr)->caplen)	/* packed Rx queues */
+
+/* size of the shared queue header, followed by the Rx and Tx queues memory */
+
+#define PFQ_SHARED_QUEUE_HDR_SIZE(n)		(sizeof(struct pfq_shared_queue) + (n) * sizeof(struct pfq_shared_tx_queue))
 
 
 /* PFQ socket options */
@@ -104,6 +109,7 @@ typedef uint8_t  pfq_qver_t;
 #define Q_SO_SET_TX_LEN			6
 #define Q_SO_SET_TX_SLOTS		7
 #define Q_SO_SET_WEIGHT			8
+#define Q_SO_SET_TX_ZCOPY		9	/* zero-copy transmission from the shared Tx queues */
 
 #define Q_SO_GROUP_BIND			10
 #define Q_SO_GROUP_UNBIND		11
@@ -131,10 +137,23 @@ typedef uint8_t  pfq_qver_t;
 #define Q_SO_GET_GROUP_STATS		31
 #define Q_SO_GET_GROUP_COUNTERS		32
 #define Q_SO_GET_WEIGHT			33
+#define Q_SO_GET_TX_ZCOPY		34
+#define Q_SO_GET_TX_QUEUES		35
+#define Q_SO_GET_RX_RINGS		36
+#define Q_SO_GET_RX_PACKED		37
+#define Q_SO_GET_RX_BACKPRESSURE	38
+#define Q_SO_GET_RX_WAKEUP		39
 
 #define Q_SO_TX_BIND			40
 #define Q_SO_TX_UNBIND			41
 #define Q_SO_TX_QUEUE_XMIT	        42
+#define Q_SO_TX_RATE			43	/* token bucket of a socket Tx queue */
+#define Q_SO_SET_TX_QUEUES		44	/* number of async Tx queues mapped (set before enable) */
+#define Q_SO_GROUP_EBPF			45	/* eBPF program (fd) per group */
+#define Q_SO_SET_RX_RINGS		46	/* number of Rx sub-rings (set before enable) */
+#define Q_SO_SET_RX_PACKED		47	/* variable-length Rx slots (set before enable) */
+#define Q_SO_SET_RX_BACKPRESSURE	48	/* hold packets on full Rx queue, high-watermark wakeup */
+#define Q_SO_SET_RX_WAKEUP		49	/* batched Rx readiness (poll/epoll) */
 
 /* general placeholders */
 
@@ -147,7 +166,10 @@ typedef uint8_t  pfq_qver_t;
 /* timestamp */
 
 #define Q_TSTAMP_OFF			0	/*default*/
-#define Q_TSTAMP_ON			1
+#define Q_TSTAMP_ON			1	/* software (same as Q_TSTAMP_SW) */
+#define Q_TSTAMP_SW			1	/* software, taken at capture (NAPI) */
+#define Q_TSTAMP_HW_RAW			2	/* NIC clock (software if not stamped by the NIC) */
+#define Q_TSTAMP_HW_SYS			3	/* NIC time in system clock (kernels < 3.17, software otherwise) */
 
 
 /* vlan */
@@ -181,7 +203,9 @@ typedef uint8_t  pfq_qver_t;
 /* additional constants */
 
 #define Q_MAX_COUNTERS			64
-#define Q_MAX_TX_QUEUES			4
+#define Q_DEF_TX_QUEUES			4
+#define Q_MAX_TX_QUEUES			64
+#define Q_MAX_RX_RINGS			32
 #define Q_MAX_RX_NAPI			4
 
 
@@ -204,6 +228,13 @@ typedef uint8_t  pfq_qver_t;
 #define	Q_KEY_ICMP_CODE			(1ULL << 12)
 
 
+/* steering hash families (steer_flow_hash, steer_key_hash) */
+
+#define Q_STEER_HASH_XOR		0
+#define Q_STEER_HASH_TOEPLITZ		1
+#define Q_STEER_HASH_MIX		2
+
+
 /* PFQ socket queue */
 
 struct pfq_shared_rx_queue
@@ -212,6 +243,8 @@ struct pfq_shared_rx_queue
         unsigned int            len;        /* queue length in slots */
         unsigned int            size;       /* queue size in bytes */
         unsigned int            slot_size;  /* sizeof(pfq_pkthdr) + caplen  */
+        unsigned int            packed;     /* packed slots: shinfo counts bytes, each packet takes
+                                               PFQ_SHARED_QUEUE_PKTHDR_STRIDE(hdr) bytes */
 
 } ____pfq_cacheline_aligned;
 
@@ -233,17 +266,30 @@ struct pfq_shared_tx_queue
 	{
 		unsigned int		index;
 		ptrdiff_t		off;
+		unsigned int		kick;		/* the Tx thread is parked: the producer must wake it
+							   with Q_SO_TX_QUEUE_XMIT (queue = async index + 1) */
 
 	} cons ____pfq_cacheline_aligned;
 
+	struct
+	{
+		unsigned int		pending[2];	/* zero-copy packets still referencing each half of the queue:
+							   the producer must not reuse a half until its counter drops to 0 */
+	} zcopy ____pfq_cacheline_aligned;
+
 } ____pfq_cacheline_aligned;
 
 
+/* Rx sub-rings: the producing cpu n copies packets into the ring n % rx_ring_num.
+ * Each ring is a double-buffered queue of rx.len slots, laid out one after another. */
+
 struct pfq_shared_queue
 {
-        struct pfq_shared_rx_queue rx;
+        struct pfq_shared_rx_queue rx[Q_MAX_RX_RINGS];
         struct pfq_shared_tx_queue tx;
-        struct pfq_shared_tx_queue tx_async[Q_MAX_TX_QUEUES];
+	unsigned int		   rx_ring_num;		/* number of Rx sub-rings in use */
+	unsigned int		   tx_async_num;	/* number of async Tx queues that follow */
+        struct pfq_shared_tx_queue tx_async[];
 };
 
 
@@ -290,11 +336,7 @@ struct pfq_pkthdr
 {
         union
         {
-                uint64_t	    tv64;
-                struct {
-                        uint32_t    sec;
-                        uint32_t    nsec;
-                } tv;				/* note: compact timespec */
+                uint64_t	    tv64;	/* nanoseconds (Rx: per Q_SO_SET_RX_TSTAMP source, Tx: departure time) */
 
         } tstamp;
 
@@ -306,6 +348,10 @@ struct pfq_pkthdr
 
 
 
+#define PFQ_PKTHDR_TSTAMP_SEC(hdr)	((hdr)->tstamp.tv64 / 1000000000ULL)
+#define PFQ_PKTHDR_TSTAMP_NSEC(hdr)	((hdr)->tstamp.tv64 % 1000000000ULL)
+
+
 /*
    +------------------+---------------------+                  +---------------------+          +---------------------+
    | pfq_queue_hdr    | pfq_pkthdr | packet | ...              | pfq_pkthdr | packet |...       | pfq_pkthdr | packet | ...
@@ -397,6 +443,15 @@ struct pfq_so_binding
         int qindex;
 };
 
+struct pfq_so_tx_rate
+{
+        int		queue;		/* socket Tx queue: -1 = sync queue, 0.. async queues */
+        unsigned long	pps;		/* packets per second (0 = unlimited) */
+        unsigned long	bps;		/* bits per second (0 = unlimited) */
+        unsigned int	burst_pkts;	/* bucket depth in packets */
+        unsigned int	burst_bytes;	/* bucket depth in bytes */
+};
+
 struct pfq_so_group_join
 {
         int gid;
@@ -429,6 +484,42 @@ struct pfq_so_fprog
 };
 
 
+/* pfq_ebpf: per-group eBPF program (BPF_PROG_TYPE_SOCKET_FILTER), fd = -1 to detach */
+
+#define Q_EBPF_FILTER			0	/* return value: 0 drops the packet */
+#define Q_EBPF_STEER			1	/* return value: steering hash (0 drops) */
+#define Q_EBPF_CLASS			2	/* return value: class mask (0 drops) */
+
+struct pfq_so_ebpf
+{
+        int gid;
+        int fd;
+        int mode;
+};
+
+
+/* Rx back-pressure: packets that do not fit the Rx queue are held (per cpu, up to
+ * a bounded number) and redelivered in order at the next batch or timer tick */
+
+struct pfq_so_rx_backpressure
+{
+        int             hold;		/* 1 = lossless: hold packets when the Rx queue is full */
+        unsigned int    hold_usec;	/* max time a packet is held, then it is lost (<= 1000000) */
+        unsigned int    watermark;	/* wake up the consumer when the Rx queue fills above this percentage (0 = off) */
+};
+
+
+/* batched Rx wakeups: the socket is readable (poll/epoll) when packets packets
+ * are pending, or when the oldest pending packet has waited usec microseconds.
+ * Both 0: readable as soon as the Rx queue is not empty */
+
+struct pfq_so_rx_wakeup
+{
+        unsigned int    packets;	/* 0 = off */
+        unsigned int    usec;		/* 0 = off */
+};
+
+
 /* pfq statistics for socket and groups */
 
 struct pfq_stats
@@ -443,6 +534,12 @@ struct pfq_stats
 
         unsigned long int frwd;		/* forwarded to devices */
         unsigned long int kern;		/* passed to kernel */
+
+        unsigned long int timed;	/* sent at their timestamp (active timestamping) */
+        unsigned long int late;		/* timed packets sent behind schedule */
+        unsigned long int lateness;	/* total lateness of timed packets (nsec) */
+
+        unsigned long int thrt;		/* packets delayed by the Tx token bucket */
 };
 
 
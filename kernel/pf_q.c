@@ -52,6 +52,7 @@
 #include <linux/pf_q.h>
 
 #include <lang/symtable.h>
+#include <lang/hash.h>
 
 #include <pfq/global.h>
 #include <pfq/devmap.h>
@@ -119,7 +120,6 @@ pfq_release(struct socket *sock)
 	/* release the socket id */
 
 	pr_devel("[PFQ|%d] releasing id...\n", so->id);
-	msleep(Q_GRACE_PERIOD);
 	pfq_sock_release_id(so->id);
 
 #if 0
@@ -155,10 +155,10 @@ pfq_poll(struct file *file, struct socket *sock, poll_table * wait)
 
 	poll_wait(file, &so->waitqueue, wait);
 
-        if(!pfq_sock_rx_shared_queue(so))
+        if(!pfq_sock_rx_shared_queue(so, 0))
                 return mask;
 
-        if (pfq_mpsc_queue_len(so) > 0)
+        if (pfq_sock_rx_ready(so, ktime_to_ns(ktime_get()), NULL))
                 mask |= POLLIN | POLLRDNORM;
 
         return mask;
@@ -176,7 +176,7 @@ static int pfq_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 		}
 
 		if (likely(arg == 0)) { /* transmit Tx queue */
-			tx_response_t tx = pfq_sk_queue_xmit(so, -1, Q_NO_KTHREAD);
+			tx_response_t tx = pfq_sk_queue_xmit(so, -1, Q_NO_KTHREAD, NULL, 0);
 
 			sparse_add(so->stats, sent, tx.ok);
 			sparse_add(so->stats, fail, tx.fail);
@@ -185,6 +185,10 @@ static int pfq_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			return 0;
 		}
 
+		if (arg <= so->txq_num_async) { /* kick the Tx thread of an async queue */
+			return pfq_wakeup_tx_thread(so->tx_async[arg-1].tid);
+		}
+
 		printk(KERN_INFO "[PFQ|%d] QIOCTX queue: bad argument %lu!\n", so->id, arg);
 		return -EINVAL;
 	}
@@ -416,9 +420,9 @@ static int __init pfq_init_module(void)
 
 	/* check options */
 
-        if (global->capt_batch_len <= 0 || global->capt_batch_len >= Q_BUFF_BATCH_LEN) {
-                printk(KERN_INFO "[PFQ] capt_batch_len=%d not allowed: valid range (0,%d)!\n",
-                       global->capt_batch_len, Q_BUFF_BATCH_LEN);
+        if (global->capt_batch_len <= 0 || global->capt_batch_len > Q_BUFF_QUEUE_LEN) {
+                printk(KERN_INFO "[PFQ] capt_batch_len=%d not allowed: valid range (0,%d]!\n",
+                       global->capt_batch_len, Q_BUFF_QUEUE_LEN);
                 return -EFAULT;
         }
 
@@ -475,6 +479,9 @@ static int __init pfq_init_module(void)
         printk(KERN_INFO "[PFQ] skb pool initialized.\n");
 #endif
 
+	/* steering hash tables and key */
+	pfq_lang_hash_init();
+
 	/* register pfq-lang default functions */
 	pfq_lang_symtable_init();
 
@@ -514,6 +521,7 @@ static int __init pfq_init_module(void)
         printk(KERN_INFO "[PFQ] vlan_untag      : %d\n", global->vlan_untag);
         printk(KERN_INFO "[PFQ] skb_tx_pool_size: %d\n", global->skb_tx_pool_size);
         printk(KERN_INFO "[PFQ] skb_rx_pool_size: %d\n", global->skb_rx_pool_size);
+        printk(KERN_INFO "[PFQ] tx_poll         : %d usec\n", global->tx_poll);
         printk(KERN_INFO "[PFQ] skb_size        : %zu\n", sizeof(struct sk_buff));
         printk(KERN_INFO "[PFQ] ready!\n");
         return 0;
@@ -570,8 +578,8 @@ static void __exit pfq_exit_module(void)
         /* disable direct capture */
         pfq_devmap_toggle_reset();
 
-        /* wait grace period */
-        msleep(Q_GRACE_PERIOD);
+        /* wait for the Rx batches in flight */
+        synchronize_rcu();
 
         /* free per CPU data */
         total += pfq_percpu_destruct();
@@ -590,6 +598,8 @@ static void __exit pfq_exit_module(void)
 
 	pfq_groups_destruct();
 
+	pfq_devmap_free();
+
         printk(KERN_INFO "[PFQ] unloaded.\n");
 }
 
@@ -26,6 +26,7 @@
 #define PFQ_ALLOC_H
 
 #include <linux/gfp.h>
+#include <linux/mm.h>
 
 inline static
 void *pfq_malloc_pages(size_t size, gfp_t gfp_flags)
@@ -39,6 +40,20 @@ void *pfq_malloc_pages(size_t size, gfp_t gfp_flags)
 }
 
 
+inline static
+void *pfq_malloc_pages_node(size_t size, gfp_t gfp_flags, int node)
+{
+	struct page *page;
+	int po;
+	if (WARN_ON(!size))
+		return NULL;
+	gfp_flags |= __GFP_COMP;
+	po = get_order(size);
+	page = alloc_pages_node(node, gfp_flags, po);
+	return page ? page_address(page) : NULL;
+}
+
+
 inline static
 void pfq_free_pages(void *addr, size_t size)
 {
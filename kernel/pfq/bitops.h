@@ -24,6 +24,8 @@
 #ifndef PFQ_BITOPS_H
 #define PFQ_BITOPS_H
 
+#include <linux/types.h>
+
 static inline
 int __128bit_popcount(unsigned __int128 x)
 {
@@ -61,4 +63,81 @@ int __128bit_ctz(unsigned __int128 x)
 }
 
 
+/*
+ * multi-word bitmap (array of unsigned long), scanned one word at a time...
+ */
+
+#define PFQ_BITMAP_WORD_BITS		(sizeof(unsigned long)<<3)
+#define PFQ_BITMAP_WORDS(bits)		(((bits) + PFQ_BITMAP_WORD_BITS - 1) / PFQ_BITMAP_WORD_BITS)
+
+
+static inline
+void pfq_bitmap_set(unsigned long *map, size_t n)
+{
+	map[n / PFQ_BITMAP_WORD_BITS] |= 1UL << (n % PFQ_BITMAP_WORD_BITS);
+}
+
+
+static inline
+void pfq_bitmap_clear(unsigned long *map, size_t n)
+{
+	map[n / PFQ_BITMAP_WORD_BITS] &= ~(1UL << (n % PFQ_BITMAP_WORD_BITS));
+}
+
+
+static inline
+bool pfq_bitmap_test(unsigned long const *map, size_t n)
+{
+	return (map[n / PFQ_BITMAP_WORD_BITS] >> (n % PFQ_BITMAP_WORD_BITS)) & 1;
+}
+
+
+static inline
+void pfq_bitmap_zero(unsigned long *map, size_t bits)
+{
+	size_t n;
+	for(n = 0; n < PFQ_BITMAP_WORDS(bits); n++)
+		map[n] = 0;
+}
+
+
+static inline
+size_t pfq_bitmap_weight(unsigned long const *map, size_t bits)
+{
+	size_t n, ret = 0;
+	for(n = 0; n < PFQ_BITMAP_WORDS(bits); n++)
+		ret += pfq_popcount(map[n]);
+	return ret;
+}
+
+
+/* return the index of the first bit set in [from, bits), or bits if none */
+
+static inline
+size_t pfq_bitmap_next(unsigned long const *map, size_t from, size_t bits)
+{
+	size_t w = from / PFQ_BITMAP_WORD_BITS, n;
+	unsigned long word;
+
+	if (from >= bits)
+		return bits;
+
+	word = map[w] & (~0UL << (from % PFQ_BITMAP_WORD_BITS));
+
+	while (!word) {
+		if (++w >= PFQ_BITMAP_WORDS(bits))
+			return bits;
+		word = map[w];
+	}
+
+	n = w * PFQ_BITMAP_WORD_BITS + pfq_ctz(word);
+	return n < bits ? n : bits;
+}
+
+
+#define pfq_bitmap_foreach(map, bits, n) \
+	for((n) = pfq_bitmap_next((map), 0, (bits)); (n) < (bits); \
+		(n) = pfq_bitmap_next((map), (n)+1, (bits)))
+
+
 #endif /* PFQ_BITOPS_H */
@@ -26,6 +26,7 @@
 #include <linux/version.h>
 #include <linux/module.h>
 #include <linux/filter.h>
+#include <linux/bpf.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <net/sock.h>
@@ -82,3 +83,28 @@ pfq_free_sk_filter(struct sk_filter *filter)
 }
 
 
+
+
+/* eBPF socket filter programs, by file descriptor (JIT-compiled by the kernel, if enabled) */
+
+struct bpf_prog *
+pfq_get_ebpf_prog(int fd)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
+	struct bpf_prog *prog = bpf_prog_get_type(fd, BPF_PROG_TYPE_SOCKET_FILTER);
+	if (IS_ERR(prog))
+		pr_devel("[PFQ] eBPF: bpf_prog_get_type error: (%ld)!\n", PTR_ERR(prog));
+	return prog;
+#else
+	return ERR_PTR(-EOPNOTSUPP);
+#endif
+}
+
+
+void
+pfq_put_ebpf_prog(struct bpf_prog *prog)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
+	bpf_prog_put(prog);
+#endif
+}
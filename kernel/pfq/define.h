@@ -32,17 +32,32 @@
 
 #define Q_BUFF_LOG_LEN			16
 #define Q_BUFF_QUEUE_LEN		512
+#define Q_BUFF_FWD_TABLE_LEN		(Q_BUFF_QUEUE_LEN * Q_BUFF_LOG_LEN)	/* every packet of a batch forwarded to Q_BUFF_LOG_LEN devices */
+#define Q_BUFF_MASK_WORDS		(Q_BUFF_QUEUE_LEN/((int)sizeof(long)<<3))
+#define Q_RX_STASH_LEN			256	/* per-cpu packets held for the lossless sockets (<= Q_BUFF_QUEUE_LEN) */
+#define Q_RX_HOLD_MAX_USEC		1000000	/* max time a packet is held (it pins its device) */
 
 #define Q_MAX_STEERING_MASK	        512
 
+#define Q_STEER_TABLE_BITS		12
+#define Q_STEER_TABLE_LEN		(1 << Q_STEER_TABLE_BITS)
+#define Q_STEER_MAP_LEN			16
+
 #define Q_MAX_DEVICE			4096
 #define Q_MAX_DEVICE_MASK		(Q_MAX_DEVICE-1)
 #define Q_MAX_QUEUE			256
 #define Q_MAX_QUEUE_MASK		(Q_MAX_QUEUE-1)
 
 #define Q_MAX_TX_SKB_COPY		256
+#define Q_TX_ZCOPY_HEAD			128 /* bytes copied into the linear part of zero-copy skbs */
+#define Q_TX_BUSY_WAIT			100000 /* nsec: timed packets closer than this are busy-waited (like pktgen) */
+#define Q_TX_MAX_SLEEP			1000000 /* nsec: max sleep of Tx threads waiting for timed packets */
+#define Q_TX_LATE			10000 /* nsec: timed packets sent later than this are accounted as late */
+#define Q_TX_PARK_TIMEOUT		100 /* msec: parked Tx threads poll their queues at least this often */
+#define Q_TX_QUEUE_BUDGET		256 /* packets: max per queue in a Tx thread round (round-robin fairness) */
 
 #define Q_GRACE_PERIOD			200 /* msec */
+#define Q_TX_ZCOPY_TIMEOUT		10000 /* msec, wait for the drivers to release the zero-copy packets */
 
 #define Q_FUN_SYMB_LEN			256
 #define Q_FUN_SIGN_LEN			1024
@@ -25,29 +25,133 @@
 #include <pfq/devmap.h>
 #include <pfq/group.h>
 #include <pfq/kcompat.h>
+#include <pfq/netdev.h>
 #include <pfq/printk.h>
 #include <pfq/thread.h>
 
+#include <linux/slab.h>
 
-void pfq_devmap_toggle_update(void)
+
+#define devmap_deref(p)	rcu_dereference_protected(p, lockdep_is_held(&global->devmap_lock))
+
+
+/* capture is enabled on a device if any group is bound to it (or to any device) */
+
+static void pfq_devmap_toggle_update(int index)
 {
-    int i,j;
+    bool any = devmap_deref(global->devmap_any) != NULL;
+    int i;
+
+    if (index != Q_ANY_DEVICE) {
+        index &= Q_MAX_DEVICE_MASK;
+        atomic_set(&global->devmap_toggle[index], (any || devmap_deref(global->devmap[index])) ? 1 : 0);
+        return;
+    }
+
     for(i=0; i < Q_MAX_DEVICE; ++i)
     {
-        unsigned long val = 0;
-        for(j=0; j < Q_MAX_QUEUE; ++j)
-        {
-            val |= (unsigned long)atomic_long_read(&global->devmap[i][j]);
+        atomic_set(&global->devmap_toggle[i], (any || devmap_deref(global->devmap[i])) ? 1 : 0);
+    }
+}
+
+
+/* the queues of an entry: the Rx queues of the device, or more if a larger queue is bound */
+
+static int pfq_devmap_nqueues(int index, int queue)
+{
+    int n = 0;
+
+    if (index != Q_ANY_DEVICE) {
+        struct net_device *dev = pfq_dev_get_by_index(index);
+        if (dev) {
+            n = dev->num_rx_queues;
+            dev_put(dev);
+        }
+    }
+
+    return min_t(int, max_t(int, n, queue + 1), Q_MAX_QUEUE);
+}
+
+
+/* replace an entry with an updated copy (NULL when no group is left) */
+
+static int pfq_devmap_entry_update(struct pfq_devmap_entry __rcu **slot, int action, int index, int queue, unsigned long bit)
+{
+    struct pfq_devmap_entry *old, *entry;
+    bool expand = false;
+    int nqueues, q;
+
+    old = devmap_deref(*slot);
+
+    if (action == Q_DEVMAP_RESET && (!old || !(old->all & bit)))
+        return 0;
+
+    nqueues = old ? old->nqueues : 0;
+
+    if (action == Q_DEVMAP_SET && queue >= nqueues)
+        nqueues = pfq_devmap_nqueues(index, queue);
+
+    /* reset a single queue of a group bound to any queue: the group is
+     * rebound to every other queue (all of them for the any-device entry) */
+
+    if (action == Q_DEVMAP_RESET && queue != Q_ANY_QUEUE && (old->any & bit)) {
+        expand = true;
+        nqueues = max_t(int, nqueues, index == Q_ANY_DEVICE ? Q_MAX_QUEUE : pfq_devmap_nqueues(index, queue));
+    }
+
+    entry = kzalloc(sizeof(*entry) + nqueues * sizeof(unsigned long), GFP_KERNEL);
+    if (!entry)
+        return -ENOMEM;
+
+    entry->nqueues = nqueues;
+
+    if (old) {
+        entry->any = old->any;
+        memcpy(entry->queue, old->queue, old->nqueues * sizeof(unsigned long));
+    }
+
+    if (expand) {
+        entry->any &= ~bit;
+        for(q = 0; q < nqueues; ++q)
+            entry->queue[q] |= bit;
+    }
+
+    if (action == Q_DEVMAP_SET) {
+        if (queue == Q_ANY_QUEUE)
+            entry->any |= bit;
+        else
+            entry->queue[queue] |= bit;
+    }
+    else {
+        if (queue == Q_ANY_QUEUE) {
+            entry->any &= ~bit;
+            for(q = 0; q < nqueues; ++q)
+                entry->queue[q] &= ~bit;
         }
+        else if (queue < nqueues)
+            entry->queue[queue] &= ~bit;
+    }
+
+    entry->all = entry->any;
+    for(q = 0; q < nqueues; ++q)
+        entry->all |= entry->queue[q];
 
-        atomic_set(&global->devmap_toggle[i], val ? 1 : 0);
+    if (!entry->all) {
+        kfree(entry);
+        entry = NULL;
     }
+
+    rcu_assign_pointer(*slot, entry);
+    if (old)
+        kfree_rcu(old, rcu);
+    return 1;
 }
 
 
 int pfq_devmap_update(int action, int index, int queue, pfq_gid_t gid)
 {
-    int n = 0, i,q;
+    unsigned long bit;
+    int n = 0, i, ret;
 
     if (unlikely((__force int)gid >= Q_MAX_GID ||
 		 (__force int)gid < 0)) {
@@ -55,43 +159,80 @@ int pfq_devmap_update(int action, int index, int queue, pfq_gid_t gid)
         return 0;
     }
 
+    if (unlikely(queue < Q_ANY_QUEUE || queue >= Q_MAX_QUEUE)) {
+        pr_devel("[PF_Q] devmap_update: bad queue (%d)\n", queue);
+        return -EINVAL;
+    }
+
+    bit = 1UL << (__force int)gid;
+
     mutex_lock(&global->devmap_lock);
 
-    for(i=0; i < Q_MAX_DEVICE; ++i)
-    {
-        for(q=0; q < Q_MAX_QUEUE; ++q)
+    /* a group bound to any device cannot be unbound from a single device:
+     * the any-device entry also covers the devices registered later on */
+
+    if (action == Q_DEVMAP_RESET && index != Q_ANY_DEVICE) {
+        struct pfq_devmap_entry *any = devmap_deref(global->devmap_any);
+        unsigned long groups = queue == Q_ANY_QUEUE ? (any ? any->all : 0)
+                                                    : pfq_devmap_entry_groups(any, queue);
+        if (groups & bit) {
+            pr_devel("[PF_Q] devmap_update: gid=%d is bound to any device (ifindex=%d queue=%d)\n", gid, index, queue);
+            mutex_unlock(&global->devmap_lock);
+            return -EINVAL;
+        }
+    }
+
+    if (index != Q_ANY_DEVICE) {
+        ret = pfq_devmap_entry_update(&global->devmap[index & Q_MAX_DEVICE_MASK], action, index, queue, bit);
+        n = ret;
+    }
+    else {
+        ret = pfq_devmap_entry_update(&global->devmap_any, action, index, queue, bit);
+        n = ret;
+
+        /* reset: the group is removed from the matching queues of every device */
+
+        for(i=0; ret >= 0 && action == Q_DEVMAP_RESET && i < Q_MAX_DEVICE; ++i)
         {
-            long tmp;
-
-            if (!pfq_devmap_equal(i, q, index, queue))
-                continue;
-
-            /* map_set... */
-            if (action == Q_DEVMAP_SET) {
-
-                tmp = atomic_long_read(&global->devmap[i][q]);
-                tmp |= 1L << (__force int)gid;
-                atomic_long_set(&global->devmap[i][q], tmp);
-                n++;
-                continue;
-            }
-
-            /* map_reset */
-            tmp = atomic_long_read(&global->devmap[i][q]);
-            if (tmp & (1L << (__force int)gid)) {
-                tmp &= ~(1L << (__force int)gid);
-                atomic_long_set(&global->devmap[i][q], tmp);
-                n++;
-                continue;
-            }
+            ret = pfq_devmap_entry_update(&global->devmap[i], action, i, queue, bit);
+            n += ret;
         }
     }
 
     /* update capture toggle filter... */
 
-    pfq_devmap_toggle_update();
+    pfq_devmap_toggle_update(index);
 
     mutex_unlock(&global->devmap_lock);
-    return n;
+    return ret < 0 ? ret : n;
 }
 
+
+void pfq_devmap_free(void)
+{
+    struct pfq_devmap_entry *entry;
+    int i;
+
+    mutex_lock(&global->devmap_lock);
+
+    for(i=0; i < Q_MAX_DEVICE; ++i)
+    {
+        entry = devmap_deref(global->devmap[i]);
+        RCU_INIT_POINTER(global->devmap[i], NULL);
+        if (entry)
+            kfree_rcu(entry, rcu);
+    }
+
+    entry = devmap_deref(global->devmap_any);
+    RCU_INIT_POINTER(global->devmap_any, NULL);
+    if (entry)
+        kfree_rcu(entry, rcu);
+
+    pfq_devmap_toggle_update(Q_ANY_DEVICE);
+
+    mutex_unlock(&global->devmap_lock);
+
+    /* wait for the pending frees before the module is unloaded */
+
+    rcu_barrier();
+}
@@ -30,8 +30,10 @@
 #include <pfq/define.h>
 #include <pfq/kcompat.h>
 
+#include <linux/rcupdate.h>
 
-/* pfq devmap */
+
+/* pfq devmap: per-ifindex entries, replaced under RCU on bind/unbind */
 
 enum
 {      Q_DEVMAP_RESET,
@@ -39,30 +41,46 @@ enum
 };
 
 
+struct pfq_devmap_entry
+{
+	struct rcu_head		rcu;
+	unsigned long		any;		/* groups bound to any queue */
+	unsigned long		all;		/* union of the masks of the entry */
+	int			nqueues;
+	unsigned long		queue[];	/* groups bound to each queue */
+};
+
+
 /* called from u-context
 */
 
 extern int  pfq_devmap_update(int action, int index, int queue, pfq_gid_t gid);
+extern void pfq_devmap_free(void);
 
 
 static inline
-int pfq_devmap_equal(int i1, int q1, int i2, int q2)
+unsigned long pfq_devmap_entry_groups(struct pfq_devmap_entry const *entry, int queue)
 {
-        return  (i1 == i2 && q1 == q2) ||
-                (i1 == i2 && q2 == -1) ||
-                (i2 == -1 && q1 == q2) ||
-                (i2 == -1 && q2 == -1);
+	if (!entry)
+		return 0;
+	if ((unsigned int)queue < (unsigned int)entry->nqueues)
+		return entry->any | entry->queue[queue];
+	return entry->any;
 }
 
 
 static inline
 unsigned long pfq_devmap_get_groups(int dev, int queue)
 {
-        return (long unsigned)atomic_long_read(&global->devmap[dev & Q_MAX_DEVICE_MASK][queue & Q_MAX_QUEUE_MASK]);
-}
+	unsigned long ret;
 
+	rcu_read_lock();
+	ret = pfq_devmap_entry_groups(rcu_dereference(global->devmap[dev & Q_MAX_DEVICE_MASK]), queue) |
+	      pfq_devmap_entry_groups(rcu_dereference(global->devmap_any), queue);
+	rcu_read_unlock();
+	return ret;
+}
 
-extern void pfq_devmap_toggle_update(void);
 
 static inline
 int pfq_devmap_toggle_get(int index)
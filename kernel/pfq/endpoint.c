@@ -33,19 +33,16 @@
 
 
 void
-pfq_get_lazy_endpoints( struct pfq_qbuff_queue *qb
+pfq_get_lazy_endpoints( struct pfq_qbuff_fwd_table const *table
 		      , struct pfq_endpoint_info *ts)
 {
-	size_t n, i;
+	size_t n;
 	ts->num = 0;
         ts->cnt_total = 0;
 
-	for(n = 0; n < qb->len; ++n)
+	for(n = 0; n < table->len; ++n)
 	{
-		for(i = 0; i < qb->queue[n].fwd_dev_num; i++)
-		{
-			pfq_add_dev_to_endpoints(qb->queue[n].fwd_dev[i], ts);
-		}
+		pfq_add_dev_to_endpoints(table->fwd[n].dev, ts);
 	}
 }
 
@@ -79,18 +76,19 @@ pfq_add_dev_to_endpoints( struct net_device *dev
 static inline
 size_t copy_to_user_qbuffs( struct pfq_sock *so
 			  , struct pfq_qbuff_queue *buffs
-			  , unsigned __int128 mask
+			  , struct pfq_qbuff_mask const *mask
 			  , int cpu)
 {
-        size_t cpy, len = pfq_popcount(mask);
+        size_t cpy, len = qbuff_mask_weight(mask, buffs->len);
 
 	__sparse_add(so->stats, recv, len, cpu);
 
-        if (likely(pfq_sock_rx_shared_queue(so) != NULL)) {
+        if (likely(pfq_sock_shared_queue(so) != NULL)) {
 
 		smp_rmb();
 
-                cpy = pfq_sk_queue_recv(so, buffs, mask, (int)len);
+                cpy = so->rx_hold ? pfq_sk_queue_recv_hold(so, buffs, mask, (int)len, cpu)
+				  : pfq_sk_queue_recv(so, buffs, mask, (int)len, cpu);
 		if (len > cpy)
 			__sparse_add(so->stats, lost, len - cpy, cpu);
 
@@ -106,7 +104,7 @@ size_t copy_to_user_qbuffs( struct pfq_sock *so
 static inline
 size_t copy_to_dev_qbuffs( struct pfq_sock *so
 			 , struct pfq_qbuff_queue *buffs
-			 , unsigned __int128 mask
+			 , struct pfq_qbuff_mask const *mask
 			 , int cpu)
 {
 	struct net_device *dev;
@@ -134,7 +132,7 @@ size_t copy_to_dev_qbuffs( struct pfq_sock *so
 size_t
 pfq_copy_to_endpoint_qbuffs( struct pfq_sock *so
 			   , struct pfq_qbuff_queue *buffs
-			   , unsigned __int128 mask
+			   , struct pfq_qbuff_mask const *mask
 			   , int cpu)
 {
 	switch(so->egress_type)
@@ -41,12 +41,15 @@ struct pfq_global_data default_global =
 	.tx_cpu			= {0},
 	.tx_cpu_nr		= 0,
 	.tx_retry		= 1,
+	.tx_poll		= 100,
 
-	.socket_ptr		= {{0}},
+	.socket_ptr		= { NULL },
 	.socket_count		= {0},
+	.socket_tag		= {0},
      // .socket_lock		= {{0}},
 
-	.devmap			= {{{0}}},
+	.devmap			= {NULL},
+	.devmap_any		= NULL,
 	.devmap_toggle		= {{0}},
      // .devmap_lock		= {{0}},
 
@@ -35,6 +35,8 @@ struct pfq_kernel_stats __percpu;
 struct pfq_memory_stats __percpu;
 struct pfq_percpu_data  __percpu;
 struct pfq_percpu_pool  __percpu;
+struct pfq_devmap_entry;
+struct pfq_sock;
 
 
 struct pfq_global_data
@@ -53,12 +55,15 @@ struct pfq_global_data
 	int tx_cpu[Q_MAX_CPU];
 	int tx_cpu_nr;
 	int tx_retry;
+	int tx_poll;
 
-	atomic_long_t   socket_ptr[Q_MAX_ID];
+	struct pfq_sock __rcu *socket_ptr[Q_MAX_ID];
 	atomic_t        socket_count;
+	atomic_t        socket_tag;		/* unique tag of each socket instance */
 	struct mutex	socket_lock;
 
-	atomic_long_t   devmap [Q_MAX_DEVICE][Q_MAX_QUEUE];
+	struct pfq_devmap_entry __rcu *devmap [Q_MAX_DEVICE];
+	struct pfq_devmap_entry __rcu *devmap_any;	/* groups bound to any device */
 	atomic_t        devmap_toggle [Q_MAX_DEVICE];
 	struct mutex	devmap_lock;
 
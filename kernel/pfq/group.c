@@ -32,8 +32,12 @@
 #include <pfq/group.h>
 #include <pfq/kcompat.h>
 #include <pfq/percpu.h>
+#include <pfq/steer.h>
 #include <pfq/thread.h>
 
+static void pfq_group_steer_work(struct work_struct *work);
+
+
 void
 pfq_group_lock(void)
 {
@@ -52,6 +56,15 @@ int
 pfq_groups_init(void)
 {
 	int n;
+	for(n = 0; n < Q_MAX_GID; n++)
+	{
+		struct pfq_group * group = &global->groups[n];
+
+		RCU_INIT_POINTER(group->steer_map, NULL);
+		atomic_long_set(&group->steer_miss, 0);
+		INIT_WORK(&group->steer_work, pfq_group_steer_work);
+	}
+
 	for(n = 0; n < Q_MAX_GID; n++)
 	{
 		struct pfq_group * group = &global->groups[n];
@@ -92,11 +105,17 @@ pfq_groups_destruct(void)
 	{
 		struct pfq_group * group = &global->groups[n];
 
+		cancel_work_sync(&group->steer_work);
+		pfq_steer_map_free(rcu_dereference_protected(group->steer_map, 1));
+		RCU_INIT_POINTER(group->steer_map, NULL);
+
 		free_percpu(group->stats);
 		free_percpu(group->counters);
 		group->stats = NULL;
 		group->counters = NULL;
 	}
+
+	rcu_barrier();	/* pending steering maps */
 }
 
 
@@ -161,6 +180,92 @@ pfq_group_access(pfq_gid_t gid, pfq_id_t id)
 }
 
 
+static unsigned long
+__pfq_group_class_sock_mask(struct pfq_group *group, unsigned long class_mask)
+{
+	unsigned long bit, mask = 0;
+
+	pfq_bitwise_foreach(class_mask, bit,
+	{
+		mask |= (unsigned long)atomic_long_read(&group->sock_id[pfq_ctz(bit)]);
+	});
+
+	return mask;
+}
+
+
+/* rebuild the steering tables of the group (after join, leave, a weight change or
+ * a miss on the Rx path): one table for every class with sockets, one for every
+ * combined class mask already in use, plus the requested one (if any).
+ */
+
+static void
+__pfq_group_update_steering(struct pfq_group *group, unsigned long extra)
+{
+	unsigned long class_mask[Q_STEER_MAP_LEN];
+	struct pfq_steer_map *map, *old;
+	size_t i, n, len = 0;
+
+	old = rcu_dereference_protected(group->steer_map, lockdep_is_held(&global->groups_lock));
+
+	for(i = 0; i < Q_CLASS_MAX && len < Q_STEER_MAP_LEN; i++)
+	{
+		if (atomic_long_read(&group->sock_id[i]))
+			class_mask[len++] = Q_CLASS(i);
+	}
+
+	for(i = 0; old && i < old->len && len < Q_STEER_MAP_LEN; i++)
+	{
+		unsigned long cm = old->table[i]->class_mask;
+		if ((cm & (cm - 1)) && __pfq_group_class_sock_mask(group, cm))
+			class_mask[len++] = cm;
+	}
+
+	for(i = 0; i < len; i++)
+	{
+		if (class_mask[i] == extra)
+			extra = 0;
+	}
+
+	if (extra && len < Q_STEER_MAP_LEN && __pfq_group_class_sock_mask(group, extra))
+		class_mask[len++] = extra;
+
+	map = kzalloc(sizeof(struct pfq_steer_map), GFP_KERNEL);
+	if (map) {
+		for(i = 0, n = 0; i < len; i++)
+		{
+			struct pfq_steer_table *table =
+				pfq_steer_table_build(class_mask[i], __pfq_group_class_sock_mask(group, class_mask[i]));
+			if (table)
+				map->table[n++] = table;
+		}
+		map->len = n;
+	}
+	else
+		printk(KERN_WARNING "[PFQ] steering map: out of memory!\n");
+
+	rcu_assign_pointer(group->steer_map, map);
+
+	pfq_steer_map_free_rcu(old);
+}
+
+
+static void
+pfq_group_steer_work(struct work_struct *work)
+{
+	struct pfq_group *group = container_of(work, struct pfq_group, steer_work);
+
+        mutex_lock(&global->groups_lock);
+
+	if (group->enabled)
+		__pfq_group_update_steering(group, (unsigned long)atomic_long_read(&group->steer_miss));
+
+	atomic_long_set(&group->steer_miss, 0);
+
+        mutex_unlock(&global->groups_lock);
+}
+
+
 static void
 __pfq_group_init(struct pfq_group *group, pfq_gid_t gid)
 {
@@ -176,30 +281,38 @@ __pfq_group_init(struct pfq_group *group, pfq_gid_t gid)
         }
 
         atomic_long_set(&group->bp_filter,0L);
+        RCU_INIT_POINTER(group->ebpf, NULL);
         atomic_long_set(&group->comp,     0L);
         atomic_long_set(&group->comp_ctx, 0L);
 
 	pfq_group_stats_reset(group->stats);
 	pfq_group_counters_reset(group->counters);
 
-	group->vlan_filt = false;
-
-	for(i = 0; i < 4096; i++) {
-		group->vid_filters[i] = 0;
-	}
+	RCU_INIT_POINTER(group->vlan_filter, NULL);
 
 	group->enabled = true;
         printk(KERN_INFO "[PFQ] Group (%d) enabled.\n", gid);
 }
 
 
+static void
+pfq_group_ebpf_free_rcu(struct rcu_head *head)
+{
+	struct pfq_group_ebpf *ebpf = container_of(head, struct pfq_group_ebpf, rcu);
+	pfq_put_ebpf_prog(ebpf->prog);
+	kfree(ebpf);
+}
+
+
 static void
 __pfq_group_free(struct pfq_group *group, pfq_gid_t gid)
 {
         struct sk_filter *filter;
+        struct pfq_group_ebpf *ebpf;
+        struct pfq_vlan_filter *vlan;
         struct pfq_lang_computation_tree *old_comp;
+        struct pfq_steer_map *old_steer;
         void *old_ctx;
-        size_t i;
 
         /* remove this gid from devmap matrix */
 
@@ -212,10 +325,21 @@ __pfq_group_free(struct pfq_group *group, pfq_gid_t gid)
         group->policy = Q_POLICY_GROUP_UNDEFINED;
 
         filter   = (struct sk_filter *)atomic_long_xchg(&group->bp_filter, 0L);
+
+        ebpf = rcu_dereference_protected(group->ebpf, lockdep_is_held(&global->groups_lock));
+        RCU_INIT_POINTER(group->ebpf, NULL);
+
+        vlan = rcu_dereference_protected(group->vlan_filter, lockdep_is_held(&global->groups_lock));
+        RCU_INIT_POINTER(group->vlan_filter, NULL);
         old_comp = (struct pfq_lang_computation_tree *)atomic_long_xchg(&group->comp, 0L);
         old_ctx  = (void *)atomic_long_xchg(&group->comp_ctx, 0L);
 
-        msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+        old_steer = rcu_dereference_protected(group->steer_map, lockdep_is_held(&global->groups_lock));
+        RCU_INIT_POINTER(group->steer_map, NULL);
+
+        synchronize_rcu();   /* the Rx path runs the group within an RCU read-side section */
+
+        pfq_steer_map_free_rcu(old_steer);
 
 	/* finalize old computation */
 
@@ -229,10 +353,11 @@ __pfq_group_free(struct pfq_group *group, pfq_gid_t gid)
 	if (filter)
 		pfq_free_sk_filter(filter);
 
-        group->vlan_filt = false;
-	for(i = 0; i < 4096; i++) {
-		group->vid_filters[i] = 0;
-	}
+	if (ebpf)
+		call_rcu(&ebpf->rcu, pfq_group_ebpf_free_rcu);
+
+	if (vlan)
+		kfree_rcu(vlan, rcu);
 
         printk(KERN_INFO "[PFQ] Group (%d) disabled.\n", gid);
 }
@@ -277,6 +402,8 @@ __pfq_group_join(pfq_gid_t gid, pfq_id_t id, unsigned long class_mask, int polic
 			group->pid = pfq_get_tgid();
 		if (group->policy == Q_POLICY_GROUP_UNDEFINED)
 			group->policy = policy;
+
+		__pfq_group_update_steering(group, 0);
 	}
 
 	pr_devel("[PFQ|%d] group %d, sock_ids { %lu %lu %lu %lu %lu...\n", id, gid,
@@ -294,6 +421,7 @@ static int
 __pfq_group_leave(pfq_gid_t gid, pfq_id_t id)
 {
         struct pfq_group * group;
+        bool joined;
         long tmp;
         size_t i;
 
@@ -301,6 +429,8 @@ __pfq_group_leave(pfq_gid_t gid, pfq_id_t id)
         if (group == NULL)
                 return -EINVAL;
 
+	joined = pfq_group_has_joined(gid, id);
+
         for(i = 0; i < Q_CLASS_MAX; ++i)
         {
                 tmp = atomic_long_read(&group->sock_id[i]);
@@ -310,6 +440,8 @@ __pfq_group_leave(pfq_gid_t gid, pfq_id_t id)
 
 	if (group->enabled && __pfq_group_is_empty(gid))
 		__pfq_group_free(group, gid);
+	else if (group->enabled && joined)
+		__pfq_group_update_steering(group, 0);
 
         return 0;
 }
@@ -348,13 +480,49 @@ pfq_group_set_filter(pfq_gid_t gid, struct sk_filter *filter)
 
         old_filter = (void *)atomic_long_xchg(&group->bp_filter, (long)filter);
 
-        msleep(Q_GRACE_PERIOD);
+        synchronize_rcu();
 
 	if (old_filter)
 		pfq_free_sk_filter(old_filter);
 }
 
 
+int
+pfq_group_set_ebpf(pfq_gid_t gid, struct bpf_prog *prog, int mode)
+{
+        struct pfq_group * group;
+        struct pfq_group_ebpf *ebpf = NULL, *old;
+
+	group = pfq_group_get(gid);
+        if (group == NULL) {
+		if (prog)
+			pfq_put_ebpf_prog(prog);
+                return -EINVAL;
+	}
+
+	if (prog) {
+		ebpf = kmalloc(sizeof(*ebpf), GFP_KERNEL);
+		if (!ebpf) {
+			pfq_put_ebpf_prog(prog);
+			return -ENOMEM;
+		}
+		ebpf->prog = prog;
+		ebpf->mode = mode;
+	}
+
+        mutex_lock(&global->groups_lock);
+
+	old = rcu_dereference_protected(group->ebpf, lockdep_is_held(&global->groups_lock));
+	rcu_assign_pointer(group->ebpf, ebpf);
+
+        mutex_unlock(&global->groups_lock);
+
+	if (old)
+		call_rcu(&old->rcu, pfq_group_ebpf_free_rcu);
+	return 0;
+}
+
+
 int
 pfq_group_set_prog(pfq_gid_t gid, struct pfq_lang_computation_tree *comp, void *ctx)
 {
@@ -371,7 +539,7 @@ pfq_group_set_prog(pfq_gid_t gid, struct pfq_lang_computation_tree *comp, void *
         old_comp = (struct pfq_lang_computation_tree *)atomic_long_xchg(&group->comp, (long)comp);
         old_ctx  = (void *)atomic_long_xchg(&group->comp_ctx, (long)ctx);
 
-        msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+        synchronize_rcu();   /* sleeping is possible here: user-context */
 
 	/* call fini on old computation */
 
@@ -462,6 +630,24 @@ pfq_group_leave_all(pfq_id_t id)
 }
 
 
+void
+pfq_group_update_steering(pfq_id_t id)
+{
+        int n = 0;
+
+        mutex_lock(&global->groups_lock);
+        for(; n < Q_MAX_GID; n++)
+        {
+		pfq_gid_t gid = (__force pfq_gid_t)n;
+		struct pfq_group *group = pfq_group_get(gid);
+
+		if (group->enabled && pfq_group_has_joined(gid, id))
+			__pfq_group_update_steering(group, 0);
+        }
+        mutex_unlock(&global->groups_lock);
+}
+
+
 unsigned long
 pfq_group_get_groups(pfq_id_t id)
 {
@@ -499,7 +685,7 @@ pfq_group_vlan_filters_enabled(pfq_gid_t gid)
         group = pfq_group_get(gid);
         if (group == NULL)
 		return false;
-        return group->vlan_filt;
+        return rcu_access_pointer(group->vlan_filter) != NULL;
 }
 
 
@@ -507,43 +693,98 @@ bool
 pfq_group_check_vlan_filter(pfq_gid_t gid, int vid)
 {
         struct pfq_group *group;
+        struct pfq_vlan_filter *filter;
+        bool ret;
 
         group= pfq_group_get(gid);
         if (group == NULL)
                 return false;
 
-        return group->vid_filters[vid & 4095];
+        rcu_read_lock();
+        filter = rcu_dereference(group->vlan_filter);
+        ret = filter && pfq_vlan_filter_test(filter, vid);
+        rcu_read_unlock();
+        return ret;
 }
 
 
+/* enabling the filters resets them (no vid passes) */
+
 bool
 pfq_group_toggle_vlan_filters(pfq_gid_t gid, bool value)
 {
         struct pfq_group *group;
+        struct pfq_vlan_filter *filter = NULL, *old;
 
         group = pfq_group_get(gid);
         if (group == NULL)
                 return false;
 
-        if (value)
-                memset(group->vid_filters, 0, 4096);
+        if (value) {
+                filter = kzalloc(sizeof(*filter), GFP_KERNEL);
+                if (!filter)
+                        return false;
+        }
+
+        mutex_lock(&global->groups_lock);
+
+        old = rcu_dereference_protected(group->vlan_filter, lockdep_is_held(&global->groups_lock));
+        rcu_assign_pointer(group->vlan_filter, filter);
 
-        smp_wmb();
+        mutex_unlock(&global->groups_lock);
 
-        group->vlan_filt = value;
+        if (old)
+                kfree_rcu(old, rcu);
         return true;
 }
 
 
-void
+/* set/reset a vid (-1 for any vid): the bitmap is replaced by an updated copy */
+
+int
 pfq_group_set_vlan_filter(pfq_gid_t gid, bool value, int vid)
 {
         struct pfq_group *group;
+        struct pfq_vlan_filter *filter, *old;
+        int err = 0;
 
         group = pfq_group_get(gid);
         if (group == NULL)
-                return;
+                return -EINVAL;
+
+        filter = kmalloc(sizeof(*filter), GFP_KERNEL);
+        if (!filter)
+                return -ENOMEM;
+
+        mutex_lock(&global->groups_lock);
+
+        old = rcu_dereference_protected(group->vlan_filter, lockdep_is_held(&global->groups_lock));
+        if (!old) {
+                err = -EPERM;
+                goto out;
+        }
+
+        memcpy(filter->vid, old->vid, sizeof(filter->vid));
+
+        if (vid == -1) {
+                if (value)
+                        bitmap_set(filter->vid, 1, 4094);
+                else
+                        bitmap_clear(filter->vid, 1, 4094);
+        }
+        else if (value)
+                __set_bit(vid & Q_VLAN_VID_MASK, filter->vid);
+        else
+                __clear_bit(vid & Q_VLAN_VID_MASK, filter->vid);
+
+        rcu_assign_pointer(group->vlan_filter, filter);
+        filter = NULL;
+out:
+        mutex_unlock(&global->groups_lock);
 
-        group->vid_filters[vid & 4095] = value;
+        kfree(filter);
+        if (!err)
+                kfree_rcu(old, rcu);
+        return err;
 }
 
@@ -32,10 +32,38 @@
 #include <pfq/bpf.h>
 
 #include <linux/pf_q.h>
+#include <linux/workqueue.h>
+#include <linux/bitops.h>
 
 typedef struct pfq_kernel_stats pfq_group_stats_t;
 struct pfq_group_counters;
 
+/* VLAN filter of a group: one bit per vid (replaced under RCU) */
+
+struct pfq_vlan_filter
+{
+	struct rcu_head		rcu;
+	unsigned long		vid[4096 / BITS_PER_LONG];
+};
+
+
+static inline
+bool pfq_vlan_filter_test(struct pfq_vlan_filter const *filter, int vid)
+{
+	return test_bit(vid & Q_VLAN_VID_MASK, filter->vid);
+}
+
+
+/* eBPF program of a group (replaced under RCU) */
+
+struct pfq_group_ebpf
+{
+	struct bpf_prog		*prog;
+	int			mode;		/* Q_EBPF_FILTER, Q_EBPF_STEER or Q_EBPF_CLASS */
+	struct rcu_head		rcu;
+};
+
+
 struct pfq_group
 {
         int policy;                                     /* group policy */
@@ -46,7 +74,12 @@ struct pfq_group
         atomic_long_t sock_id[Q_CLASS_MAX];		/* list of (bitwise) socket ids that joined this group, for each different class:
         						   Q_CLASS_DEFAULT, Q_CLASS_USER_PLANE, Q_CLASS_CONTROL_PLANE etc... */
 
+        struct pfq_steer_map __rcu *steer_map;		/* consistent-hash steering tables, for each class mask in use */
+        atomic_long_t steer_miss;			/* class mask waiting for a steering table */
+        struct work_struct steer_work;			/* builds the missing steering table */
+
         atomic_long_t bp_filter;			/* struct sk_filter pointer */
+        struct pfq_group_ebpf __rcu *ebpf;		/* eBPF program (filter, steering or class) */
 
         atomic_long_t comp;                             /* struct pfq_lang_computation_tree *  (new functional program) */
         atomic_long_t comp_ctx;                         /* void *: storage context (new functional program) */
@@ -55,32 +88,35 @@ struct pfq_group
 	struct pfq_group_counters __percpu *counters;
 
         bool   enabled;
-        bool   vlan_filt;                               /* enable/disable vlan filtering */
-        char   vid_filters[4096];                       /* vlan filters */
+
+        struct pfq_vlan_filter __rcu *vlan_filter;     /* vlan filters (NULL when disabled) */
 
 };
 
 
 struct pfq_lang_computation_tree;
+struct pfq_steer_map;
 
 extern int  pfq_group_join_free(pfq_id_t id, unsigned long class_mask, int policy);
 extern int  pfq_group_join(pfq_gid_t gid, pfq_id_t id, unsigned long class_mask, int policy);
 extern int  pfq_group_leave(pfq_gid_t gid, pfq_id_t id);
 extern int  pfq_group_set_prog(pfq_gid_t gid, struct pfq_lang_computation_tree *prog, void *ctx);
 extern void pfq_group_leave_all(pfq_id_t id);
+extern void pfq_group_update_steering(pfq_id_t id);
 
 extern unsigned long pfq_group_get_groups(pfq_id_t id);
 extern unsigned long pfq_group_get_all_sock_mask(pfq_gid_t gid);
 
 extern int  pfq_group_get_context(pfq_gid_t gid, int level, int size, void __user *context);
 extern void pfq_group_set_filter(pfq_gid_t gid, struct sk_filter *filter);
+extern int  pfq_group_set_ebpf(pfq_gid_t gid, struct bpf_prog *prog, int mode);
 
 extern struct pfq_group * pfq_group_get(pfq_gid_t gid);
 
 extern bool pfq_group_vlan_filters_enabled(pfq_gid_t gid);
 extern bool pfq_group_check_vlan_filter(pfq_gid_t gid, int vid);
 extern bool pfq_group_toggle_vlan_filters(pfq_gid_t gid, bool value);
-extern void pfq_group_set_vlan_filter(pfq_gid_t gid, bool value, int vid);
+extern int  pfq_group_set_vlan_filter(pfq_gid_t gid, bool value, int vid);
 
 extern bool pfq_group_policy_access(pfq_gid_t gid, pfq_id_t id, int policy);
 extern bool pfq_group_access(pfq_gid_t gid, pfq_id_t id);
@@ -108,6 +144,17 @@ bool pfq_group_is_free(pfq_gid_t gid)
 }
 
 
+/* request a steering table for the given class mask (Rx path) */
+
+static inline
+void pfq_group_steer_miss(struct pfq_group *group, unsigned long class_mask)
+{
+	if (atomic_long_read(&group->steer_miss) == 0 &&
+	    atomic_long_cmpxchg(&group->steer_miss, 0, (long)class_mask) == 0)
+		schedule_work(&group->steer_work);
+}
+
+
 static inline
 int pfq_get_tgid(void)
 {
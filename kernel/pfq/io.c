@@ -34,6 +34,7 @@
 #include <pfq/bitops.h>
 #include <pfq/devmap.h>
 #include <pfq/global.h>
+#include <pfq/group.h>
 #include <pfq/io.h>
 #include <pfq/memory.h>
 #include <pfq/netdev.h>
@@ -43,6 +44,7 @@
 #include <pfq/queue.h>
 #include <pfq/sock.h>
 #include <pfq/skbuff.h>
+#include <pfq/steer.h>
 #include <pfq/thread.h>
 #include <pfq/vlan.h>
 
@@ -82,29 +84,28 @@ pfq_netdev_pick_tx(struct net_device *dev, struct sk_buff *skb, int *queue)
 }
 
 
-#if 0
-
 /*
- * wait function for active timestamping
+ * wait functions for active timestamping
  *
  */
 
 
 static inline
-bool giveup_tx_process(atomic_t const *stop)
+bool giveup_tx_process(void)
 {
-	return atomic_read(stop) == -1 || signal_pending(current) || is_kthread_should_stop();
+	return signal_pending(current) || is_kthread_should_stop();
 }
 
+
 static inline
-ktime_t wait_until_busy(uint64_t ts, atomic_t const *stop, bool *intr)
+ktime_t wait_until_busy(uint64_t ts, bool *intr)
 {
 	ktime_t now;
 	do
 	{
 		now = ktime_get_real();
-		if (giveup_tx_process(stop)) {
-			*intr= true;
+		if (giveup_tx_process()) {
+			*intr = true;
 			return now;
 		}
 	}
@@ -113,54 +114,47 @@ ktime_t wait_until_busy(uint64_t ts, atomic_t const *stop, bool *intr)
 }
 
 
+/*
+ * hold the timed packet until its timestamp: packets due within Q_TX_BUSY_WAIT nsec are
+ * busy-waited, later ones are left in the queue (the Tx thread sleeps on an hrtimer until
+ * the deadline is close). Returns false if the packet is to be held.
+ */
+
 static inline
-ktime_t wait_until_relaxed(uint64_t ts, atomic_t const *stop, bool *intr)
+bool wait_until(uint64_t tv64, struct pfq_xmit_context *ctx)
 {
-	ktime_t now;
-	do
-	{
-		now = ktime_get_real();
-		if (giveup_tx_process(stop)) {
-			*intr= true;
-			return now;
-		}
-	}
-	while (ktime_to_ns(now) < ts
-	       && (pfq_relax(), true));
+	ctx->now = ktime_get_real();
 
-	return now;
-}
+	if (tv64 > ktime_to_ns(ctx->now)) {
 
+		if ((tv64 - ktime_to_ns(ctx->now)) > Q_TX_BUSY_WAIT)
+			return false;
 
-static
-ktime_t wait_until(uint64_t tv64, ktime_t now, struct pfq_dev_queue *dev_queue, atomic_t const *stop, bool *intr)
-{
-	ktime_t now_;
+		ctx->now = wait_until_busy(tv64, ctx->intr);
+		return !*ctx->intr;
+	}
 
-	if (tv64 > ktime_to_ns(now)) {
+	return true;
+}
 
-		if ((tv64 - ktime_to_ns(now)) < 100000) { /* < 100us, just like pktgen */
 
-			now_ = wait_until_busy(tv64, stop, intr);
-		}
-		else {
-			pfq_hard_tx_unlock(dev_queue);
-			local_bh_enable();
+static inline
+void pfq_account_timed_tx(struct pfq_sock *so, uint64_t tv64, ktime_t now)
+{
+	int64_t late = ktime_to_ns(now) - (int64_t)tv64;
 
-			now_ = wait_until_relaxed(tv64, stop, intr);
+	sparse_inc(so->stats, timed);
+	sparse_inc(global->percpu_stats, timed);
 
-			local_bh_disable();
-			pfq_hard_tx_lock(dev_queue);
+	if (late > 0) {
+		sparse_add(so->stats, lateness, late);
+		sparse_add(global->percpu_stats, lateness, late);
+		if (late > Q_TX_LATE) {
+			sparse_inc(so->stats, late);
+			sparse_inc(global->percpu_stats, late);
 		}
 	}
-	else {
-		if (!global->tx_rate_control_eager)
-			return now;
-	}
-
-	return now_;
 }
-#endif
 
 
 static inline
@@ -194,6 +188,20 @@ ptrdiff_t maybe_swap_sk_tx_queue(struct pfq_shared_tx_queue *tx_queue, unsigned
 }
 
 
+/*
+ * true if the shared queue has packets not yet consumed
+ */
+
+bool
+pfq_sk_queue_pending(struct pfq_shared_tx_queue *tx_queue)
+{
+	unsigned int prod_idx = __atomic_load_n(&tx_queue->prod.index, __ATOMIC_ACQUIRE);
+	unsigned int cons_idx = __atomic_load_n(&tx_queue->cons.index, __ATOMIC_RELAXED);
+
+	return prod_idx != cons_idx || acquire_sk_tx_prod_off_by(cons_idx, tx_queue) != tx_queue->cons.off;
+}
+
+
 static inline
 unsigned int dev_tx_max_skb_copies(struct net_device *dev, unsigned int req_copies)
 {
@@ -271,6 +279,93 @@ pfq_xmit(struct qbuff *buff, struct net_device *dev, int queue, int more)
 }
 
 
+/*
+ * transmit an skb with copies (the caller holds a reference)
+ */
+
+static inline tx_response_t
+__pfq_skb_xmit_copies(struct sk_buff *skb,
+		      struct pfq_dev_queue *dev_queue,
+		      struct pfq_xmit_context *ctx)
+{
+        tx_response_t rc = { 0 };
+
+	atomic_set(&skb->users, ctx->copies + 1);
+
+	do { /* copies > 1 when the device support TX_SKB_SHARING */
+
+		const bool xmit_more_ = ctx->xmit_more || ctx->copies != 1;
+
+		if (__pfq_xmit(skb, dev_queue->dev, xmit_more_, global->tx_retry) == NETDEV_TX_OK)
+			rc.ok++;
+		else
+			rc.fail++;
+
+		ctx->copies--;
+	}
+	while (ctx->copies > 0);
+
+	return rc;
+}
+
+
+/*
+ * Tx skbs are popped from the pool xmit_batch_len at a time (clamped to the
+ * bulk array, the parameter is writable at runtime), and pushed back in bulk
+ * once transmitted (the caller holds the Tx pool lock)
+ */
+
+static inline struct sk_buff *
+pfq_xmit_skb_alloc(size_t size, struct pfq_xmit_context *ctx)
+{
+	struct pfq_skb_bulk *bulk = ctx->tx_alloc;
+
+	if (likely(size <= global->max_slot_size)) {
+		if (bulk->next == bulk->len) {
+			bulk->next = 0;
+			bulk->len = pfq_alloc_skb_pool_bulk(bulk->skb,
+					min_t(size_t, global->xmit_batch_len, Q_BUFF_BATCH_LEN), 1, ctx->tx);
+		}
+		if (likely(bulk->next < bulk->len))
+			return bulk->skb[bulk->next++];
+	}
+
+	return pfq_alloc_skb_pool(size, GFP_KERNEL, ctx->node, 1, ctx->tx);
+}
+
+
+static inline void
+pfq_xmit_skb_free(struct sk_buff *skb, struct pfq_xmit_context *ctx)
+{
+	struct pfq_skb_bulk *bulk = ctx->tx_free;
+
+	bulk->skb[bulk->len++] = skb;
+	if (bulk->len == Q_BUFF_BATCH_LEN) {
+		pfq_free_skb_pool_bulk(bulk->skb, bulk->len, 1, ctx->tx);
+		bulk->len = 0;
+	}
+}
+
+
+static inline void
+pfq_xmit_skb_flush(struct pfq_xmit_context *ctx)
+{
+	struct pfq_skb_bulk *bulk;
+
+	/* skbs popped but not used go back to the pool as well */
+
+	bulk = ctx->tx_alloc;
+	if (bulk->next < bulk->len)
+		pfq_free_skb_pool_bulk(bulk->skb + bulk->next, bulk->len - bulk->next, 1, ctx->tx);
+	bulk->next = bulk->len = 0;
+
+	bulk = ctx->tx_free;
+	if (bulk->len)
+		pfq_free_skb_pool_bulk(bulk->skb, bulk->len, 1, ctx->tx);
+	bulk->len = 0;
+}
+
+
 /*
  * transmit a buff with copies
  */
@@ -282,18 +377,14 @@ __pfq_slot_xmit(const void *buf,
 		struct pfq_xmit_context *ctx)
 {
 	struct sk_buff *skb;
-        tx_response_t rc = { 0 };
+        tx_response_t rc;
 
 	if (unlikely(!dev_queue->dev))
 		return (tx_response_t){.ok = 0, .fail = ctx->copies};
 
 	/* allocate a new socket buffer */
 
-	skb = pfq_alloc_skb_pool( len + LL_RESERVED_SPACE(dev_queue->dev)
-				, GFP_KERNEL
-				, ctx->node
-				, 1
-				, ctx->tx);
+	skb = pfq_xmit_skb_alloc(len + LL_RESERVED_SPACE(dev_queue->dev), ctx);
 
 	if (unlikely(skb == NULL)) {
 		if (printk_ratelimit())
@@ -318,24 +409,96 @@ __pfq_slot_xmit(const void *buf,
 
 	/* transmit the packet + copies */
 
-	atomic_set(&skb->users, ctx->copies + 1);
+	rc = __pfq_skb_xmit_copies(skb, dev_queue, ctx);
 
-	do { /* copies > 1 when the device support TX_SKB_SHARING */
+	/* release the packet */
 
-		const bool xmit_more_ = ctx->xmit_more || ctx->copies != 1;
+	pfq_xmit_skb_free(skb, ctx);
 
-		if (__pfq_xmit(skb, dev_queue->dev, xmit_more_, global->tx_retry) == NETDEV_TX_OK)
-			rc.ok++;
-		else
-			rc.fail++;
+	if (rc.ok)
+	     dev_queue->queue->trans_start = ctx->jiffies;
 
-		ctx->copies--;
+	return rc;
+}
+
+
+/*
+ * transmit a buff with copies, without copying the payload:
+ * the headers are copied into the linear part of the skb, the rest of the slot
+ * is attached as page fragments of the shared memory. The queue half is released
+ * to the producer by the zero-copy callback, once the driver frees the data.
+ */
+
+static tx_response_t
+__pfq_slot_xmit_zcopy(const void *buf,
+		      size_t len,
+		      struct pfq_dev_queue *dev_queue,
+		      struct pfq_xmit_context *ctx)
+{
+	const char *data = (const char *)buf + Q_TX_ZCOPY_HEAD;
+	size_t left = len - Q_TX_ZCOPY_HEAD;
+	struct sk_buff *skb;
+        tx_response_t rc;
+	int nfrag = 0;
+
+	if (unlikely(!dev_queue->dev))
+		return (tx_response_t){.ok = 0, .fail = ctx->copies};
+
+	/* zero-copy skbs are never recycled: allocate them from the kernel */
+
+	skb = __alloc_skb(Q_TX_ZCOPY_HEAD + LL_RESERVED_SPACE(dev_queue->dev), GFP_ATOMIC, 0, ctx->node);
+	if (unlikely(skb == NULL)) {
+		if (printk_ratelimit())
+			printk(KERN_INFO "[PFQ] Tx could not allocate a zero-copy skb!\n");
+		return (tx_response_t){.ok = 0, .fail = ctx->copies};
 	}
-	while (ctx->copies > 0);
+
+	skb_reserve(skb, LL_RESERVED_SPACE(dev_queue->dev));
+	skb->dev = dev_queue->dev;
+
+	memcpy(__skb_put(skb, Q_TX_ZCOPY_HEAD), buf, Q_TX_ZCOPY_HEAD);
+
+	/* attach the payload (the shared memory is pinned, take a reference to each page) */
+
+	while (left > 0)
+	{
+		struct page *page = pfq_shmem_page(data);
+		size_t off  = offset_in_page(data);
+		size_t size = min_t(size_t, left, PAGE_SIZE - off);
+
+		if (unlikely(nfrag == MAX_SKB_FRAGS)) {
+			kfree_skb(skb);
+			return (tx_response_t){.ok = 0, .fail = ctx->copies};
+		}
+
+		get_page(page);
+		skb_fill_page_desc(skb, nfrag++, page, off, size);
+
+		data += size;
+		left -= size;
+	}
+
+	skb->len      += len - Q_TX_ZCOPY_HEAD;
+	skb->data_len += len - Q_TX_ZCOPY_HEAD;
+	skb->truesize += len - Q_TX_ZCOPY_HEAD;
+
+	/* the queue half stays busy until the data is released */
+
+	skb_shinfo(skb)->destructor_arg = &ctx->zcopy->ubuf;
+	skb_shinfo(skb)->tx_flags |= SKBTX_DEV_ZEROCOPY;
+
+	atomic_inc(ctx->zcopy->inflight);
+	__atomic_add_fetch((unsigned int *)ctx->zcopy->ubuf.ctx, 1, __ATOMIC_RELAXED);
+
+	skb_set_queue_mapping(skb, dev_queue->mapping);
+
+	/* transmit the packet + copies */
+
+	rc = __pfq_skb_xmit_copies(skb, dev_queue, ctx);
 
 	/* release the packet */
 
-	pfq_free_skb_pool(skb, ctx->tx);
+	consume_skb(skb);
 
 	if (rc.ok)
 	     dev_queue->queue->trans_start = ctx->jiffies;
@@ -346,21 +509,26 @@ __pfq_slot_xmit(const void *buf,
 
 /*
  * transmit packets from a socket queue..
+ * (at most budget packets, if not 0: the rest is left in the queue)
  */
 
 tx_response_t
 pfq_sk_queue_xmit( struct pfq_sock *so
 		 , int sock_queue
-		 , int cpu)
+		 , int cpu
+		 , uint64_t *deadline
+		 , int budget)
 {
 	struct pfq_queue_info const * txinfo = pfq_sock_get_tx_queue_info(so, sock_queue);
 	struct pfq_dev_queue dev_queue = {.dev = NULL, .queue = NULL, .mapping = 0};
 	struct pfq_xmit_context ctx;
 	struct pfq_percpu_pool *pool;
-	int batch_cntr = 0, cons_idx;
+	int batch_cntr = 0, npkts = 0, cons_idx;
 	struct pfq_shared_tx_queue *tx_queue;
 	struct pfq_pkthdr *hdr;
 	ptrdiff_t prod_off;
+	struct pfq_tx_shaper *shaper;
+	bool intr = false, held = false;
         char *begin, *end;
         void *tx_queue_mem;
         tx_response_t rc = {0};
@@ -379,6 +547,8 @@ pfq_sk_queue_xmit( struct pfq_sock *so
 
 	pool = this_cpu_ptr(global->percpu_pool);
 	ctx.tx = &pool->tx;
+	ctx.tx_alloc = &pool->tx_alloc;
+	ctx.tx_free = &pool->tx_free;
 
 	/* lock the Tx pool */
 
@@ -400,7 +570,18 @@ pfq_sk_queue_xmit( struct pfq_sock *so
         ctx.net	    = sock_net(&so->sk);
 	ctx.now	    = ktime_get_real();
 	ctx.jiffies = jiffies;
-        ctx.node    = cpu == -1 ? NUMA_NO_NODE : cpu_to_node(cpu);
+	ctx.intr    = &intr;
+	ctx.node    = cpu == -1 ? NUMA_NO_NODE : cpu_to_node(cpu);
+	ctx.zcopy   = so->tx_zcopy ? pfq_sock_tx_zcopy(so, sock_queue, cons_idx) : NULL;
+
+	/* apply a new rate, if any, and refill the token bucket of this queue */
+
+	shaper = pfq_sock_tx_shaper(so, sock_queue);
+	pfq_tx_shaper_update(shaper);
+	if (pfq_tx_shaper_enabled(shaper))
+		pfq_tx_shaper_refill(shaper, ktime_to_ns(ctx.now));
+	else
+		shaper = NULL;
 
 	/* lock the dev_queue */
 
@@ -446,15 +627,59 @@ pfq_sk_queue_xmit( struct pfq_sock *so
 			break;
 		}
 
+		/* per-queue budget exhausted: leave the rest of the queue to the next round */
+
+		if (budget && npkts == budget) {
+			held = true;
+			break;
+		}
+
+		/* active timestamping (Tx threads only): hold the packet until its timestamp */
+
+		if (deadline && hdr->tstamp.tv64) {
+			if (!wait_until(hdr->tstamp.tv64, &ctx)) {
+				if (!intr)
+					*deadline = hdr->tstamp.tv64;
+				held = true;
+				break;
+			}
+		}
+
 		/* get the number of copies to transmit */
 
                 ctx.copies = dev_tx_max_skb_copies(dev_queue.dev, hdr->info.data.copies);
+
+		/* token bucket: hold the packet (and the rest of the queue) until it conforms */
+
+		if (shaper) {
+			int64_t wait = pfq_tx_shaper_wait(shaper, hdr->caplen, ctx.copies);
+			if (wait) {
+				if (deadline)
+					*deadline = shaper->last + wait;
+				shaper->throttled = true;
+				held = true;
+				break;
+			}
+
+			pfq_tx_shaper_consume(shaper, hdr->caplen, ctx.copies);
+
+			if (shaper->throttled) {
+				shaper->throttled = false;
+				sparse_inc(so->stats, thrt);
+				sparse_inc(global->percpu_stats, thrt);
+			}
+		}
+
 		batch_cntr += ctx.copies;
+		npkts++;
 
-                /* set the xmit_more bit */
+                /* set the xmit_more bit: batch the next packet only if it is already due (and conforms) */
 
 		ctx.xmit_more = batch_cntr < global->xmit_batch_len ?
-				PFQ_SHARED_QUEUE_NEXT_PKTHDR(hdr, so->tx_slot_size) < (struct pfq_pkthdr *)end : (batch_cntr = 0, false);
+				next < (struct pfq_pkthdr *)end && (!budget || npkts < budget) &&
+				(!deadline || next->tstamp.tv64 <= (uint64_t)ktime_to_ns(ctx.now)) &&
+				(!shaper || !pfq_tx_shaper_wait(shaper, next->caplen, dev_tx_max_skb_copies(dev_queue.dev, next->info.data.copies)))
+				: (batch_cntr = 0, false);
 
 		/* transmit this packet */
 
@@ -464,20 +689,35 @@ pfq_sk_queue_xmit( struct pfq_sock *so
 					  , hdr->caplen
 					  , so->tx_slot_size - sizeof(struct pfq_pkthdr) - LL_RESERVED_SPACE(dev_queue.dev));
 
-			tmp = __pfq_slot_xmit(hdr+1, len, &dev_queue, &ctx);
+			if (ctx.zcopy && len > Q_TX_ZCOPY_HEAD && (dev_queue.dev->features & NETIF_F_SG))
+				tmp = __pfq_slot_xmit_zcopy(hdr+1, len, &dev_queue, &ctx);
+			else
+				tmp = __pfq_slot_xmit(hdr+1, len, &dev_queue, &ctx);
 
 			rc.value += tmp.value;
+
+			if (deadline && hdr->tstamp.tv64)
+				pfq_account_timed_tx(so, hdr->tstamp.tv64, ctx.now);
 		}
 	}
 
 	/* unlock the current queue, enable bottom half */
 
 	HARD_TX_UNLOCK(dev_queue.dev, dev_queue.queue);
+
+	pfq_xmit_skb_flush(&ctx);
 	local_bh_enable();
 
 	pfq_dev_queue_put(&dev_queue);
 	spin_unlock(&pool->tx_lock);
 
+	/* held packets: the consumer stops at the first packet not yet due */
+
+	if (held) {
+		tx_queue->cons.off = (char *)hdr - (tx_queue_mem + (cons_idx & 1) * tx_queue->size);
+		return rc;
+	}
+
 	/* update the local consumer offset */
 
 	tx_queue->cons.off = prod_off;
@@ -500,11 +740,11 @@ pfq_sk_queue_xmit( struct pfq_sock *so
  */
 
 tx_response_t
-pfq_qbuff_queue_xmit(struct pfq_qbuff_queue *buffs, unsigned __int128 mask, struct net_device *dev, int queue)
+pfq_qbuff_queue_xmit(struct pfq_qbuff_queue *buffs, struct pfq_qbuff_mask const *mask, struct net_device *dev, int queue)
 {
 	struct netdev_queue *txq;
 	struct qbuff *buff;
-	int n, last_idx;
+	size_t n;
 	tx_response_t rc = {0};
 
 	/* get txq and fix the queue for this batch.
@@ -512,8 +752,6 @@ pfq_qbuff_queue_xmit(struct pfq_qbuff_queue *buffs, unsigned __int128 mask, stru
 	 * note: in case the queue is set to any-queue (-1), the driver along the first skb
 	 * select the queue */
 
-	last_idx = buffs->len - 1;
-
 	txq = pfq_netdev_pick_tx(dev, QBUFF_SKB(&buffs->queue[0]), &queue);
 
 	local_bh_disable();
@@ -526,7 +764,9 @@ pfq_qbuff_queue_xmit(struct pfq_qbuff_queue *buffs, unsigned __int128 mask, stru
 
 		if (likely(!netif_xmit_frozen_or_drv_stopped(txq))) {
 
-			if (__pfq_xmit(QBUFF_SKB(buff), dev, !( n == last_idx || ((mask & (mask-1)) == 0)), global->tx_retry) == NETDEV_TX_OK)
+			const bool xmit_more = qbuff_mask_next(mask, n+1, buffs->len) < buffs->len;
+
+			if (__pfq_xmit(QBUFF_SKB(buff), dev, xmit_more, global->tx_retry) == NETDEV_TX_OK)
 				++rc.ok;
 			else
 				++rc.fail;
@@ -562,7 +802,12 @@ intr:
 int
 pfq_qbuff_lazy_xmit(struct qbuff * buff, struct net_device *dev, int queue)
 {
-	if (buff->fwd_dev_num >= Q_BUFF_LOG_LEN) {
+	struct pfq_percpu_data *data = this_cpu_ptr(global->percpu_data);
+	struct pfq_qbuff_fwd_table *table = data->fwd_table;
+	struct pfq_qbuff_fwd *fwd;
+
+	if (buff->fwd_dev_num >= Q_BUFF_LOG_LEN ||
+	    table->len >= Q_BUFF_FWD_TABLE_LEN) {
 		if (printk_ratelimit())
 			printk(KERN_INFO "[PFQ] bridge %s: too many annotation!\n", dev->name);
 		return 0;
@@ -570,13 +815,20 @@ pfq_qbuff_lazy_xmit(struct qbuff * buff, struct net_device *dev, int queue)
 
 	skb_set_queue_mapping(QBUFF_SKB(buff), queue);
 
-	buff->fwd_dev[buff->fwd_dev_num++] = dev;
+	/* annotate the device in the forward table of this batch */
+
+	fwd = &table->fwd[table->len++];
+	fwd->dev = dev;
+	fwd->index = (size_t)(buff - data->qbuff_queue->queue);
+
+	buff->fwd_dev_num++;
 	return 1;
 }
 
 
 int
-pfq_qbuff_lazy_xmit_run(struct pfq_qbuff_queue *buffs, struct pfq_endpoint_info const *endpoints)
+pfq_qbuff_lazy_xmit_run(struct pfq_qbuff_queue *buffs, struct pfq_qbuff_fwd_table const *table,
+			struct pfq_endpoint_info const *endpoints)
 {
 	struct netdev_queue *txq;
 	struct net_device *dev;
@@ -594,19 +846,21 @@ pfq_qbuff_lazy_xmit_run(struct pfq_qbuff_queue *buffs, struct pfq_endpoint_info
 		txq = NULL;
                 queue = -1;
 
-		/* scan the list of buffs, and forward them in batch fashion */
+		/* scan the forward table, and forward the buffs in batch fashion */
 
-		for(i = 0; i < buffs->len; i++)
+		for(i = 0; i < table->len; i++)
 		{
-                        size_t j, num;
-
-			struct qbuff * buff = &buffs->queue[i];
-			struct sk_buff *skb = QBUFF_SKB(buff);
+			struct qbuff * buff;
+			struct sk_buff *skb;
+			struct sk_buff *nskb;
+			int xmit_more;
 
-			num = pfq_count_fwd_devs(dev, buff->fwd_dev, buff->fwd_dev_num);
-			if (num == 0)
+			if (table->fwd[i].dev != dev)
 				continue;
 
+			buff = &buffs->queue[table->fwd[i].index];
+			skb = QBUFF_SKB(buff);
+
 			if (queue != skb->queue_mapping) {
 
 				queue = skb->queue_mapping;
@@ -622,19 +876,16 @@ pfq_qbuff_lazy_xmit_run(struct pfq_qbuff_queue *buffs, struct pfq_endpoint_info
 				HARD_TX_LOCK(dev, txq, smp_processor_id());
 			}
 
-			/* forward this skb `num` times (to this device) */
+			/* forward a copy of this skb (to this device) */
 
-			for (j = 0; j < num; j++)
+			xmit_more = ++sent_dev != endpoints->cnt[n];
+			nskb = skb_clone_for_tx(skb, dev, GFP_ATOMIC);
+			if (likely(nskb))
 			{
-				const int xmit_more = ++sent_dev != endpoints->cnt[n];
-				struct sk_buff *nskb = skb_clone_for_tx(skb, dev, GFP_ATOMIC);
-				if (likely(nskb))
-				{
-					if (__pfq_xmit(nskb, dev, xmit_more, global->tx_retry) == NETDEV_TX_OK)
-						sent++;
-					else
-						sparse_inc(global->percpu_stats, disc);
-				}
+				if (__pfq_xmit(nskb, dev, xmit_more, global->tx_retry) == NETDEV_TX_OK)
+					sent++;
+				else
+					sparse_inc(global->percpu_stats, disc);
 			}
 		}
 
@@ -702,198 +953,303 @@ unsigned int pfq_fold(unsigned int a, unsigned int b)
 }
 
 
-int
-pfq_receive(struct napi_struct *napi, struct sk_buff * skb)
-{
-	struct pfq_percpu_data * data;
-	struct pfq_percpu_pool * pool;
-	unsigned long bit;
-	int cpu;
-
-	/* if no socket is open drop the packet */
+/* socket lookup from the Rx path: ids come from the forward masks and
+ * the batch runs within an RCU read-side section */
 
-        cpu = smp_processor_id();
-	pool = per_cpu_ptr(global->percpu_pool, cpu);
+static inline struct pfq_sock *
+pfq_sock_rcu(pfq_id_t id)
+{
+	return rcu_dereference(global->socket_ptr[(__force int)id]);
+}
 
-	if (unlikely(pfq_sock_counter() == 0)) {
-		if (skb) {
-			sparse_inc(global->percpu_memory, os_free);
-			pfq_free_skb_pool(skb, &pool->rx);
-		}
-		return 0;
-	}
 
+/*
+ * run the computations of the eligible groups over the current batch...
+ */
 
-	data = per_cpu_ptr(global->percpu_data, cpu);
+static void
+pfq_receive_groups(struct pfq_percpu_data *data, int cpu)
+{
+	struct pfq_qbuff_queue *buffs = PFQ_QBUFF_QUEUE(data->qbuff_queue);
+	unsigned long bit;
 
-	if (likely(skb)) /* ensure this is not the timer heartbeat */
+	pfq_bitwise_foreach(data->group_mask_all, bit,
 	{
-		struct pfq_lang_monad monad;
-		unsigned long group_mask;
+		pfq_gid_t gid = (__force pfq_gid_t)pfq_ctz(bit);
+		struct pfq_qbuff_mask *mask = &data->group_mask[(__force int)gid];
+		struct pfq_group * this_group = pfq_group_get(gid);
+		struct pfq_lang_computation_tree *prg;
+		struct pfq_group_ebpf *ebpf;
+		struct pfq_vlan_filter *vlan;
 		struct qbuff *buff;
-		ktime_t current_rx;
-
-		/* if required, timestamp the packet now */
-		if (ktime_to_ns(skb->tstamp) == 0)
-			__net_timestamp(skb);
-
-		/* if vlan header is present, remove it */
-		if (global->vlan_untag && skb->protocol == cpu_to_be16(ETH_P_8021Q)) {
-			skb = pfq_vlan_untag(skb);
-			if (unlikely(!skb)) {
-				__sparse_inc(global->percpu_stats, lost, cpu);
-				return -1;
-			}
-		}
-
-		skb_reset_mac_len(skb);
+		size_t n, recv;
 
-		/* push the mac header: reset skb->data to the beginning of the packet */
-
-		skb_push(skb, skb->mac_len);
-
-		/* initialize the qbuff */
+		if (unlikely(!this_group))
+			goto next;
 
-		buff = &data->qbuff_queue->queue[data->qbuff_queue->len];
+		ebpf = rcu_dereference(this_group->ebpf);
+		vlan = rcu_dereference(this_group->vlan_filter);
 
-		qbuff_init( buff
-			  , skb
-			  , &monad
-			  , data->counter++);
+		/* increment counter for this group */
 
-		/* get the eligible groups */
+		recv = qbuff_mask_weight(mask, buffs->len);
+		__sparse_add(this_group->stats, recv, recv, cpu);
 
-		group_mask = pfq_devmap_get_groups( qbuff_get_ifindex(buff)
-						  , qbuff_get_rx_queue(buff));
+		/* vlan filter: the whole batch is tested against the bitmap first */
 
+		if (vlan) {
+			for_each_qbuff_with_mask(mask, buffs, buff, n)
+			{
+				if (!qbuff_run_vlan_filter(buff, vlan))
+					qbuff_mask_clear(mask, n);
+			}
+		}
 
-		/* process all groups for this qbuff */
+		/* check if bp filter and eBPF filter are enabled */
 
-		pfq_bitwise_foreach(group_mask, bit,
-		{
-			pfq_gid_t gid = (__force pfq_gid_t)pfq_ctz(bit);
-			struct pfq_group * this_group = pfq_group_get(gid);
-			struct pfq_lang_computation_tree *prg;
+		if (atomic_long_read(&this_group->bp_filter) ||
+		    (ebpf && ebpf->mode == Q_EBPF_FILTER)) {
 
-			if (unlikely(!this_group))
-				continue;
+			for_each_qbuff_with_mask(mask, buffs, buff, n)
+			{
+				if (!qbuff_run_bp_filter(buff, this_group) ||
+				    (ebpf && ebpf->mode == Q_EBPF_FILTER && !qbuff_run_ebpf(buff, ebpf->prog)))
+					qbuff_mask_clear(mask, n);
+			}
+		}
 
-			/* increment counter for this group */
+		if (vlan || atomic_long_read(&this_group->bp_filter) ||
+		    (ebpf && ebpf->mode == Q_EBPF_FILTER))
+			__sparse_add(this_group->stats, drop, recv - qbuff_mask_weight(mask, buffs->len), cpu);
 
-			__sparse_inc(this_group->stats, recv, cpu);
+		/* process pfq-lang */
 
-			/* check if bp filter is enabled */
+		prg = (struct pfq_lang_computation_tree *)atomic_long_read(&this_group->comp);
+		if (prg || (ebpf && ebpf->mode != Q_EBPF_FILTER)) {
+			struct pfq_qbuff_mask selection = *mask;
+			struct pfq_steer_map *steer_map;
+			size_t num_fwd = 0, to_kernel = 0, before;
 
-			if (atomic_long_read(&this_group->bp_filter)) {
-				if (!qbuff_run_bp_filter(buff, this_group)) {
-					__sparse_inc(this_group->stats, drop, cpu);
-					continue;
-				}
-			}
+			before = qbuff_mask_weight(mask, buffs->len);
 
-			/* check vlan filter */
+			/* setup the monads for this computation */
 
-			if (pfq_group_vlan_filters_enabled(gid)) {
-				if (!qbuff_run_vlan_filter(buff, (pfq_gid_t)gid)) {
-					__sparse_inc(this_group->stats, drop, cpu);
-					continue;
+			for_each_qbuff_with_mask(mask, buffs, buff, n)
+			{
+				pfq_lang_monad_init(buff->monad, this_group);
+				num_fwd   += buff->fwd_dev_num;
+				to_kernel += buff->to_kernel;
+
+				/* the eBPF program sets the initial fanout (steering hash or class mask) */
+
+				if (ebpf && ebpf->mode != Q_EBPF_FILTER) {
+					uint32_t ret = qbuff_run_ebpf(buff, ebpf->prog);
+					if (!ret)
+						qbuff_mask_clear(mask, n);
+					else if (ebpf->mode == Q_EBPF_STEER)
+						Steering(buff, ret);
+					else
+						buff->monad->fanout.class_mask = (unsigned long)ret & Q_CLASS_ANY;
 				}
 			}
 
-			/* process pfq-lang */
+			/* run the functional program over the batch */
 
-			prg = (struct pfq_lang_computation_tree *)atomic_long_read(&this_group->comp);
-			if (prg) {
-				unsigned long cbit, elig_mask = 0;
-				size_t to_kernel = buff->to_kernel;
-				size_t num_fwd = buff->fwd_dev_num;
-
-			 	/* setup monad for this computation */
+			if (prg)
+				pfq_lang_run_batch(buffs, mask, prg);
 
-			 	monad.fanout.class_mask = Q_CLASS_DEFAULT;
-			 	monad.fanout.type = fanout_copy;
-			 	monad.group = this_group;
-			 	monad.state = 0;
-			 	monad.shift = 0;
-			 	monad.ipoff = 0;
-			 	monad.ipproto = IPPROTO_NONE;
-			 	monad.ep_ctx = EPOINT_SRC | EPOINT_DST;
+			__sparse_add(this_group->stats, drop, before - qbuff_mask_weight(mask, buffs->len), cpu);
 
-			 	/* run the functional program */
+			/* update stats */
 
-			 	if (!pfq_lang_run(buff, prg).qbuff) {
-			 		__sparse_inc(this_group->stats, drop, cpu);
-			 		continue;
-			 	}
+			for_each_qbuff_with_mask(&selection, buffs, buff, n)
+			{
+				num_fwd   -= buff->fwd_dev_num;
+				to_kernel -= buff->to_kernel;
+			}
 
-			 	/* update stats */
+			__sparse_sub(this_group->stats, frwd, num_fwd, cpu);
+			__sparse_sub(this_group->stats, kern, to_kernel, cpu);
 
-                                 __sparse_add(this_group->stats, frwd, buff->fwd_dev_num - num_fwd, cpu);
-                                 __sparse_add(this_group->stats, kern, buff->to_kernel - to_kernel, cpu);
+			/* steering tables (read once per batch) */
 
-			 	/* skip this packet? */
+			rcu_read_lock();
+			steer_map = rcu_dereference(this_group->steer_map);
 
-			 	if (is_drop(monad.fanout)) {
-			 		__sparse_inc(this_group->stats, drop, cpu);
-			 		continue;
-			 	}
+			for_each_qbuff_with_mask(mask, buffs, buff, n)
+			{
+				struct pfq_lang_monad *monad = buff->monad;
+				unsigned long cbit, elig_mask = 0;
 
 			 	/* compute the eligible mask of sockets enabled to receive this packet... */
 
-			 	pfq_bitwise_foreach(monad.fanout.class_mask, cbit,
+			 	pfq_bitwise_foreach(monad->fanout.class_mask, cbit,
 			 	{
 			 		int class = (int)pfq_ctz(cbit);
 			 		elig_mask |= (unsigned long)atomic_long_read(&this_group->sock_id[class]);
 			 	});
 
+			 	if (is_steering(monad->fanout)) { /* single or double */
 
-			 	if (is_steering(monad.fanout)) { /* single or double */
+					struct pfq_steer_table *table;
 
-			 		unsigned long steer_mask[Q_MAX_STEERING_MASK];
-			 		unsigned int sbit, steer_mask_numb = 0;
+					/* use the consistent-hash table of the group for this class mask */
 
-					/* compute the load balancing mask list */
+					table = steer_map ? pfq_steer_map_lookup(steer_map, monad->fanout.class_mask) : NULL;
 
-			 		pfq_bitwise_foreach(elig_mask, sbit,
-			 		{
-			 			pfq_id_t id = (__force pfq_id_t)pfq_ctz(sbit);
-			 			struct pfq_sock * so = pfq_sock_get_by_id(id);
+					if (likely(table && table->sock_mask == elig_mask)) {
 
-						int i, end = so ? so->weight : 1;
-						for(i = 0; i < end; ++i)
-							steer_mask[steer_mask_numb++] = sbit;
-			 		});
+						buff->fwd_mask |= pfq_steer_table_lookup(table, monad->fanout.hash);
 
-					buff->fwd_mask |= steer_mask[pfq_fold(prefold(monad.fanout.hash), (unsigned int)steer_mask_numb)];
+						if (is_double_steering(monad->fanout))
+							buff->fwd_mask |= pfq_steer_table_lookup(table, monad->fanout.hash2);
+					}
+					else if (elig_mask) {
 
-					if (is_double_steering(monad.fanout))
-						buff->fwd_mask |= steer_mask[pfq_fold(prefold(monad.fanout.hash2), (unsigned int)steer_mask_numb)];
+						unsigned long steer_mask[Q_MAX_STEERING_MASK];
+						unsigned int sbit, steer_mask_numb = 0;
 
+						/* no table yet for this class mask: ask for one */
+
+						if (!table && steer_map && steer_map->len < Q_STEER_MAP_LEN)
+							pfq_group_steer_miss(this_group, monad->fanout.class_mask);
+
+						/* compute the load balancing mask list */
+
+						pfq_bitwise_foreach(elig_mask, sbit,
+						{
+							pfq_id_t id = (__force pfq_id_t)pfq_ctz(sbit);
+							struct pfq_sock * so = pfq_sock_rcu(id);
+
+							int i, end = so ? so->weight : 1;
+							for(i = 0; i < end; ++i)
+								steer_mask[steer_mask_numb++] = sbit;
+						});
+
+						buff->fwd_mask |= steer_mask[pfq_fold(prefold(monad->fanout.hash), (unsigned int)steer_mask_numb)];
+
+						if (is_double_steering(monad->fanout))
+							buff->fwd_mask |= steer_mask[pfq_fold(prefold(monad->fanout.hash2), (unsigned int)steer_mask_numb)];
+					}
 			 	}
 			 	else {  /* broadcast */
 
 			 		buff->fwd_mask |= elig_mask;
 			 	}
-
-			} else {
-				buff->fwd_mask |= (unsigned long)atomic_long_read(&this_group->sock_id[0]);
 			}
-		}
-		);
 
-		/* get the current timestamp */
+			rcu_read_unlock();
 
-		current_rx = qbuff_get_ktime(buff);
+		} else {
+			unsigned long sock_mask = (unsigned long)atomic_long_read(&this_group->sock_id[0]);
+
+			for_each_qbuff_with_mask(mask, buffs, buff, n)
+			{
+				buff->fwd_mask |= sock_mask;
+			}
+		}
+	next:
+		qbuff_mask_zero(mask, buffs->len);
+	});
 
-		/* this packet is ready to be enqueued for transmission or possibly dropped */
+	data->group_mask_all = 0;
+}
 
-		if (buff->fwd_mask || buff->fwd_dev_num || buff->to_kernel) {
-			/* commit this buff to the queue */
-			data->qbuff_queue->len++;
+
+int
+pfq_receive(struct napi_struct *napi, struct sk_buff * skb)
+{
+	struct pfq_percpu_data * data;
+	struct pfq_percpu_pool * pool;
+	int cpu, ret;
+
+	/* if no socket is open drop the packet */
+
+        cpu = smp_processor_id();
+	pool = per_cpu_ptr(global->percpu_pool, cpu);
+
+	if (unlikely(pfq_sock_counter() == 0)) {
+		if (skb) {
+			sparse_inc(global->percpu_memory, os_free);
+			pfq_free_skb_pool(skb, &pool->rx);
 		}
-		else {  /* or drop and release it */
-			qbuff_free(buff, &pool->rx);
+		else {
+			/* heartbeat: release the packets held for the sockets closed meanwhile
+			 * (and the references to their devices) */
+
+			data = per_cpu_ptr(global->percpu_data, cpu);
+			if (data->rx_stash->queue.len) {
+				rcu_read_lock();
+				pfq_rx_stash_flush(data->rx_stash, cpu);
+				rcu_read_unlock();
+			}
 		}
+		return 0;
+	}
+
+
+	data = per_cpu_ptr(global->percpu_data, cpu);
+
+	if (likely(skb)) /* ensure this is not the timer heartbeat */
+	{
+		unsigned long group_mask, bit;
+		struct qbuff *buff;
+		ktime_t current_rx;
+		size_t index;
+
+		/* if required, timestamp the packet now */
+		if (ktime_to_ns(skb->tstamp) == 0)
+			__net_timestamp(skb);
+
+		/* if vlan header is present, remove it */
+		if (global->vlan_untag && skb->protocol == cpu_to_be16(ETH_P_8021Q)) {
+			skb = pfq_vlan_untag(skb);
+			if (unlikely(!skb)) {
+				__sparse_inc(global->percpu_stats, lost, cpu);
+				return -1;
+			}
+		}
+
+		skb_reset_mac_len(skb);
+
+		/* push the mac header: reset skb->data to the beginning of the packet */
+
+		skb_push(skb, skb->mac_len);
+
+		/* initialize the qbuff */
+
+		index = data->qbuff_queue->len;
+		buff = &data->qbuff_queue->queue[index];
+
+		qbuff_init( buff
+			  , skb
+			  , &data->monad[index]
+			  , data->counter++);
+
+		pfq_lang_monad_reset(&data->monad[index]);
+
+		/* get the eligible groups */
+
+		group_mask = pfq_devmap_get_groups( qbuff_get_ifindex(buff)
+						  , qbuff_get_rx_queue(buff));
+
+		/* add this qbuff to the batch of each group: groups are processed
+		 * per batch, when the queue is flushed */
+
+		pfq_bitwise_foreach(group_mask, bit,
+		{
+			qbuff_mask_set(&data->group_mask[pfq_ctz(bit)], index);
+		});
+
+		data->group_mask_all |= group_mask;
+
+		/* get the current timestamp */
+
+		current_rx = qbuff_get_ktime(buff);
+
+		/* commit this buff to the queue (if not forwarded, it is released at the end of the batch) */
+
+		data->qbuff_queue->len++;
 
 		/* transmit the queue or wait for the next packet? */
 
@@ -905,30 +1261,46 @@ pfq_receive(struct napi_struct *napi, struct sk_buff * skb)
 		data->last_rx = current_rx;
 	}
 	else {
-		if (data->qbuff_queue->len == 0)
+		if (data->qbuff_queue->len == 0) {
+
+			/* redeliver the packets held for the lossless sockets */
+
+			if (data->rx_stash->queue.len) {
+				rcu_read_lock();
+				pfq_rx_stash_flush(data->rx_stash, cpu);
+				rcu_read_unlock();
+			}
 			return 0;
+		}
 	}
 
-	/* run IO now */
+	/* process groups and run IO now: sockets and groups are retired with RCU,
+	 * a single read-side section covers the whole batch */
 
 	__sparse_add(global->percpu_stats, recv, data->qbuff_queue->len, cpu);
 
-	return pfq_receive_run( data
-			      , pool
-			      , cpu);
-}
+	rcu_read_lock();
+
+	pfq_receive_groups(data, cpu);
 
+	ret = pfq_receive_run( data
+			     , pool
+			     , cpu);
+
+	rcu_read_unlock();
+	return ret;
+}
 
 
 int pfq_receive_run( struct pfq_percpu_data *data
 		   , struct pfq_percpu_pool *pool
 		   , int cpu)
 {
-	unsigned __int128 socket_mask[Q_MAX_ID] = { 0 };
-	unsigned long long all_fwd_mask = 0;
+	struct pfq_qbuff_mask *socket_mask = data->sock_mask;
+	unsigned long all_fwd_mask = 0;
 	struct pfq_endpoint_info endpoints;
         struct qbuff *buff;
-        unsigned int bit;
+        unsigned long bit;
 	size_t n;
 
 #if 0
@@ -942,7 +1314,7 @@ int pfq_receive_run( struct pfq_percpu_data *data
 	return 0;
 #endif
 
-	/* transpose the forward matrix */
+	/* transpose the forward matrix (socket masks are left clean by the previous run) */
 
 	for(n = 0; n < data->qbuff_queue->len; n++)
 	{
@@ -950,28 +1322,35 @@ int pfq_receive_run( struct pfq_percpu_data *data
 		all_fwd_mask |= buff->fwd_mask;
 		pfq_bitwise_foreach(buff->fwd_mask, bit,
 		{
-			socket_mask[pfq_ctz(bit)] |= (unsigned __int128)1 << n;
+			qbuff_mask_set(&socket_mask[pfq_ctz(bit)], n);
 		})
 	}
 
+	/* packets held for the lossless sockets go first */
+
+	if (data->rx_stash->queue.len)
+		pfq_rx_stash_flush(data->rx_stash, cpu);
+
         /* forward packets to endpoints */
 
 	pfq_bitwise_foreach(all_fwd_mask, bit,
 	{
 		pfq_id_t id = (__force pfq_id_t)pfq_ctz(bit);
-		struct pfq_sock *so = pfq_sock_get_by_id(id);
+		struct pfq_sock *so = pfq_sock_rcu(id);
 		if (likely(so))
 		{
-			pfq_copy_to_endpoint_qbuffs(so, PFQ_QBUFF_QUEUE(data->qbuff_queue), socket_mask[(int __force)id], cpu);
+			pfq_copy_to_endpoint_qbuffs(so, PFQ_QBUFF_QUEUE(data->qbuff_queue), &socket_mask[(int __force)id], cpu);
 		}
+
+		qbuff_mask_zero(&socket_mask[(int __force)id], data->qbuff_queue->len);
 	});
 
 	/* forward packets to device */
 
-	pfq_get_lazy_endpoints(PFQ_QBUFF_QUEUE(data->qbuff_queue), &endpoints);
+	pfq_get_lazy_endpoints(data->fwd_table, &endpoints);
 	if (endpoints.cnt_total)
 	{
-		size_t total = (size_t)pfq_qbuff_lazy_xmit_run(PFQ_QBUFF_QUEUE(data->qbuff_queue), &endpoints);
+		size_t total = (size_t)pfq_qbuff_lazy_xmit_run(PFQ_QBUFF_QUEUE(data->qbuff_queue), data->fwd_table, &endpoints);
 		__sparse_add(global->percpu_stats, frwd, total, cpu);
 		__sparse_add(global->percpu_stats, disc, endpoints.cnt_total - total, cpu);
 	}
@@ -999,6 +1378,7 @@ int pfq_receive_run( struct pfq_percpu_data *data
  	}
 
 	data->qbuff_queue->len = 0;
+	data->fwd_table->len = 0;
 	return 0;
 }
 
@@ -1019,91 +1399,294 @@ int pfq_copy_bits(const struct sk_buff *skb, int offset, void *to, int len)
 }
 
 
-size_t pfq_sk_queue_recv(struct pfq_sock *so,
+/* Rx timestamp (ns) of the given source: the software one is taken
+ * at capture, and used when the NIC did not stamp the packet */
+
+static inline uint64_t
+pfq_skb_tstamp(struct sk_buff *skb, int source)
+{
+	struct skb_shared_hwtstamps *hw = skb_hwtstamps(skb);
+
+	switch(source)
+	{
+	case Q_TSTAMP_HW_RAW:
+		if (ktime_to_ns(hw->hwtstamp))
+			return (uint64_t)ktime_to_ns(hw->hwtstamp);
+		break;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,17,0)
+	case Q_TSTAMP_HW_SYS:
+		if (ktime_to_ns(hw->syststamp))
+			return (uint64_t)ktime_to_ns(hw->syststamp);
+		break;
+#endif
+	}
+
+	return (uint64_t)ktime_to_ns(skb->tstamp);
+}
+
+
+/* copy a packet into its Rx slot, fill the header and commit it */
+
+static inline int
+pfq_sk_queue_fill(struct pfq_sock *so, struct pfq_pkthdr *hdr, struct sk_buff *skb, size_t bytes, pfq_qver_t qver)
+{
+	char *pkt = (char *)(hdr+1);
+
+	prefetch_w0(hdr);
+	prefetch_w0((char *)hdr + 64);
+
+	/* copy bytes of packet */
+
+	if (pfq_copy_bits(skb, 0, pkt, bytes) != 0) {
+		printk(KERN_WARNING "[PFQ] error: BUG! skb_copy_bits failed (bytes=%zu, skb_len=%d mac_len=%d)!\n",
+		       bytes, skb->len, skb->mac_len);
+		return -1;
+	}
+
+	/* fill pkt header */
+
+	if (likely(so->tstamp != Q_TSTAMP_OFF))
+		hdr->tstamp.tv64 = pfq_skb_tstamp(skb, so->tstamp);
+
+	hdr->caplen = (uint16_t)bytes;
+	hdr->len = (uint16_t)skb->len;
+
+	/* copy state from pfq_cb annotation */
+
+	hdr->info.data.mark  = skb->mark;
+
+	/* setup the header */
+
+	hdr->info.ifindex = skb->dev->ifindex;
+	hdr->info.vlan.tci = skb->vlan_tci & ~VLAN_TAG_PRESENT;
+	hdr->info.queue	= skb_rx_queue_recorded(skb) ? (uint16_t)skb_get_rx_queue(skb) : 0;
+
+	/* commit the slot (release semantic) */
+
+	__atomic_store_n(&hdr->info.commit, qver, __ATOMIC_RELEASE);
+	return 0;
+}
+
+
+/* high-watermark wakeup: the burst that takes the queue across the level
+ * wakes up the consumer (independently of PFQ_USE_POLL) */
+
+static inline void
+pfq_sk_queue_watermark(struct pfq_sock *so, size_t len, size_t burst)
+{
+	size_t level = so->rx_watermark_level;
+
+	if (level && len < level && len + burst >= level &&
+	    waitqueue_active(&so->waitqueue)) {
+		wake_up_interruptible(&so->waitqueue);
+	}
+}
+
+
+/* batched Rx wakeups: the producer that finds the ring empty opens a new batch
+ * (and arms the timer), the one whose packets take the ring across the
+ * threshold wakes up the consumer. Unlike the periodic wakeups, these do not
+ * depend on PFQ_USE_POLL. */
+
+static inline void
+pfq_sk_queue_wakeup_open(struct pfq_sock *so, int ring)
+{
+	if (likely(so->rx_wakeup_pkts == 0 && so->rx_wakeup_ns == 0))
+		return;
+
+	so->rx_wakeup[ring].first_ns = ktime_to_ns(ktime_get());
+
+	/* not hrtimer_active: the callback may be running and about to stop the timer */
+
+	if (so->rx_wakeup_ns && !hrtimer_is_queued(&so->rx_wakeup_timer))
+		hrtimer_start(&so->rx_wakeup_timer, ns_to_ktime(so->rx_wakeup_ns), HRTIMER_MODE_REL);
+}
+
+
+/* packed queues: count the packets of the ring version (the first producer
+ * of a new version restarts the count, no addition is lost) */
+
+static inline u32
+pfq_sk_queue_wakeup_add(struct pfq_rx_wakeup_state *state, pfq_qver_t qver, size_t copied)
+{
+	u64 old, new;
+
+	do {
+		old = (u64)atomic64_read(&state->pending);
+		new = (u32)(old >> 32) == (u32)qver ? old + copied : PFQ_RX_WAKEUP_PENDING(qver, copied);
+	}
+	while ((u64)atomic64_cmpxchg(&state->pending, (s64)old, (s64)new) != old);
+
+	return (u32)new;
+}
+
+
+/* start: the slot (or packet count) preceding the copied packets */
+
+static inline void
+pfq_sk_queue_wakeup(struct pfq_sock *so, int ring, pfq_qver_t qver, size_t start, size_t copied)
+{
+	size_t pending;
+
+	if (likely(so->rx_wakeup_pkts == 0 && so->rx_wakeup_ns == 0) || copied == 0)
+		return;
+
+	if (so->rx_packed) {
+		pending = pfq_sk_queue_wakeup_add(&so->rx_wakeup[ring], qver, copied);
+		start = pending - copied;
+	}
+	else
+		pending = start + copied;
+
+	if (so->rx_wakeup_pkts &&
+	    pending >= so->rx_wakeup_pkts && start < so->rx_wakeup_pkts &&
+	    waitqueue_active(&so->waitqueue)) {
+		wake_up_interruptible(&so->waitqueue);
+	}
+}
+
+
+/* packed Rx queue: the burst reserves bytes, packets are stored back-to-back
+ * (each one takes PFQ_SHARED_QUEUE_SLOT_SIZE(caplen) bytes). A packet is
+ * accepted only if a full slot fits from its offset: the reader stops
+ * at the same bound. */
+
+static size_t
+pfq_sk_queue_recv_packed(struct pfq_sock *so,
+			 struct pfq_shared_rx_queue *rx_queue,
+			 int ring,
 			 struct pfq_qbuff_queue *buffs,
-			 unsigned __int128 mask,
-			 int burst_len)
+			 struct pfq_qbuff_mask const *mask)
 {
-	struct pfq_shared_rx_queue *rx_queue = pfq_sock_rx_shared_queue(so);
+	const size_t limit = so->rx_queue_len * so->rx_slot_size - so->rx_slot_size;
 	struct pfq_pkthdr *hdr;
 	struct qbuff *buff;
 	unsigned long data;
-	size_t n, copied = 0;
+	size_t n, off, end, stride, burst_bytes = 0, copied = 0;
 	pfq_qver_t qver;
-	int qlen;
 
-	if (unlikely(rx_queue == NULL))
-		return 0;
+	for_each_qbuff_with_mask(mask, buffs, buff, n)
+	{
+		burst_bytes += PFQ_SHARED_QUEUE_SLOT_SIZE(min_t(size_t, QBUFF_SKB(buff)->len, so->rx_len));
+	}
 
-	data = __atomic_fetch_add(&rx_queue->shinfo, burst_len, __ATOMIC_RELAXED);
-	qlen = PFQ_SHARED_QUEUE_LEN(data);
+	data = __atomic_fetch_add(&rx_queue->shinfo, burst_bytes, __ATOMIC_RELAXED);
+	off  = PFQ_SHARED_QUEUE_LEN(data);
 	qver = PFQ_SHARED_QUEUE_VER(data);
+	end  = off + burst_bytes;
 
-	hdr  = (struct pfq_pkthdr *) pfq_mpsc_slot_ptr(so, qver, qlen);
+	pfq_sk_queue_watermark(so, off, burst_bytes);
+
+	if (off == 0)
+		pfq_sk_queue_wakeup_open(so, ring);
+
+	hdr  = (struct pfq_pkthdr *) pfq_mpsc_slot_ptr(so, ring, qver, 0);
 	if (unlikely(hdr == NULL))
 		return 0;
 
 	for_each_qbuff_with_mask(mask, buffs, buff, n)
 	{
 		struct sk_buff *skb = QBUFF_SKB(buff);
-		size_t bytes, slot_index;
-		char *pkt;
-
-		/* compute the boundaries */
-
-		bytes = min_t(size_t, skb->len, so->tx_len);
-		pkt = (char *)(hdr+1);
-		slot_index = qlen + copied;
-
-		prefetch_w0(hdr);
-		prefetch_w0((char *)hdr + 64);
+		size_t bytes = min_t(size_t, skb->len, so->rx_len);
+		struct pfq_pkthdr *this_hdr = PFQ_SHARED_QUEUE_NEXT_PKTHDR(hdr, off);
 
-		if (unlikely(slot_index >= so->rx_queue_len)) {
+		if (unlikely(off > limit)) {
 #ifdef PFQ_USE_POLL
 			if (waitqueue_active(&so->waitqueue)) {
 				wake_up_interruptible(&so->waitqueue);
 			}
 #endif
-			return copied;
+			break;
 		}
 
+		if (pfq_sk_queue_fill(so, this_hdr, skb, bytes, qver) < 0)
+			break;
+
+		stride = PFQ_SHARED_QUEUE_SLOT_SIZE(bytes);
 
-		/* copy bytes of packet */
-#if 1
-		if (pfq_copy_bits(skb, 0, pkt, bytes) != 0) {
-			printk(KERN_WARNING "[PFQ] error: BUG! skb_copy_bits failed (bytes=%zu, skb_len=%d mac_len=%d)!\n",
-			       bytes, skb->len, skb->mac_len);
-			return copied;
+		/* check for pending waitqueue (every 128KB of queue)... */
+
+#ifdef PFQ_USE_POLL
+		if (((off ^ (off + stride)) >> 17) &&
+		    waitqueue_active(&so->waitqueue)) {
+			wake_up_interruptible(&so->waitqueue);
 		}
-#else
-		skb_copy_from_linear_data_offset(skb, 0, pkt, bytes);
 #endif
+		copied++;
+		off += stride;
+	}
 
-		/* fill pkt header */
+	/* the reader waits for the commit of every slot of the reservation:
+	 * what is left (of the packets not copied) is filled with empty headers */
 
-		if (likely(so->tstamp != 0)) {
-			struct timespec ts;
-			skb_get_timestampns(skb, &ts);
-			hdr->tstamp.tv.sec  = (uint32_t)ts.tv_sec;
-			hdr->tstamp.tv.nsec = (uint32_t)ts.tv_nsec;
-		}
+	for(; off < end && off <= limit; off += PFQ_SHARED_QUEUE_SLOT_SIZE(0))
+	{
+		struct pfq_pkthdr *this_hdr = PFQ_SHARED_QUEUE_NEXT_PKTHDR(hdr, off);
+
+		this_hdr->caplen = 0;
+		this_hdr->len = 0;
+		__atomic_store_n(&this_hdr->info.commit, qver, __ATOMIC_RELEASE);
+	}
+
+	pfq_sk_queue_wakeup(so, ring, qver, 0, copied);
+	return copied;
+}
+
+
+size_t pfq_sk_queue_recv(struct pfq_sock *so,
+			 struct pfq_qbuff_queue *buffs,
+			 struct pfq_qbuff_mask const *mask,
+			 int burst_len,
+			 int cpu)
+{
+	struct pfq_shared_rx_queue *rx_queue;
+	struct pfq_pkthdr *hdr;
+	struct qbuff *buff;
+	unsigned long data;
+	size_t n, copied = 0;
+	pfq_qver_t qver;
+	int qlen, ring;
+
+	/* each producing cpu owns a sub-ring (when rx_ring_num covers the cpus) */
 
-		hdr->caplen = (uint16_t)bytes;
-		hdr->len = (uint16_t)skb->len;
+	ring = likely(so->rx_ring_num == 1) ? 0 : cpu % (int)so->rx_ring_num;
 
-		/* copy state from pfq_cb annotation */
+	rx_queue = pfq_sock_rx_shared_queue(so, ring);
+	if (unlikely(rx_queue == NULL))
+		return 0;
 
-		hdr->info.data.mark  = skb->mark;
+	if (so->rx_packed)
+		return pfq_sk_queue_recv_packed(so, rx_queue, ring, buffs, mask);
 
-		/* setup the header */
+	data = __atomic_fetch_add(&rx_queue->shinfo, burst_len, __ATOMIC_RELAXED);
+	qlen = PFQ_SHARED_QUEUE_LEN(data);
+	qver = PFQ_SHARED_QUEUE_VER(data);
+
+	pfq_sk_queue_watermark(so, (size_t)qlen, (size_t)burst_len);
+
+	if (qlen == 0)
+		pfq_sk_queue_wakeup_open(so, ring);
+
+	hdr  = (struct pfq_pkthdr *) pfq_mpsc_slot_ptr(so, ring, qver, qlen);
+	if (unlikely(hdr == NULL))
+		return 0;
 
-		hdr->info.ifindex = skb->dev->ifindex;
-		hdr->info.vlan.tci = skb->vlan_tci & ~VLAN_TAG_PRESENT;
-		hdr->info.queue	= skb_rx_queue_recorded(skb) ? (uint16_t)skb_get_rx_queue(skb) : 0;
+	for_each_qbuff_with_mask(mask, buffs, buff, n)
+	{
+		struct sk_buff *skb = QBUFF_SKB(buff);
+		size_t slot_index = qlen + copied;
 
-		/* commit the slot (release semantic) */
+		if (unlikely(slot_index >= so->rx_queue_len)) {
+#ifdef PFQ_USE_POLL
+			if (waitqueue_active(&so->waitqueue)) {
+				wake_up_interruptible(&so->waitqueue);
+			}
+#endif
+			break;
+		}
 
-		__atomic_store_n(&hdr->info.commit, qver, __ATOMIC_RELEASE);
+		if (pfq_sk_queue_fill(so, hdr, skb, min_t(size_t, skb->len, so->rx_len), qver) < 0)
+			break;
 
 		/* check for pending waitqueue... */
 
@@ -1119,6 +1702,172 @@ size_t pfq_sk_queue_recv(struct pfq_sock *so,
 		hdr = PFQ_SHARED_QUEUE_NEXT_PKTHDR(hdr, so->rx_slot_size);
 	}
 
+	pfq_sk_queue_wakeup(so, ring, qver, (size_t)qlen, copied);
 	return copied;
 }
 
+
+/* lossless Rx: the packets that do not fit the Rx queue are copied into the
+ * per-cpu stash (pooled skbs are recycled at the end of the batch) and
+ * redelivered in order, before any newer packet of the same socket. A held packet
+ * is lost when the stash is full or when it is not delivered within rx_hold_ns,
+ * and it holds a reference to its device until then (rx_hold_ns is capped by
+ * Q_RX_HOLD_MAX_USEC, the unregistration of the device waits for it). */
+
+static size_t
+pfq_rx_stash_push(struct pfq_rx_stash *stash,
+		  struct pfq_sock *so,
+		  struct pfq_qbuff_queue *buffs,
+		  struct pfq_qbuff_mask const *mask,
+		  size_t skip)
+{
+	u64 deadline = ktime_to_ns(ktime_get()) + so->rx_hold_ns;
+	struct qbuff *buff;
+	size_t n, held = 0;
+
+	for_each_qbuff_with_mask(mask, buffs, buff, n)
+	{
+		struct sk_buff *skb;
+		size_t index;
+
+		if (skip) {
+			skip--;
+			continue;
+		}
+
+		index = stash->queue.len;
+		if (unlikely(index == Q_RX_STASH_LEN))
+			break;
+
+		skb = skb_copy(QBUFF_SKB(buff), GFP_ATOMIC);
+		if (unlikely(skb == NULL))
+			break;
+
+		*skb_hwtstamps(skb) = *skb_hwtstamps(QBUFF_SKB(buff));
+
+		/* the copy is delivered later on: keep its device (ifindex) alive */
+
+		if (skb->dev)
+			dev_hold(skb->dev);
+
+		qbuff_init(&stash->queue.queue[index], skb, NULL, buff->counter);
+
+		stash->tag[index] = so->tag;
+		stash->id[index] = so->id;
+		stash->deadline[index] = deadline;
+		stash->queue.len++;
+		held++;
+	}
+
+	if (held)
+		stash->sock_mask |= 1UL << (__force int)so->id;
+
+	return held;
+}
+
+
+size_t pfq_sk_queue_recv_hold(struct pfq_sock *so,
+			      struct pfq_qbuff_queue *buffs,
+			      struct pfq_qbuff_mask const *mask,
+			      int burst_len,
+			      int cpu)
+{
+	struct pfq_rx_stash *stash = per_cpu_ptr(global->percpu_data, cpu)->rx_stash;
+	size_t copied = 0;
+
+	/* with packets already held, keep the order: hold the whole burst */
+
+	if (likely((stash->sock_mask & (1UL << (__force int)so->id)) == 0)) {
+		copied = pfq_sk_queue_recv(so, buffs, mask, burst_len, cpu);
+		if (likely(copied == (size_t)burst_len))
+			return copied;
+	}
+
+	return copied + pfq_rx_stash_push(stash, so, buffs, mask, copied);
+}
+
+
+void pfq_rx_stash_flush(struct pfq_rx_stash *stash, int cpu)
+{
+	u64 now = ktime_to_ns(ktime_get());
+	unsigned long sock_mask = stash->sock_mask, bit;
+	struct pfq_qbuff_mask done;
+	size_t n, len = stash->queue.len;
+
+	qbuff_mask_zero(&done, len);
+
+	pfq_bitwise_foreach(sock_mask, bit,
+	{
+		pfq_id_t id = (__force pfq_id_t)pfq_ctz(bit);
+		struct pfq_sock *so = pfq_sock_rcu(id);
+		struct pfq_qbuff_mask mask;
+		size_t cpy = 0, burst = 0, lost = 0;
+		bool alive = so != NULL && pfq_sock_shared_queue(so) != NULL;
+
+		qbuff_mask_zero(&mask, len);
+
+		/* packets of a socket that is gone (or whose id has been reused) are dropped */
+
+		for(n = 0; n < len; n++)
+		{
+			if (stash->id[n] != id)
+				continue;
+
+			if (alive && stash->tag[n] == so->tag) {
+				qbuff_mask_set(&mask, n);
+				burst++;
+			}
+			else {
+				qbuff_mask_set(&done, n);
+				__sparse_inc(global->percpu_stats, lost, cpu);
+			}
+		}
+
+		if (burst == 0)
+			continue;
+
+		smp_rmb();
+
+		cpy = pfq_sk_queue_recv(so, PFQ_QBUFF_QUEUE(&stash->queue), &mask, (int)burst, cpu);
+
+		for(n = qbuff_mask_next(&mask, 0, len); n < len; n = qbuff_mask_next(&mask, n+1, len))
+		{
+			if (cpy) {
+				cpy--;
+				qbuff_mask_set(&done, n);
+			}
+			else if ((s64)(now - stash->deadline[n]) >= 0) {
+				qbuff_mask_set(&done, n);
+				lost++;
+			}
+		}
+
+		if (lost)
+			__sparse_add(so->stats, lost, lost, cpu);
+	});
+
+	/* release the delivered (or expired) packets and compact the stash */
+
+	stash->sock_mask = 0;
+	stash->queue.len = 0;
+
+	for(n = 0; n < len; n++)
+	{
+		size_t index;
+
+		if (qbuff_mask_test(&done, n)) {
+			pfq_rx_stash_free_skb(QBUFF_SKB(&stash->queue.queue[n]));
+			continue;
+		}
+
+		index = stash->queue.len++;
+		if (index != n) {
+			stash->queue.queue[index] = stash->queue.queue[n];
+			stash->tag[index] = stash->tag[n];
+			stash->id[index] = stash->id[n];
+			stash->deadline[index] = stash->deadline[n];
+		}
+
+		stash->sock_mask |= 1UL << (__force int)stash->id[index];
+	}
+}
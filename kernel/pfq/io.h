@@ -29,7 +29,7 @@
 
 
 #define pfq_qbuff_queue_lazy_xmit(buffs, mask, dev, queue_index) ({ \
-		int check = STATIC_TYPE(unsigned __int128, mask) && \
+		int check = STATIC_TYPE(struct pfq_qbuff_mask const *, mask) && \
 			    STATIC_TYPE(struct net_device *, dev) && \
 			    STATIC_TYPE(int, queue_index); \
 		struct qbuff * buff; \
@@ -68,14 +68,28 @@ struct napi_struct;
 
 extern size_t pfq_sk_queue_recv( struct pfq_sock *so
 			       , struct pfq_qbuff_queue *buffs
-			       , unsigned __int128 buffs_mask
+			       , struct pfq_qbuff_mask const *buffs_mask
 			       , int burst_len
+			       , int cpu
 			       );
 
+extern size_t pfq_sk_queue_recv_hold( struct pfq_sock *so
+				    , struct pfq_qbuff_queue *buffs
+				    , struct pfq_qbuff_mask const *buffs_mask
+				    , int burst_len
+				    , int cpu
+				    );
+
+struct pfq_rx_stash;
+
+extern void pfq_rx_stash_flush(struct pfq_rx_stash *stash, int cpu);
+
 
 struct pfq_xmit_context
 {
 	struct pfq_skb_pool	*tx;
+	struct pfq_skb_bulk	*tx_alloc;	/* skbs popped from the pool for this burst */
+	struct pfq_skb_bulk	*tx_free;	/* skbs transmitted, to be pushed back */
 	struct net		*net;
 	ktime_t			now;
 	unsigned long		jiffies;
@@ -83,26 +97,18 @@ struct pfq_xmit_context
 	int			copies;
 	bool			*intr;
 	bool			xmit_more;
+	struct pfq_tx_zcopy	*zcopy;		/* completion of the current queue half, NULL for copy mode */
 };
 
 
-static inline size_t
-pfq_count_fwd_devs(struct net_device *dev, struct net_device **devs, size_t num_devs)
-{
-	size_t n, ret = 0;
-	for(n = 0; n < num_devs; n++)
-	{
-		if (dev == devs[n])
-			ret++;
-	}
-	return ret;
-}
-
-
-/* socket queues */
+/* socket queues: with a deadline, timestamped packets are held until their time
+ * and *deadline is set to the timestamp of the first held packet (nsec) */
 
 extern tx_response_t
-pfq_sk_queue_xmit(struct pfq_sock *so, int qindex, int cpu);
+pfq_sk_queue_xmit(struct pfq_sock *so, int qindex, int cpu, uint64_t *deadline, int budget);
+
+extern bool
+pfq_sk_queue_pending(struct pfq_shared_tx_queue *tx_queue);
 
 
 /* skb queues */
@@ -110,12 +116,13 @@ pfq_sk_queue_xmit(struct pfq_sock *so, int qindex, int cpu);
 extern int pfq_xmit(struct qbuff *buff, struct net_device *dev, int queue, int more);
 
 extern tx_response_t
-pfq_qbuff_queue_xmit(struct pfq_qbuff_queue *buff, unsigned __int128 buffs_mask, struct net_device *dev, int queue_index);
+pfq_qbuff_queue_xmit(struct pfq_qbuff_queue *buff, struct pfq_qbuff_mask const *buffs_mask, struct net_device *dev, int queue_index);
 
 /* skb lazy xmit */
 
 extern int pfq_qbuff_lazy_xmit(struct qbuff * buff, struct net_device *dev, int queue_index);
-extern int pfq_qbuff_lazy_xmit_run(struct pfq_qbuff_queue *queue, struct pfq_endpoint_info const *info);
+extern int pfq_qbuff_lazy_xmit_run(struct pfq_qbuff_queue *queue, struct pfq_qbuff_fwd_table const *table,
+				   struct pfq_endpoint_info const *info);
 
 
 /* receive */
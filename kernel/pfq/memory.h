@@ -30,6 +30,7 @@
 #include <pfq/global.h>
 #include <pfq/percpu.h>
 #include <pfq/pool.h>
+#include <pfq/prefetch.h>
 #include <pfq/skbuff.h>
 #include <pfq/sparse.h>
 #include <pfq/stats.h>
@@ -316,5 +317,85 @@ pfq_alloc_skb_pool(unsigned int size, gfp_t priority, int node, int idx, struct
 }
 
 
+/* bulk pool allocation: pop up to n recyclable skbs (the pool is never empty
+ * of skbs still in use by the driver: stop at the first one) */
+
+static inline
+size_t pfq_alloc_skb_pool_bulk(struct sk_buff **skbs, size_t n, int idx, struct pfq_skb_pool *pool)
+{
+#ifdef PFQ_USE_SKB_POOL
+	size_t i, k;
+
+	if (unlikely(!pool->fifo))
+		return 0;
+
+	k = pfq_spsc_peek_bulk(pool->fifo, (void **)skbs, n);
+
+	for(i = 0; i < k; i++) {
+		prefetch_w3(skbs[i]);
+		prefetch_r3(skbs[i] + global->max_pool_size);	/* recycle template */
+	}
+
+	for(i = 0; i < k; i++) {
+		if (unlikely(!pfq_skb_is_recycleable(skbs[i]))) {
+			sparse_inc(global->percpu_memory, pool_norecycl[idx]);
+			break;
+		}
+		prefetch_w3(skb_shinfo(skbs[i]));
+		prefetch_w3(skbs[i]->head);
+	}
+
+	if (i < n && i == k)
+		sparse_inc(global->percpu_memory, pool_empty[idx]);
+
+	k = i;
+	if (k == 0)
+		return 0;
+
+	pfq_spsc_consume_bulk(pool->fifo, k);
+
+	sparse_add(global->percpu_memory, pool_pop[idx], k);
+
+	for(i = 0; i < k; i++) {
+		pfq_skb_release_data(skbs[i]);
+		pfq_skb_recycle(skbs[i]);
+	}
+
+	return k;
+#else
+	return 0;
+#endif
+}
+
+
+/* bulk free: pool skbs are pushed back in a single operation, the others are released */
+
+static inline
+void pfq_free_skb_pool_bulk(struct sk_buff **skbs, size_t n, int idx, struct pfq_skb_pool *pool)
+{
+	size_t i, k = 0;
+
+	for(i = 0; i < n; i++)
+	{
+#ifdef PFQ_USE_SKB_POOL
+		if (likely(skbs[i]->peeked && pool->fifo)) {
+			skbs[k++] = skbs[i];
+			continue;
+		}
+#endif
+		sparse_inc(global->percpu_memory, os_free);
+		kfree_skb(skbs[i]);
+	}
+
+	if (k) {
+		size_t pushed = pfq_spsc_push_bulk(pool->fifo, (void **)skbs, k);
+		sparse_add(global->percpu_memory, pool_push[idx], pushed);
+		if (unlikely(pushed < k)) {
+			pfq_printk_skb("[PFQ] internal error", skbs[pushed]);
+			sparse_add(global->percpu_memory, os_free, k - pushed);
+		}
+	}
+}
+
 
 #endif /* PFQ_MEMORY_H */
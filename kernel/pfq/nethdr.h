@@ -25,12 +25,14 @@
 #define PFQ_NET_HEADERS_H
 
 #include <net/ip.h>
+#include <net/ipv6.h>
 
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/udp.h>
 #include <linux/tcp.h>
 #include <linux/icmp.h>
+#include <linux/icmpv6.h>
 #include <linux/if_vlan.h>
 #include <linux/in.h>
 #include <linux/etherdevice.h>
@@ -39,6 +39,7 @@ module_param_named(skb_tx_pool_size,	 default_global.skb_tx_pool_size,	int, 0644
 module_param_named(skb_rx_pool_size,	 default_global.skb_rx_pool_size,	int, 0644);
 module_param_named(vlan_untag,		 default_global.vlan_untag,		int, 0644);
 module_param_named(tx_retry,		 default_global.tx_retry,		int, 0644);
+module_param_named(tx_poll,		 default_global.tx_poll,		int, 0644);
 
 module_param_array_named(tx_cpu,	 default_global.tx_cpu,	  int, &default_global.tx_cpu_nr, 0644);
 
@@ -55,4 +56,5 @@ MODULE_PARM_DESC(skb_rx_pool_size,	" Socket buffer Rx pool size (default=1024)")
 
 MODULE_PARM_DESC(tx_cpu,		" Tx k-threads cpu");
 MODULE_PARM_DESC(tx_retry,		" Tx retry attempts (default 1)");
+MODULE_PARM_DESC(tx_poll,		" Tx k-threads busy-poll budget before parking, usec (default 100, 0 = never park)");
 
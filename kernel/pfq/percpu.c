@@ -27,6 +27,9 @@
 #include <pfq/qbuff.h>
 #include <pfq/memory.h>
 #include <pfq/define.h>
+#include <pfq/bitops.h>
+
+#include <lang/monad.h>
 
 int pfq_percpu_alloc(void)
 {
@@ -73,6 +76,11 @@ void pfq_percpu_free(void)
 
 		struct pfq_percpu_data *data = per_cpu_ptr(global->percpu_data, cpu);
 		pfq_free_pages(data->qbuff_queue, sizeof(struct pfq_qbuff_long_queue));
+		pfq_free_pages(data->sock_mask, sizeof(struct pfq_qbuff_mask) * Q_MAX_ID);
+		pfq_free_pages(data->fwd_table, sizeof(struct pfq_qbuff_fwd_table));
+		pfq_free_pages(data->group_mask, sizeof(struct pfq_qbuff_mask) * Q_MAX_GID);
+		pfq_free_pages(data->monad, sizeof(struct pfq_lang_monad) * Q_BUFF_QUEUE_LEN);
+		pfq_free_pages(data->rx_stash, sizeof(struct pfq_rx_stash));
 	}
 
 	free_percpu(global->percpu_stats);
@@ -93,19 +101,53 @@ int pfq_percpu_init(void)
 		memset(per_cpu_ptr(global->percpu_stats, cpu), 0, sizeof(pfq_global_stats_t));
 		memset(per_cpu_ptr(global->percpu_memory, cpu), 0, sizeof(struct pfq_memory_stats));
 
-		preempt_disable();
-
                 data = per_cpu_ptr(global->percpu_data, cpu);
 
 		data->counter = 0;
 
-		data->qbuff_queue = pfq_malloc_pages(sizeof(struct pfq_qbuff_long_queue), GFP_KERNEL);
+		/* queues are walked by the cpu in softirq: keep them on its memory node */
+
+		data->node = cpu_to_node(cpu);
+		data->mem_size = 0;
+
+		data->qbuff_queue = pfq_malloc_pages_node(sizeof(struct pfq_qbuff_long_queue), GFP_KERNEL, data->node);
 		if (!data->qbuff_queue)
 			return -ENOMEM;
 
 		data->qbuff_queue->len = 0;
+		data->mem_size += PAGE_SIZE << get_order(sizeof(struct pfq_qbuff_long_queue));
 
-		preempt_enable();
+		data->sock_mask = pfq_malloc_pages_node(sizeof(struct pfq_qbuff_mask) * Q_MAX_ID, GFP_KERNEL | __GFP_ZERO, data->node);
+		if (!data->sock_mask)
+			return -ENOMEM;
+
+		data->mem_size += PAGE_SIZE << get_order(sizeof(struct pfq_qbuff_mask) * Q_MAX_ID);
+
+		data->fwd_table = pfq_malloc_pages_node(sizeof(struct pfq_qbuff_fwd_table), GFP_KERNEL, data->node);
+		if (!data->fwd_table)
+			return -ENOMEM;
+
+		data->fwd_table->len = 0;
+		data->mem_size += PAGE_SIZE << get_order(sizeof(struct pfq_qbuff_fwd_table));
+
+		data->group_mask = pfq_malloc_pages_node(sizeof(struct pfq_qbuff_mask) * Q_MAX_GID, GFP_KERNEL | __GFP_ZERO, data->node);
+		if (!data->group_mask)
+			return -ENOMEM;
+
+		data->group_mask_all = 0;
+		data->mem_size += PAGE_SIZE << get_order(sizeof(struct pfq_qbuff_mask) * Q_MAX_GID);
+
+		data->monad = pfq_malloc_pages_node(sizeof(struct pfq_lang_monad) * Q_BUFF_QUEUE_LEN, GFP_KERNEL, data->node);
+		if (!data->monad)
+			return -ENOMEM;
+
+		data->mem_size += PAGE_SIZE << get_order(sizeof(struct pfq_lang_monad) * Q_BUFF_QUEUE_LEN);
+
+		data->rx_stash = pfq_malloc_pages_node(sizeof(struct pfq_rx_stash), GFP_KERNEL | __GFP_ZERO, data->node);
+		if (!data->rx_stash)
+			return -ENOMEM;
+
+		data->mem_size += PAGE_SIZE << get_order(sizeof(struct pfq_rx_stash));
 	}
 
 	return 0;
@@ -125,6 +167,7 @@ int pfq_percpu_qbuff_queue_reset(void)
 		struct pfq_percpu_data *data;
 		struct pfq_percpu_pool *pool;
 		struct qbuff *buff;
+		unsigned long bit;
 		size_t n;
 
 		preempt_disable();
@@ -140,6 +183,13 @@ int pfq_percpu_qbuff_queue_reset(void)
 
                 total += data->qbuff_queue->len;
 		data->qbuff_queue->len = 0;
+		data->fwd_table->len = 0;
+
+		pfq_bitwise_foreach(data->group_mask_all, bit,
+		{
+			qbuff_mask_zero(&data->group_mask[pfq_ctz(bit)], Q_BUFF_QUEUE_LEN);
+		});
+		data->group_mask_all = 0;
 
 		preempt_enable();
         }
@@ -159,6 +209,8 @@ int pfq_percpu_destruct(void)
         for_each_present_cpu(cpu) {
 
 		struct pfq_percpu_data *data;
+		unsigned long bit;
+		size_t n;
 
 		preempt_disable();
 
@@ -166,6 +218,22 @@ int pfq_percpu_destruct(void)
 
                 total += data->qbuff_queue->len;
 		data->qbuff_queue->len = 0;
+		data->fwd_table->len = 0;
+
+		/* release the packets still held for the lossless sockets */
+
+		for(n = 0; n < data->rx_stash->queue.len; n++)
+			pfq_rx_stash_free_skb(QBUFF_SKB(&data->rx_stash->queue.queue[n]));
+
+		total += data->rx_stash->queue.len;
+		data->rx_stash->queue.len = 0;
+		data->rx_stash->sock_mask = 0;
+
+		pfq_bitwise_foreach(data->group_mask_all, bit,
+		{
+			qbuff_mask_zero(&data->group_mask[pfq_ctz(bit)], Q_BUFF_QUEUE_LEN);
+		});
+		data->group_mask_all = 0;
 
 		preempt_enable();
         }
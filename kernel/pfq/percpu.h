@@ -35,6 +35,7 @@
 #include <pfq/qbuff.h>
 
 #include <linux/spinlock.h>
+#include <linux/netdevice.h>
 
 extern int  pfq_percpu_init(void);
 extern int  pfq_percpu_qbuff_queue_reset(void);
@@ -48,6 +49,11 @@ struct pfq_percpu_pool
 	struct pfq_skb_pool	tx;
 	struct pfq_skb_pool	rx;
 
+	/* Tx bulk caches (under tx_lock) */
+
+	struct pfq_skb_bulk	tx_alloc;
+	struct pfq_skb_bulk	tx_free;
+
 } ____pfq_cacheline_aligned;
 
 
@@ -55,14 +61,49 @@ int  pfq_percpu_alloc(void);
 void pfq_percpu_free(void);
 
 
+/* packets held (copied) for the lossless sockets whose Rx queue was full:
+ * they are redelivered in order at the next batch or timer tick */
+
+struct pfq_rx_stash
+{
+	struct pfq_qbuff_stash_queue	queue;
+	uint32_t			tag[Q_RX_STASH_LEN];		/* socket tag (the id may be reused) */
+	pfq_id_t			id[Q_RX_STASH_LEN];
+	u64				deadline[Q_RX_STASH_LEN];	/* ns */
+	unsigned long			sock_mask;			/* sockets with held packets */
+};
+
+
+/* a held packet pins its device until it is released */
+
+static inline
+void pfq_rx_stash_free_skb(struct sk_buff *skb)
+{
+	if (skb->dev)
+		dev_put(skb->dev);
+	kfree_skb(skb);
+}
+
+
+struct pfq_lang_monad;
+
 struct pfq_percpu_data
 {
 	struct pfq_qbuff_long_queue  *qbuff_queue;
+	struct pfq_qbuff_mask	     *sock_mask;	/* per-socket masks of the current batch [Q_MAX_ID] */
+	struct pfq_qbuff_fwd_table   *fwd_table;	/* lazy forward annotations of the current batch */
+	struct pfq_qbuff_mask	     *group_mask;	/* per-group masks of the current batch [Q_MAX_GID] */
+	struct pfq_lang_monad	     *monad;		/* per-qbuff monads of the current batch [Q_BUFF_QUEUE_LEN] */
+	struct pfq_rx_stash	     *rx_stash;		/* packets held for the lossless sockets */
+	unsigned long		      group_mask_all;	/* groups with at least one qbuff in the current batch */
 
 	ktime_t			last_rx;
 	struct timer_list	timer;
 	uint32_t		counter;
 
+	int			node;		/* memory node of the per-cpu queues */
+	size_t			mem_size;	/* bytes allocated on node */
+
 } ____pfq_cacheline_aligned;
 
 
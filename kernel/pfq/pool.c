@@ -95,24 +95,26 @@ int pfq_skb_pool_init(struct pfq_skb_pool *pool, size_t pool_size, size_t skb_le
 	if (pool->fifo != NULL)
 		return 0;
 
-	/* allocate pages for skb */
+	/* allocate pages for skb on the memory node of the cpu */
 
-	pool->base = pfq_malloc_pages( global->max_pool_size * 2 * sizeof(struct sk_buff), GFP_KERNEL);
+	pool->node = cpu_to_node(cpu);
+
+	pool->base = pfq_malloc_pages_node( global->max_pool_size * 2 * sizeof(struct sk_buff), GFP_KERNEL, pool->node);
 	pool->base_size = pool->base ? global->max_pool_size * 2 * sizeof(struct sk_buff) :  0;
 	if (!pool->base) {
 		printk(KERN_ERR "[PFQ] pfq_skb_pool_init(base): could not allocate memory!\n");
 		goto err;
 	}
 
-	pool->data = pfq_malloc_pages( global->max_pool_size * global->max_slot_size, GFP_KERNEL);
+	pool->data = pfq_malloc_pages_node( global->max_pool_size * global->max_slot_size, GFP_KERNEL, pool->node);
 	pool->data_size = pool->data ? global->max_pool_size * global->max_slot_size: 0;
 	if (!pool->data) {
 		printk(KERN_ERR "[PFQ] pfq_skb_pool_init(data): could not allocate memory!\n");
 		goto err;
 	}
 
-	printk(KERN_INFO "[PFQ] pool: base@%p (%zu bytes).\n", pool->base, pool->base_size);
-	printk(KERN_INFO "[PFQ] pool: data@%p (%zu bytes).\n", pool->data, pool->data_size);
+	printk(KERN_INFO "[PFQ] pool: base@%p (%zu bytes, node %d).\n", pool->base, pool->base_size, pool->node);
+	printk(KERN_INFO "[PFQ] pool: data@%p (%zu bytes, node %d).\n", pool->data, pool->data_size, pool->node);
 
 	/* one slot is added by the queue to distinguish between full and empty state */
 	pool->fifo = pfq_spsc_init(pool_size + PFQ_POOL_CACHELINE_PAD-1, cpu);
@@ -38,6 +38,17 @@ struct pfq_skb_pool
 	size_t		       base_size;
 	void		      *data;
 	size_t		       data_size;
+	int		       node;
+};
+
+
+/* skbs popped from (or to be pushed back to) a pool in a single operation */
+
+struct pfq_skb_bulk
+{
+	size_t		       len;
+	size_t		       next;
+	struct sk_buff	      *skb[Q_BUFF_BATCH_LEN];
 };
 
 
@@ -36,6 +36,7 @@
 
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/nodemask.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/pf_q.h>
@@ -117,7 +118,7 @@ static int pfq_proc_sockets(struct seq_file *m, void *v)
 
         for(n = 0; n < (__force int)Q_MAX_ID; n++)
         {
-		struct pfq_sock *so = (struct pfq_sock *)atomic_long_read(&global->socket_ptr[(__force int)n]);
+		struct pfq_sock *so = pfq_sock_get_by_id((__force pfq_id_t)n);
                 struct pfq_stats stats;
 
 		if (!so)
@@ -196,15 +197,20 @@ static int pfq_proc_stats(struct seq_file *m, void *v)
 	seq_printf(m, "FORWARD:\n");
 	seq_printf(m, "  forwarded : %ld\n", sparse_read(global->percpu_stats, frwd));
 	seq_printf(m, "  kernel    : %ld\n", sparse_read(global->percpu_stats, kern));
+	seq_printf(m, "TIMED:\n");
+	seq_printf(m, "  sent      : %ld\n", sparse_read(global->percpu_stats, timed));
+	seq_printf(m, "  late      : %ld\n", sparse_read(global->percpu_stats, late));
+	seq_printf(m, "  lateness  : %ld ns\n", sparse_read(global->percpu_stats, lateness));
+	seq_printf(m, "  throttled : %ld\n", sparse_read(global->percpu_stats, thrt));
 	return 0;
 }
 
 
 static int pfq_proc_memory(struct seq_file *m, void *v)
 {
-#ifdef PFQ_USE_SKB_POOL
+	int i, n;
 
-	int i;
+#ifdef PFQ_USE_SKB_POOL
 
 	long int push_0 = sparse_read(global->percpu_memory, pool_push[0]);
 	long int push_1 = sparse_read(global->percpu_memory, pool_push[1]);
@@ -228,13 +234,14 @@ static int pfq_proc_memory(struct seq_file *m, void *v)
 	{
 		struct pfq_percpu_pool *pool = per_cpu_ptr(global->percpu_pool, i);
 
-		seq_printf(m, "CPU-%d:\n", i);
+		seq_printf(m, "CPU-%d (node %d):\n", i, cpu_to_node(i));
 		if (pool)
 		{
 			long int rx = pfq_spsc_len(pool->rx.fifo);
 			long int tx = pfq_spsc_len(pool->tx.fifo);
 
 			seq_printf(m, "     pool size   : %10ld %10ld\n", rx, tx);
+			seq_printf(m, "     pool node   : %10d %10d\n", pool->rx.node, pool->tx.node);
 		}
 	}
 
@@ -258,6 +265,29 @@ static int pfq_proc_memory(struct seq_file *m, void *v)
 #endif
 
 #endif
+	seq_printf(m, "\nPFQ NUMA        %10s %10s\n", "pool", "percpu");
+
+	for_each_online_node(n)
+	{
+		size_t pool_bytes = 0, data_bytes = 0;
+
+		for_each_present_cpu(i)
+		{
+			struct pfq_percpu_data *data = per_cpu_ptr(global->percpu_data, i);
+			struct pfq_percpu_pool *pool = per_cpu_ptr(global->percpu_pool, i);
+
+			if (data->node == n)
+				data_bytes += data->mem_size;
+
+			if (pool->rx.node == n)
+				pool_bytes += pool->rx.base_size + pool->rx.data_size;
+			if (pool->tx.node == n)
+				pool_bytes += pool->tx.base_size + pool->tx.data_size;
+		}
+
+		seq_printf(m, "  node-%-2d (KB)   : %10zu %10zu\n", n, pool_bytes >> 10, data_bytes >> 10);
+	}
+
 	seq_printf(m, "\nKernel\n");
 	seq_printf(m, "  skb_alloc      : %10ld\n", sparse_read(global->percpu_memory, os_alloc));
 	seq_printf(m, "  skb_free       : %10ld\n", sparse_read(global->percpu_memory, os_free));
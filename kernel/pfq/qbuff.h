@@ -23,6 +23,7 @@
 #ifndef PFQ_QBUFF_H
 #define PFQ_QBUFF_H
 
+#include <pfq/bitops.h>
 #include <pfq/global.h>
 #include <pfq/vlan.h>
 #include <pfq/types.h>
@@ -36,14 +37,17 @@
 struct pfq_lang_monad;
 
 
+/* note: the devices a qbuff is forwarded to are recorded in the
+ * per-batch forward table (struct pfq_qbuff_fwd_table), keeping the qbuff
+ * within half a cache line */
+
 struct qbuff
 {
 	void		       *addr;				/* struct sk_buff * */
 	struct pfq_lang_monad  *monad;
-	struct net_device      *fwd_dev[Q_BUFF_QUEUE_LEN];	/* fwd to devs */
-	size_t			fwd_dev_num;
         unsigned long		fwd_mask;			/* fwd to sockets */
         uint32_t		counter;			/* unique id */
+	uint16_t		fwd_dev_num;			/* fwd to devs (annotations in fwd table) */
         bool			to_kernel;			/* fwd to kernel */
 };
 
@@ -81,17 +85,81 @@ struct pfq_qbuff_queue
 
 PFQ_DEFINE_QUEUE(struct pfq_qbuff_batch_queue, Q_BUFF_BATCH_LEN);
 PFQ_DEFINE_QUEUE(struct pfq_qbuff_long_queue,  Q_BUFF_QUEUE_LEN);
+PFQ_DEFINE_QUEUE(struct pfq_qbuff_stash_queue, Q_RX_STASH_LEN);
+
+
+/* bitmask of qbuffs in a queue: one bit per packet (up to Q_BUFF_QUEUE_LEN) */
+
+struct pfq_qbuff_mask
+{
+	unsigned long word[Q_BUFF_MASK_WORDS];
+};
+
+
+static inline void
+qbuff_mask_zero(struct pfq_qbuff_mask *mask, size_t len)
+{
+	pfq_bitmap_zero(mask->word, len);
+}
+
+static inline void
+qbuff_mask_set(struct pfq_qbuff_mask *mask, size_t n)
+{
+	pfq_bitmap_set(mask->word, n);
+}
+
+static inline void
+qbuff_mask_clear(struct pfq_qbuff_mask *mask, size_t n)
+{
+	pfq_bitmap_clear(mask->word, n);
+}
+
+static inline bool
+qbuff_mask_test(struct pfq_qbuff_mask const *mask, size_t n)
+{
+	return pfq_bitmap_test(mask->word, n);
+}
+
+static inline size_t
+qbuff_mask_weight(struct pfq_qbuff_mask const *mask, size_t len)
+{
+	return pfq_bitmap_weight(mask->word, len);
+}
+
+static inline size_t
+qbuff_mask_next(struct pfq_qbuff_mask const *mask, size_t n, size_t len)
+{
+	return pfq_bitmap_next(mask->word, n, len);
+}
+
+
+/* per-batch forward table: lazy forwarding annotations (device, qbuff index) */
+
+struct pfq_qbuff_fwd
+{
+	struct net_device *dev;
+	size_t		   index;
+};
+
+
+struct pfq_qbuff_fwd_table
+{
+	size_t len;
+	struct pfq_qbuff_fwd fwd[Q_BUFF_FWD_TABLE_LEN];
+};
 
 
 #define PFQ_QBUFF_QUEUE(q) \
 	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_batch_queue *),(struct pfq_qbuff_queue *)(q), \
-	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_long_queue *), (struct pfq_qbuff_queue *)(q), (void)0))
+	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_long_queue *), (struct pfq_qbuff_queue *)(q), \
+	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_stash_queue *),(struct pfq_qbuff_queue *)(q), (void)0)))
 
 
 #define PFQ_QBUFF_QUEUE_AT(q, n) \
 	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_batch_queue *), (struct qbuff  *)(&((q)->queue[n])), \
 	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_long_queue *),  (struct qbuff  *)(&((q)->queue[n])), \
-	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_queue *),       (struct qbuff  *)(&((q)->queue[n])),  (void)0)))
+	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_stash_queue *), (struct qbuff  *)(&((q)->queue[n])), \
+	__builtin_choose_expr(__builtin_types_compatible_p(typeof(q),struct pfq_qbuff_queue *),       (struct qbuff  *)(&((q)->queue[n])),  (void)0))))
 
 
 #define STATIC_TYPE(typ, val) __builtin_choose_expr(__builtin_types_compatible_p(typ, typeof((val))), 0, (void)0)
@@ -102,8 +170,8 @@ PFQ_DEFINE_QUEUE(struct pfq_qbuff_long_queue,  Q_BUFF_QUEUE_LEN);
 
 
 #define for_each_qbuff_with_mask(mask, q, buff, n) \
-        for((n) = pfq_ctz(mask); ((n) < (q)->len) && (mask) && ((buff) = PFQ_QBUFF_QUEUE_AT((q),n)); \
-                (mask) ^=(((unsigned __int128)1) << (n)), n = pfq_ctz(mask))
+        for((n) = qbuff_mask_next((mask), 0, (q)->len); ((n) < (q)->len) && ((buff) = PFQ_QBUFF_QUEUE_AT((q),n)); \
+                (n) = qbuff_mask_next((mask), (n)+1, (q)->len))
 
 
 #define for_each_qbuff_from(x, q, buff, n) \
@@ -299,10 +367,23 @@ qbuff_run_bp_filter(struct qbuff *buff, struct pfq_group *this_group)
 
 }
 
+/* eBPF program of the group: the return value is a verdict, a steering hash or a class mask */
+
+static inline uint32_t
+qbuff_run_ebpf(struct qbuff *buff, struct bpf_prog *prog)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
+	return bpf_prog_run_save_cb(prog, QBUFF_SKB(buff));
+#else
+	return 1;
+#endif
+}
+
+
 static inline bool
-qbuff_run_vlan_filter(struct qbuff const *buff, pfq_gid_t gid)
+qbuff_run_vlan_filter(struct qbuff const *buff, struct pfq_vlan_filter const *filter)
 {
-	return pfq_group_check_vlan_filter(gid, QBUFF_SKB(buff)->vlan_tci & ~VLAN_TAG_PRESENT);
+	return pfq_vlan_filter_test(filter, QBUFF_SKB(buff)->vlan_tci & ~VLAN_TAG_PRESENT);
 }
 
 
@@ -36,7 +36,7 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr, size_t use
 	if (!atomic_long_read(&so->shmem_addr)) {
 
 		struct pfq_shared_queue * mapped_queue;
-                unsigned int i; size_t n;
+                unsigned int i; size_t n, r;
 
 		/* alloc queue memory */
 
@@ -49,22 +49,34 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr, size_t use
 
 		mapped_queue = (struct pfq_shared_queue *)so->shmem.addr;
 
-		/* initialize Rx queue */
+		/* initialize Rx rings */
 
-		mapped_queue->rx.shinfo    = 0;
-		mapped_queue->rx.len       = (unsigned int)so->rx_queue_len;
-		mapped_queue->rx.size      = (unsigned int)pfq_mpsc_queue_mem(so)/2;
-		mapped_queue->rx.slot_size = (unsigned int)so->rx_slot_size;
+		mapped_queue->rx_ring_num = (unsigned int)so->rx_ring_num;
 
-		/* reset Rx slots */
+		so->rx_watermark_level = pfq_mpsc_watermark_level(so);
 
-		for(i = 0; i < 2; i++)
+		for(r = 0; r < so->rx_ring_num; r++)
 		{
-			char * raw = so->shmem.addr + sizeof(struct pfq_shared_queue) + i * mapped_queue->rx.size;
-			char * end = raw + mapped_queue->rx.size;
-			const int rst = !i;
-			for(;raw < end; raw += mapped_queue->rx.slot_size)
-				((struct pfq_pkthdr *)raw)->info.commit = (uint16_t)rst;
+			struct pfq_shared_rx_queue *rx = &mapped_queue->rx[r];
+
+			rx->shinfo    = 0;
+			rx->len       = (unsigned int)so->rx_queue_len;
+			rx->size      = (unsigned int)pfq_mpsc_ring_mem(so)/2;
+			rx->slot_size = (unsigned int)so->rx_slot_size;
+			rx->packed    = (unsigned int)so->rx_packed;
+
+			/* reset Rx slots (packed packets may start at any aligned offset) */
+
+			for(i = 0; i < 2; i++)
+			{
+				char * raw = so->shmem.addr + PFQ_SHARED_QUEUE_HDR_SIZE(so->txq_max_async)
+							    + r * pfq_mpsc_ring_mem(so) + i * rx->size;
+				char * end = raw + rx->size;
+				const size_t step = so->rx_packed ? PFQ_SLOT_ALIGNMENT : rx->slot_size;
+				const int rst = !i;
+				for(;raw < end; raw += step)
+					((struct pfq_pkthdr *)raw)->info.commit = (uint16_t)rst;
+			}
 		}
 
 		/* initialize TX queues */
@@ -79,7 +91,9 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr, size_t use
 
 		/* initialize TX async queues */
 
-		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		mapped_queue->tx_async_num = (unsigned int)so->txq_max_async;
+
+		for(n = 0; n < so->txq_max_async; n++)
 		{
 			mapped_queue->tx_async[n].size  = pfq_spsc_queue_mem(so)/2;
 
@@ -90,18 +104,22 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr, size_t use
 			mapped_queue->tx_async[n].cons.off   = 0;
 		}
 
+		/* initialize zero-copy completions */
+
+		pfq_sock_tx_zcopy_init(so, mapped_queue);
+
 		/* commit queues */
 
 		smp_wmb();
 
 		atomic_long_set(&so->shmem_addr, (unsigned long)so->shmem.addr);
 
-		pr_devel("[PFQ|%d] Rx queue: len=%zu slot_size=%zu caplen=%zu, mem=%zu bytes\n",
+		pr_devel("[PFQ|%d] Rx queue: len=%zu slot_size=%zu caplen=%zu, mem=%zu bytes (%zu rings)\n",
 			 so->id,
 			 so->rx_queue_len,
 			 so->rx_slot_size,
 			 so->rx_len,
-			 pfq_mpsc_queue_mem(so));
+			 pfq_mpsc_queue_mem(so), so->rx_ring_num);
 
 		pr_devel("[PFQ|%d] Tx queue: len=%zu slot_size=%zu xmitlen=%zu, mem=%zu bytes\n",
 			 so->id,
@@ -115,7 +133,7 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr, size_t use
 			 so->tx_queue_len,
 			 so->tx_slot_size,
 			 so->tx_len,
-			 pfq_spsc_queue_mem(so) * Q_MAX_TX_QUEUES, Q_MAX_TX_QUEUES);
+			 pfq_spsc_queue_mem(so) * so->txq_max_async, (int)so->txq_max_async);
 	}
 
 	return 0;
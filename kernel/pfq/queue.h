@@ -36,11 +36,24 @@ extern int pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr,
 extern int pfq_shared_queue_unmap(struct pfq_sock *so);
 
 
-static inline size_t pfq_mpsc_queue_mem(struct pfq_sock *so)
+static inline size_t pfq_mpsc_ring_mem(struct pfq_sock *so)
 {
         return so->rx_queue_len * so->rx_slot_size * 2;
 }
 
+static inline size_t pfq_mpsc_queue_mem(struct pfq_sock *so)
+{
+        return pfq_mpsc_ring_mem(so) * so->rx_ring_num;
+}
+
+/* high watermark of a Rx ring, in slots (bytes for packed queues) */
+
+static inline size_t pfq_mpsc_watermark_level(struct pfq_sock *so)
+{
+	size_t capacity = so->rx_packed ? so->rx_queue_len * so->rx_slot_size : so->rx_queue_len;
+        return capacity * so->rx_watermark / 100;
+}
+
 static inline size_t pfq_spsc_queue_mem(struct pfq_sock *so)
 {
         return so->tx_queue_len * so->tx_slot_size * 2;
@@ -52,21 +65,26 @@ size_t pfq_mpsc_queue_len(struct pfq_sock *p)
 {
 	struct pfq_shared_queue *q = pfq_sock_shared_queue(p);
 	unsigned long data;
+	size_t n, len = 0;
 	if (!q)
 		return 0;
-	data = __atomic_load_n(&q->rx.shinfo, __ATOMIC_RELAXED);
-        return PFQ_SHARED_QUEUE_LEN(data);
+	for(n = 0; n < p->rx_ring_num; n++)
+	{
+		data = __atomic_load_n(&q->rx[n].shinfo, __ATOMIC_RELAXED);
+		len += PFQ_SHARED_QUEUE_LEN(data);
+	}
+        return len;
 }
 
 
 static inline
-int pfq_mpsc_queue_index(struct pfq_sock *p)
+int pfq_mpsc_queue_index(struct pfq_sock *p, int ring)
 {
 	struct pfq_shared_queue *q = pfq_sock_shared_queue(p);
 	unsigned long data;
 	if (!q)
 		return 0;
-	data = __atomic_load_n(&q->rx.shinfo, __ATOMIC_RELAXED);
+	data = __atomic_load_n(&q->rx[ring].shinfo, __ATOMIC_RELAXED);
         return PFQ_SHARED_QUEUE_VER(data) & 1;
 }
 
@@ -79,7 +97,7 @@ void * pfq_sock_rx_queue_mem(struct pfq_sock *so)
 	if (unlikely(sq == NULL))
 		return NULL;
 
-	return (void *)sq + sizeof(struct pfq_shared_queue);
+	return (void *)sq + PFQ_SHARED_QUEUE_HDR_SIZE(so->txq_max_async);
 }
 
 
@@ -90,20 +108,21 @@ void *pfq_sock_tx_queue_mem(struct pfq_sock *so, int index)
 	if (unlikely(sq == NULL))
 		return NULL;
 
-	return (void *)sq + sizeof(struct pfq_shared_queue)
+	return (void *)sq + PFQ_SHARED_QUEUE_HDR_SIZE(so->txq_max_async)
 			  + pfq_mpsc_queue_mem(so)
 			  + pfq_spsc_queue_mem(so) * (1 + index);
 }
 
 
 static inline
-char *pfq_mpsc_slot_ptr(struct pfq_sock *so, size_t qindex, size_t slot)
+char *pfq_mpsc_slot_ptr(struct pfq_sock *so, int ring, size_t qindex, size_t slot)
 {
 	void *rx_mem = pfq_sock_rx_queue_mem(so);
 	if (!rx_mem)
 		return NULL;
 
-	return (char *)rx_mem + (so->rx_queue_len * (qindex & 1) + slot) * so->rx_slot_size;
+	return (char *)rx_mem + pfq_mpsc_ring_mem(so) * ring
+			      + (so->rx_queue_len * (qindex & 1) + slot) * so->rx_slot_size;
 }
 
 
@@ -0,0 +1,222 @@
+/***************************************************************
+ *
+ * (C) 2011-16 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PFQ_SHAPER_H
+#define PFQ_SHAPER_H
+
+#include <linux/kernel.h>
+#include <linux/if_ether.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/time.h>
+#include <linux/types.h>
+
+/*
+ * token bucket shaper of a socket Tx queue.
+ *
+ * Tokens are kept in nsec-scaled units, so that the refill is a single
+ * multiplication: a packet costs NSEC_PER_SEC packet tokens and
+ * 8 * len * NSEC_PER_SEC bit tokens, while each nanosecond adds pps (bps) tokens.
+ *
+ * The bucket is owned by the transmitting context: a new rate is published
+ * in conf (under lock) and applied by the transmitter at its next refill.
+ */
+
+struct pfq_tx_shaper_conf
+{
+	uint64_t	pps;
+	uint64_t	bps;
+	unsigned int	burst_pkts;
+	unsigned int	burst_bytes;
+};
+
+
+struct pfq_tx_shaper
+{
+	uint64_t	pps;		/* packets per second (0 = unlimited) */
+	uint64_t	bps;		/* bits per second (0 = unlimited) */
+
+	uint64_t	pkt_tokens;
+	uint64_t	pkt_depth;
+	uint64_t	bit_tokens;
+	uint64_t	bit_depth;
+
+	int64_t		last;		/* last refill (nsec) */
+	bool		throttled;	/* the head of the queue has been held */
+
+	spinlock_t	lock;		/* protects conf */
+	struct pfq_tx_shaper_conf conf;
+	bool		pending;	/* conf not applied yet */
+};
+
+
+static inline
+bool pfq_tx_shaper_enabled(struct pfq_tx_shaper const *sh)
+{
+	return sh->pps || sh->bps;
+}
+
+
+static inline
+void __pfq_tx_shaper_reset(struct pfq_tx_shaper *sh, struct pfq_tx_shaper_conf const *conf)
+{
+	sh->pps = conf->pps;
+	sh->bps = conf->bps;
+
+	/* burst_pkts < 2^31, burst_bytes < 2^30 (checked by the caller) */
+
+	sh->pkt_depth = (uint64_t)max_t(unsigned int, conf->burst_pkts, 1) * NSEC_PER_SEC;
+	sh->bit_depth = (uint64_t)max_t(unsigned int, conf->burst_bytes, ETH_FRAME_LEN) * 8 * NSEC_PER_SEC;
+
+	sh->pkt_tokens = sh->pkt_depth;
+	sh->bit_tokens = sh->bit_depth;
+
+	sh->last = 0;
+	sh->throttled = false;
+}
+
+
+/* unshaped bucket (the queue is not in use yet) */
+
+static inline
+void pfq_tx_shaper_init(struct pfq_tx_shaper *sh)
+{
+	memset(&sh->conf, 0, sizeof(sh->conf));
+	spin_lock_init(&sh->lock);
+	sh->pending = false;
+	__pfq_tx_shaper_reset(sh, &sh->conf);
+}
+
+
+/* publish a new rate (u-context), the transmitter picks it up */
+
+static inline
+void pfq_tx_shaper_set(struct pfq_tx_shaper *sh, uint64_t pps, uint64_t bps, unsigned int burst_pkts, unsigned int burst_bytes)
+{
+	spin_lock_bh(&sh->lock);
+	sh->conf.pps = pps;
+	sh->conf.bps = bps;
+	sh->conf.burst_pkts = burst_pkts;
+	sh->conf.burst_bytes = burst_bytes;
+	WRITE_ONCE(sh->pending, true);
+	spin_unlock_bh(&sh->lock);
+}
+
+
+/* apply the published rate, if any (transmitter) */
+
+static inline
+void pfq_tx_shaper_update(struct pfq_tx_shaper *sh)
+{
+	if (likely(!READ_ONCE(sh->pending)))
+		return;
+
+	spin_lock(&sh->lock);
+	__pfq_tx_shaper_reset(sh, &sh->conf);
+	sh->pending = false;
+	spin_unlock(&sh->lock);
+}
+
+
+static inline
+uint64_t __pfq_tx_shaper_fill(uint64_t tokens, uint64_t depth, uint64_t rate, int64_t delta)
+{
+	/* clamp delta to the time needed to fill the bucket (avoid overflow) */
+	uint64_t room = depth - tokens;
+	if ((uint64_t)delta >= div64_u64(room, rate) + 1)
+		return depth;
+	return tokens + (uint64_t)delta * rate;
+}
+
+
+static inline
+void pfq_tx_shaper_refill(struct pfq_tx_shaper *sh, int64_t now)
+{
+	int64_t delta = now - sh->last;
+
+	if (delta <= 0)
+		return;
+
+	if (sh->pps)
+		sh->pkt_tokens = __pfq_tx_shaper_fill(sh->pkt_tokens, sh->pkt_depth, sh->pps, delta);
+	if (sh->bps)
+		sh->bit_tokens = __pfq_tx_shaper_fill(sh->bit_tokens, sh->bit_depth, sh->bps, delta);
+
+	sh->last = now;
+}
+
+
+/*
+ * consume the tokens for npkts packets of len bytes, or return the time
+ * (nsec from now) when enough tokens will be available.
+ */
+
+static inline
+uint64_t __pfq_tx_shaper_cost(uint64_t units, uint64_t depth)
+{
+	/* costs larger than the bucket are clamped to its depth */
+	return units >= div64_u64(depth, NSEC_PER_SEC) ? depth : units * NSEC_PER_SEC;
+}
+
+
+/*
+ * return the time (nsec from the last refill) to wait for the tokens of
+ * npkts packets of len bytes, 0 if they conform.
+ */
+
+static inline
+int64_t pfq_tx_shaper_wait(struct pfq_tx_shaper const *sh, size_t len, unsigned int npkts)
+{
+	int64_t wait = 0;
+
+	if (sh->pps) {
+		uint64_t cost = __pfq_tx_shaper_cost((uint64_t)npkts, sh->pkt_depth);
+		if (sh->pkt_tokens < cost)
+			wait = max_t(int64_t, wait, div64_u64(cost - sh->pkt_tokens, sh->pps) + 1);
+	}
+
+	if (sh->bps) {
+		uint64_t cost = __pfq_tx_shaper_cost((uint64_t)npkts * len * 8, sh->bit_depth);
+		if (sh->bit_tokens < cost)
+			wait = max_t(int64_t, wait, div64_u64(cost - sh->bit_tokens, sh->bps) + 1);
+	}
+
+	return wait;
+}
+
+
+/* consume the tokens of conforming packets */
+
+static inline
+void pfq_tx_shaper_consume(struct pfq_tx_shaper *sh, size_t len, unsigned int npkts)
+{
+	if (sh->pps)
+		sh->pkt_tokens -= __pfq_tx_shaper_cost((uint64_t)npkts, sh->pkt_depth);
+	if (sh->bps)
+		sh->bit_tokens -= __pfq_tx_shaper_cost((uint64_t)npkts * len * 8, sh->bit_depth);
+}
+
+
+#endif /* PFQ_SHAPER_H */
@@ -310,7 +310,7 @@ pfq_shared_memory_free(struct pfq_shmem_descr *shmem)
 
 size_t pfq_total_queue_mem(struct pfq_sock *so)
 {
-        return sizeof(struct pfq_shared_queue) + pfq_mpsc_queue_mem(so) + pfq_spsc_queue_mem(so) * (1 + Q_MAX_TX_QUEUES);
+        return PFQ_SHARED_QUEUE_HDR_SIZE(so->txq_max_async) + pfq_mpsc_queue_mem(so) + pfq_spsc_queue_mem(so) * (1 + so->txq_max_async);
 }
 
 
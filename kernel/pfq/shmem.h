@@ -26,6 +26,7 @@
 
 #include <linux/vmalloc.h>
 #include <linux/net.h>
+#include <linux/mm.h>
 
 struct pfq_sock;
 
@@ -70,4 +71,13 @@ extern int    pfq_shared_memory_alloc(pfq_id_t, struct pfq_shmem_descr *shmem, u
 extern void   pfq_shared_memory_free(struct pfq_shmem_descr *shmem);
 
 
+/* page backing an address of the shared memory (vmalloc, vm_map_ram or 1G HugePage) */
+
+static inline
+struct page *pfq_shmem_page(const void *addr)
+{
+	return is_vmalloc_addr(addr) ? vmalloc_to_page(addr) : virt_to_page(addr);
+}
+
+
 #endif /* PFQ_SHMEM_H */
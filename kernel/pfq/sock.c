@@ -32,6 +32,8 @@
 #include <pfq/thread.h>
 
 #include <linux/pf_q.h>
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
 
 void
 pfq_sock_init_once(void)
@@ -64,6 +66,8 @@ void pfq_sock_destruct(struct sock *sk)
 	free_percpu(so->stats);
         so->stats = NULL;
 
+	pfq_sock_tx_queues_free(so);
+
         skb_queue_purge(&sk->sk_error_queue);
 
         WARN_ON(atomic_read(&sk->sk_rmem_alloc));
@@ -72,7 +76,7 @@ void pfq_sock_destruct(struct sock *sk)
         sk_refcnt_debug_dec(sk);
 }
 
-/* vector of pointers to pfq_sock */
+/* vector of pointers to pfq_sock (published and retired with RCU) */
 
 pfq_id_t
 pfq_sock_get_free_id(struct pfq_sock * so)
@@ -81,7 +85,7 @@ pfq_sock_get_free_id(struct pfq_sock * so)
 
         for(; n < (__force int)Q_MAX_ID; n++)
         {
-                if (atomic_long_cmpxchg(&global->socket_ptr[n], (long)0, (long)so) == 0) {
+                if (cmpxchg((struct pfq_sock __force **)&global->socket_ptr[n], NULL, so) == NULL) {
 			if(atomic_inc_return(&global->socket_count) == 1)
 				pfq_sock_init_once();
 			return (__force pfq_id_t)n;
@@ -105,7 +109,8 @@ pfq_sock_get_by_id(pfq_id_t id)
                 pr_devel("[PFQ] pfq_get_sock_by_id: bad id=%d!\n", id);
                 return NULL;
         }
-	return (struct pfq_sock *)atomic_long_read(&global->socket_ptr[(__force int)id]);
+	return rcu_dereference_check(global->socket_ptr[(__force int)id],
+				     lockdep_is_held(&global->socket_lock));
 }
 
 
@@ -117,16 +122,91 @@ void pfq_sock_release_id(pfq_id_t id)
                 return;
         }
 
-        atomic_long_set(global->socket_ptr + (__force int)id, 0);
+        RCU_INIT_POINTER(global->socket_ptr[(__force int)id], NULL);
+
+	/* wait for the Rx batches that may still see this socket */
+
+	synchronize_rcu();
 
         if (atomic_dec_return(&global->socket_count) == 0) {
 		pr_devel("[PFQ] calling sock_fini_once...\n");
-		msleep(Q_GRACE_PERIOD);
 		pfq_sock_fini_once();
 	}
 }
 
 
+/*
+ * Rx readiness: with batched wakeups the socket is readable when enough packets
+ * are pending or the oldest one has waited long enough (or the Rx queue is above
+ * the high watermark). Next is set to the time the first non-ready ring becomes
+ * due (U64_MAX if none).
+ */
+
+bool
+pfq_sock_rx_ready(struct pfq_sock *so, u64 now, u64 *next)
+{
+	struct pfq_shared_queue *q = pfq_sock_shared_queue(so);
+	size_t n, len, pending = 0;
+	unsigned long data;
+	bool ready = false;
+
+	if (next)
+		*next = U64_MAX;
+
+	if (!q)
+		return false;
+
+	for(n = 0; n < so->rx_ring_num; n++)
+	{
+		data = __atomic_load_n(&q->rx[n].shinfo, __ATOMIC_RELAXED);
+		len = PFQ_SHARED_QUEUE_LEN(data);
+		if (len == 0)
+			continue;
+
+		if ((so->rx_wakeup_pkts == 0 && so->rx_wakeup_ns == 0) ||
+		    (so->rx_watermark_level && len >= so->rx_watermark_level))
+			return true;
+
+		pending += so->rx_packed ? pfq_rx_wakeup_pending(&so->rx_wakeup[n], PFQ_SHARED_QUEUE_VER(data))
+					 : min(len, so->rx_queue_len);
+
+		if (so->rx_wakeup_ns) {
+			u64 due = so->rx_wakeup[n].first_ns + so->rx_wakeup_ns;
+			if (due <= now)
+				ready = true;
+			else if (next && due < *next)
+				*next = due;
+		}
+	}
+
+	return ready || (so->rx_wakeup_pkts && pending >= so->rx_wakeup_pkts);
+}
+
+
+/* armed by the producer that finds a Rx ring empty: wake up the consumer
+ * when the oldest pending packet is due, then follow the other rings.
+ * A producer may (re)start the timer while this runs: the next expiry is
+ * set with hrtimer_start, serialized with the producers, rather than by
+ * changing the expiry of a timer that may already be queued again. */
+
+static enum hrtimer_restart
+pfq_sock_rx_wakeup_timer(struct hrtimer *timer)
+{
+	struct pfq_sock *so = container_of(timer, struct pfq_sock, rx_wakeup_timer);
+	u64 next;
+
+	if (pfq_sock_rx_ready(so, ktime_to_ns(ktime_get()), &next) &&
+	    waitqueue_active(&so->waitqueue)) {
+		wake_up_interruptible(&so->waitqueue);
+	}
+
+	if (next != U64_MAX)
+		hrtimer_start(timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
+
+	return HRTIMER_NORESTART;
+}
+
+
 int pfq_sock_init(struct pfq_sock *so, pfq_id_t id, size_t caplen, size_t xmitlen)
 {
 	int i;
@@ -149,6 +229,10 @@ int pfq_sock_init(struct pfq_sock *so, pfq_id_t id, size_t caplen, size_t xmitle
 		local_set(&stat->fail, 0);
 		local_set(&stat->frwd, 0);
 		local_set(&stat->kern, 0);
+		local_set(&stat->timed, 0);
+		local_set(&stat->late, 0);
+		local_set(&stat->lateness, 0);
+		local_set(&stat->thrt, 0);
 	}
 
 	/* setup id */
@@ -174,7 +258,12 @@ int pfq_sock_init(struct pfq_sock *so, pfq_id_t id, size_t caplen, size_t xmitle
 
         /* disable tiemstamping by default */
 
-        so->tstamp = false;
+        so->tstamp = Q_TSTAMP_OFF;
+
+        /* zero-copy transmission is opt-in */
+
+	so->tx_zcopy = 0;
+	atomic_set(&so->tx_zcopy_inflight, 0);
 
         /* initialize waitqueue */
 
@@ -187,6 +276,26 @@ int pfq_sock_init(struct pfq_sock *so, pfq_id_t id, size_t caplen, size_t xmitle
         so->rx_len = caplen;
         so->rx_queue_len = 0;
         so->rx_slot_size  = PFQ_SHARED_QUEUE_SLOT_SIZE(caplen);
+	so->rx_ring_num = 1;
+	so->rx_packed = 0;
+
+	so->rx_hold = 0;
+	so->rx_hold_ns = 0;
+	so->rx_watermark = 0;
+	so->rx_watermark_level = 0;
+	so->tag = (uint32_t)atomic_inc_return(&global->socket_tag);
+
+	/* Rx wakeups: readable as soon as the queue is not empty */
+
+	so->rx_wakeup_pkts = 0;
+	so->rx_wakeup_ns = 0;
+	for(i = 0; i < Q_MAX_RX_RINGS; i++)
+	{
+		so->rx_wakeup[i].first_ns = 0;
+		atomic64_set(&so->rx_wakeup[i].pending, 0);
+	}
+	hrtimer_init(&so->rx_wakeup_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	so->rx_wakeup_timer.function = pfq_sock_rx_wakeup_timer;
 
 	/* Tx queues setup */
 
@@ -199,11 +308,72 @@ int pfq_sock_init(struct pfq_sock *so, pfq_id_t id, size_t caplen, size_t xmitle
 
 	/* Tx async queues setup */
 
-	for(i = 0; i < Q_MAX_TX_QUEUES; ++i)
+	so->txq_max_async = 0;
+	so->tx_async = NULL;
+	so->tx_state = NULL;
+
+	if (pfq_sock_tx_queues_alloc(so, Q_DEF_TX_QUEUES) < 0) {
+		free_percpu(so->stats);
+		so->stats = NULL;
+		return -ENOMEM;
+	}
+
+        return 0;
+}
+
+
+/*
+ * (re)allocate the state of the Tx queues: the number of async queues
+ * can only change while the socket is disabled and no queue is bound.
+ */
+
+int
+pfq_sock_tx_queues_alloc(struct pfq_sock *so, size_t num)
+{
+	struct pfq_queue_info *tx_async;
+	struct pfq_tx_queue_state *tx_state;
+	int i;
+
+	tx_async = kcalloc(max_t(size_t, num, 1), sizeof(struct pfq_queue_info), GFP_KERNEL);
+	if (!tx_async)
+		return -ENOMEM;
+
+	tx_state = kcalloc(1 + num, sizeof(struct pfq_tx_queue_state), GFP_KERNEL);
+	if (!tx_state) {
+		kfree(tx_async);
+		return -ENOMEM;
+	}
+
+	pfq_sock_tx_queues_free(so);
+
+	so->tx_async = tx_async;
+	so->tx_state = tx_state;
+	so->txq_max_async = num;
+
+	for(i = 0; i < (int)num; ++i)
 	{
 		pfq_queue_info_init(&so->tx_async[i]);
 	}
-        return 0;
+
+	/* Tx queues are not shaped by default */
+
+	for(i = -1; i < (int)num; ++i)
+	{
+		pfq_tx_shaper_init(pfq_sock_tx_shaper(so, i));
+	}
+
+	return 0;
+}
+
+
+void
+pfq_sock_tx_queues_free(struct pfq_sock *so)
+{
+	kfree(so->tx_async);
+	kfree(so->tx_state);
+	so->tx_async = NULL;
+	so->tx_state = NULL;
+	so->txq_max_async = 0;
 }
 
 
@@ -213,13 +383,14 @@ pfq_sock_tx_bind(struct pfq_sock *so, int tid, int ifindex, int qindex)
 	int queue = (int)so->txq_num_async;
 	int err = 0;
 
-	if (queue >= Q_MAX_TX_QUEUES) {
+	if (queue >= (int)so->txq_max_async) {
 		printk(KERN_INFO "[PFQ|%d] could not bind Tx[%d] thread to queue %d (out of range)!\n", so->id, tid, queue);
 		return -EPERM;
 	}
 
 	so->tx_async[queue].ifindex = ifindex;
 	so->tx_async[queue].queue = qindex;
+	so->tx_async[queue].tid = tid;
 	so->txq_num_async++;
 
 	smp_wmb();
@@ -228,6 +399,7 @@ pfq_sock_tx_bind(struct pfq_sock *so, int tid, int ifindex, int qindex)
 	{
 		so->tx_async[queue].ifindex = -1;
 		so->tx_async[queue].queue = -1;
+		so->tx_async[queue].tid = -1;
 		so->txq_num_async--;
 		return err;
 	}
@@ -249,10 +421,11 @@ pfq_sock_tx_unbind(struct pfq_sock *so)
 	if (pfq_unbind_tx_thread(so) < 0)
 		return -EPERM;
 
-	for(n = 0; n < Q_MAX_TX_QUEUES; ++n)
+	for(n = 0; n < so->txq_max_async; ++n)
 	{
 		so->tx_async[n].ifindex = -1;
 		so->tx_async[n].queue = -1;
+		so->tx_async[n].tid = -1;
 	}
 
 	return 0;
@@ -284,14 +457,113 @@ pfq_sock_enable(struct pfq_sock *so, struct pfq_so_enable *mem)
 }
 
 
+/*
+ * zero-copy Tx completion: invoked when the last reference to the
+ * data of a zero-copy skb is dropped (typically by the driver on Tx
+ * completion). It releases the queue half back to the producer.
+ */
+
+static void
+pfq_sock_tx_zcopy_callback(struct ubuf_info *ubuf, bool zerocopy)
+{
+	struct pfq_tx_zcopy *zc = container_of(ubuf, struct pfq_tx_zcopy, ubuf);
+
+	/* the socket waits for a grace period before unmapping the queue */
+
+	rcu_read_lock();
+	__atomic_sub_fetch((unsigned int *)READ_ONCE(ubuf->ctx), 1, __ATOMIC_RELEASE);
+	atomic_dec(READ_ONCE(zc->inflight));
+	rcu_read_unlock();
+}
+
+
+void
+pfq_sock_tx_zcopy_init(struct pfq_sock *so, struct pfq_shared_queue *sq)
+{
+	int n, h;
+
+	for(n = -1; n < (int)so->txq_max_async; n++)
+	{
+		struct pfq_shared_tx_queue *tx_queue = n == -1 ? &sq->tx : &sq->tx_async[n];
+
+		for(h = 0; h < 2; h++)
+		{
+			struct pfq_tx_zcopy *zc = pfq_sock_tx_zcopy(so, n, h);
+
+			tx_queue->zcopy.pending[h] = 0;
+
+			zc->inflight = &so->tx_zcopy_inflight;
+			zc->ubuf.callback = pfq_sock_tx_zcopy_callback;
+			zc->ubuf.ctx = &tx_queue->zcopy.pending[h];
+			zc->ubuf.desc = (unsigned long)h;
+		}
+	}
+}
+
+
+/*
+ * a driver that does not complete its zero-copy packets within the timeout:
+ * the state of the Tx queues is replaced by a copy and the old one is leaked,
+ * with its completions redirected to its own counters. The callbacks running
+ * (within a RCU read-side section) are waited for by the synchronize_rcu()
+ * that follows and precedes the unmap.
+ */
+
+static bool
+pfq_sock_tx_zcopy_orphan(struct pfq_sock *so)
+{
+	struct pfq_tx_queue_state *tx_state;
+	int n, h;
+
+	tx_state = kmemdup(so->tx_state, (1 + so->txq_max_async) * sizeof(struct pfq_tx_queue_state), GFP_KERNEL);
+	if (!tx_state)
+		return false;
+
+	for(n = -1; n < (int)so->txq_max_async; n++)
+	{
+		for(h = 0; h < 2; h++)
+		{
+			struct pfq_tx_zcopy *zc = pfq_sock_tx_zcopy(so, n, h);
+
+			WRITE_ONCE(zc->ubuf.ctx, &zc->orphan_pending);
+			WRITE_ONCE(zc->inflight, &zc->orphan_inflight);
+		}
+	}
+
+	so->tx_state = tx_state;
+	atomic_set(&so->tx_zcopy_inflight, 0);
+	return true;
+}
+
+
+void
+pfq_sock_tx_zcopy_wait(struct pfq_sock *so)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(Q_TX_ZCOPY_TIMEOUT);
+	int n = 0;
+
+	while (atomic_read(&so->tx_zcopy_inflight) > 0)
+	{
+		if (time_after(jiffies, timeout) && pfq_sock_tx_zcopy_orphan(so)) {
+			printk(KERN_WARNING "[PFQ|%d] zero-copy packets not completed within %d msec: Tx state leaked!\n",
+			       so->id, Q_TX_ZCOPY_TIMEOUT);
+			return;
+		}
+
+		if ((n++ % 10) == 0)
+			printk(KERN_INFO "[PFQ|%d] waiting for %d zero-copy packets to complete...\n",
+			       so->id, atomic_read(&so->tx_zcopy_inflight));
+		msleep(Q_GRACE_PERIOD);
+	}
+}
+
+
 int
 pfq_sock_disable(struct pfq_sock *so)
 {
 	pr_devel("[PFQ|%d] leaving all groups...\n", so->id);
 	pfq_group_leave_all(so->id);
 
-	msleep(Q_GRACE_PERIOD);
-
 	if (atomic_long_read(&so->shmem_addr)) {
 
 		/* unbind Tx threads */
@@ -299,12 +571,21 @@ pfq_sock_disable(struct pfq_sock *so)
 		pr_devel("[PFQ|%d] unbinding Tx threads...\n", so->id);
 		pfq_sock_tx_unbind(so);
 
-		msleep(Q_GRACE_PERIOD);
+		/* wait for the drivers to release the zero-copy packets (or orphan
+		 * them): the callbacks still running end within the grace period below */
+
+		pfq_sock_tx_zcopy_wait(so);
 
 		pr_devel("[PFQ|%d] disabling shared queue...\n", so->id);
 		atomic_long_set(&so->shmem_addr, 0);
 
-		msleep(Q_GRACE_PERIOD);
+		/* the Rx path copies into the queue within an RCU read-side section */
+
+		synchronize_rcu();
+
+		/* producers no longer arm the wakeup timer: stop it before the unmap */
+
+		hrtimer_cancel(&so->rx_wakeup_timer);
 
 		pr_devel("[PFQ|%d] unmapping shared queue...\n", so->id);
 		pfq_shared_queue_unmap(so);
@@ -29,6 +29,7 @@
 #include <pfq/endpoint.h>
 #include <pfq/kcompat.h>
 #include <pfq/pool.h>
+#include <pfq/shaper.h>
 #include <pfq/shmem.h>
 #include <pfq/sock.h>
 #include <pfq/stats.h>
@@ -36,9 +37,11 @@
 #include <pfq/types.h>
 
 #include <linux/wait.h>
+#include <linux/hrtimer.h>
 
 #ifdef __KERNEL__
 #include <net/sock.h>
+#include <linux/skbuff.h>
 #endif
 
 
@@ -53,6 +56,7 @@ struct pfq_queue_info
 {
 	int	ifindex;
 	int	queue;
+	int	tid;		/* Tx thread (async queues) */
 };
 
 
@@ -61,6 +65,51 @@ void pfq_queue_info_init(struct pfq_queue_info *info)
 {
 	info->ifindex = -1;
 	info->queue = -1;
+	info->tid = -1;
+}
+
+
+/* zero-copy Tx completion: one per half of each shared Tx queue */
+
+struct pfq_tx_zcopy
+{
+	struct ubuf_info	ubuf;		/* ctx: shared completion counter */
+	atomic_t		*inflight;	/* zero-copy packets of the socket */
+
+	unsigned int		orphan_pending;	/* counters of the completions late after close */
+	atomic_t		orphan_inflight;
+};
+
+
+/* per Tx queue state (the sync queue first, then the async ones) */
+
+struct pfq_tx_queue_state
+{
+	struct pfq_tx_zcopy	zcopy[2];
+	struct pfq_tx_shaper	shaper;
+};
+
+
+/* batched Rx wakeups: state of a Rx ring since its last swap (slot queues
+ * count the pending packets from the queue length) */
+
+struct pfq_rx_wakeup_state
+{
+	u64			first_ns;	/* arrival of the first pending packet */
+	atomic64_t		pending;	/* packed queues: (ring version << 32) | packets */
+};
+
+
+#define PFQ_RX_WAKEUP_PENDING(ver, pkts)	(((u64)(ver) << 32) | (u32)(pkts))
+
+
+/* packets pending in a packed ring of the given version */
+
+static inline
+u32 pfq_rx_wakeup_pending(struct pfq_rx_wakeup_state *state, pfq_qver_t ver)
+{
+	u64 pending = (u64)atomic64_read(&state->pending);
+	return (u32)(pending >> 32) == (u32)ver ? (u32)pending : 0;
 }
 
 
@@ -73,22 +122,37 @@ struct pfq_sock
         int			egress_index;
         int			egress_queue;
 	int			weight;
-	int			tstamp;
+	int			tstamp;			/* Rx timestamp source (Q_TSTAMP_*) */
+	int			tx_zcopy;
 
 	size_t			rx_len;
 	size_t			tx_len;
 
-	size_t			rx_queue_len;
+	size_t			rx_queue_len;		/* slots of each Rx ring */
 	size_t			rx_slot_size;
+	size_t			rx_ring_num;		/* Rx sub-rings (by producing cpu) */
+	int			rx_packed;		/* variable-length Rx slots */
+
+	int			rx_hold;		/* lossless: hold packets on full Rx queue */
+	u64			rx_hold_ns;
+	unsigned int		rx_watermark;		/* high-watermark wakeup (percent of the Rx queue) */
+	size_t			rx_watermark_level;	/* ...in slots (bytes for packed queues), 0 = off */
+	uint32_t		tag;			/* unique tag of this socket instance */
+
+	unsigned int		rx_wakeup_pkts;		/* readable with packets pending (0 = off) */
+	u64			rx_wakeup_ns;		/* readable after the first packet waited (0 = off) */
+	struct hrtimer		rx_wakeup_timer;
+	struct pfq_rx_wakeup_state rx_wakeup[Q_MAX_RX_RINGS];
 
 	size_t			tx_queue_len;
 	size_t			tx_slot_size;
 
 	wait_queue_head_t	waitqueue;
 
-        size_t			txq_num_async;
+        size_t			txq_num_async;		/* async queues bound to Tx threads */
+        size_t			txq_max_async;		/* async queues mapped in the shared memory */
 
-	struct pfq_queue_info	tx_async[Q_MAX_TX_QUEUES];
+	struct pfq_queue_info	*tx_async;		/* [txq_max_async] */
 	struct pfq_queue_info	tx;
 	struct pfq_queue_info	rx;
 
@@ -96,6 +160,10 @@ struct pfq_sock
 
 	atomic_long_t		shmem_addr;
 
+	atomic_t		tx_zcopy_inflight;
+
+	struct pfq_tx_queue_state *tx_state;		/* [1 + txq_max_async] */
+
         pfq_sock_stats_t __percpu *stats;
 
 } ____pfq_cacheline_aligned;
@@ -132,12 +200,12 @@ pfq_sock_shared_queue(struct pfq_sock *so)
 
 static inline
 struct pfq_shared_rx_queue *
-pfq_sock_rx_shared_queue(struct pfq_sock *so)
+pfq_sock_rx_shared_queue(struct pfq_sock *so, int ring)
 {
 	struct pfq_shared_queue *sq = pfq_sock_shared_queue(so);
 	if (unlikely(sq == NULL))
 		return NULL;
-	return &sq->rx;
+	return &sq->rx[ring];
 }
 
 
@@ -154,6 +222,26 @@ pfq_sock_tx_shared_queue(struct pfq_sock *so, int index)
 }
 
 
+/* zero-copy Tx completion of a queue half (index -1 is the sync queue) */
+
+static inline
+struct pfq_tx_zcopy *
+pfq_sock_tx_zcopy(struct pfq_sock *so, int index, unsigned int half)
+{
+	return &so->tx_state[index + 1].zcopy[half & 1];
+}
+
+
+/* token bucket of a Tx queue (index -1 is the sync queue) */
+
+static inline
+struct pfq_tx_shaper *
+pfq_sock_tx_shaper(struct pfq_sock *so, int index)
+{
+	return &so->tx_state[index + 1].shaper;
+}
+
+
 extern void     pfq_sock_init_once(void);
 extern void     pfq_sock_fini_once(void);
 extern void     pfq_sock_init_waitqueue_head(wait_queue_head_t *queue);
@@ -166,9 +254,16 @@ extern int	pfq_sock_counter(void);
 extern void	pfq_sock_release_id(pfq_id_t id);
 extern int	pfq_sock_tx_bind(struct pfq_sock *so, int tid, int if_index, int queue);
 extern int	pfq_sock_tx_unbind(struct pfq_sock *so);
+extern int	pfq_sock_tx_queues_alloc(struct pfq_sock *so, size_t num);
+extern void	pfq_sock_tx_queues_free(struct pfq_sock *so);
 
 extern int	pfq_sock_enable(struct pfq_sock *so, struct pfq_so_enable *mem);
 extern int	pfq_sock_disable(struct pfq_sock *so);
 
+extern void	pfq_sock_tx_zcopy_init(struct pfq_sock *so, struct pfq_shared_queue *sq);
+extern void	pfq_sock_tx_zcopy_wait(struct pfq_sock *so);
+
+extern bool	pfq_sock_rx_ready(struct pfq_sock *so, u64 now, u64 *next);
+
 
 #endif /* PFQ_SOCK_H */
@@ -164,6 +164,67 @@ int pfq_getsockopt(struct socket *sock,
                         return -EFAULT;
         } break;
 
+        case Q_SO_GET_TX_ZCOPY:
+        {
+                if (len != sizeof(so->tx_zcopy))
+                        return -EINVAL;
+                if (copy_to_user(optval, &so->tx_zcopy, sizeof(so->tx_zcopy)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_TX_QUEUES:
+        {
+                if (len != sizeof(so->txq_max_async))
+                        return -EINVAL;
+                if (copy_to_user(optval, &so->txq_max_async, sizeof(so->txq_max_async)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_RX_RINGS:
+        {
+                if (len != sizeof(so->rx_ring_num))
+                        return -EINVAL;
+                if (copy_to_user(optval, &so->rx_ring_num, sizeof(so->rx_ring_num)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_RX_PACKED:
+        {
+                if (len != sizeof(so->rx_packed))
+                        return -EINVAL;
+                if (copy_to_user(optval, &so->rx_packed, sizeof(so->rx_packed)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_RX_BACKPRESSURE:
+        {
+		struct pfq_so_rx_backpressure bp;
+
+                if (len != sizeof(bp))
+                        return -EINVAL;
+
+		bp.hold = so->rx_hold;
+		bp.hold_usec = (unsigned int)div_u64(so->rx_hold_ns, NSEC_PER_USEC);
+		bp.watermark = so->rx_watermark;
+
+                if (copy_to_user(optval, &bp, sizeof(bp)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_RX_WAKEUP:
+        {
+		struct pfq_so_rx_wakeup wk;
+
+                if (len != sizeof(wk))
+                        return -EINVAL;
+
+		wk.packets = so->rx_wakeup_pkts;
+		wk.usec = (unsigned int)div_u64(so->rx_wakeup_ns, NSEC_PER_USEC);
+
+                if (copy_to_user(optval, &wk, sizeof(wk)))
+                        return -EFAULT;
+        } break;
+
         case Q_SO_GET_SHMEM_SIZE:
 	{
 		size_t size = pfq_total_queue_mem_aligned(so);
@@ -359,6 +420,7 @@ int pfq_setsockopt(struct socket *sock,
         {
                 struct pfq_so_binding bind;
 		pfq_gid_t gid;
+		int err;
 
                 if (optlen != sizeof(bind))
                         return -EINVAL;
@@ -385,7 +447,11 @@ int pfq_setsockopt(struct socket *sock,
                         return -EACCES;
                 }
 
-                pfq_devmap_update(Q_DEVMAP_SET, bind.ifindex, bind.qindex, gid);
+                err = pfq_devmap_update(Q_DEVMAP_SET, bind.ifindex, bind.qindex, gid);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] bind: could not bind ifindex=%d qindex=%d (%d)!\n", so->id, bind.ifindex, bind.qindex, err);
+                        return err;
+                }
 
                 pr_devel("[PFQ|%d] group id=%d bind: device ifindex=%d qindex=%d\n",
 					so->id, bind.gid, bind.ifindex, bind.qindex);
@@ -396,6 +462,7 @@ int pfq_setsockopt(struct socket *sock,
         {
                 struct pfq_so_binding bind;
 		pfq_gid_t gid;
+		int err;
 
                 if (optlen != sizeof(bind))
                         return -EINVAL;
@@ -417,7 +484,11 @@ int pfq_setsockopt(struct socket *sock,
 		}
 #endif
 
-                pfq_devmap_update(Q_DEVMAP_RESET, bind.ifindex, bind.qindex, gid);
+                err = pfq_devmap_update(Q_DEVMAP_RESET, bind.ifindex, bind.qindex, gid);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] unbind: could not unbind ifindex=%d qindex=%d (%d)!\n", so->id, bind.ifindex, bind.qindex, err);
+                        return err;
+                }
 
                 pr_devel("[PFQ|%d] group id=%d unbind: device ifindex=%d qindex=%d\n",
 					so->id, gid, bind.ifindex, bind.qindex);
@@ -471,10 +542,28 @@ int pfq_setsockopt(struct socket *sock,
                 if (copy_from_user(&tstamp, optval, optlen))
                         return -EFAULT;
 
-                tstamp = tstamp ? 1 : 0;
+                if (tstamp < Q_TSTAMP_OFF || tstamp > Q_TSTAMP_HW_SYS) {
+                        printk(KERN_INFO "[PFQ|%d] timestamp: invalid source=%d!\n", so->id, tstamp);
+                        return -EINVAL;
+                }
+
                 so->tstamp = tstamp;
 
-                pr_devel("[PFQ|%d] timestamp enabled.\n", so->id);
+                pr_devel("[PFQ|%d] timestamp source=%d.\n", so->id, tstamp);
+        } break;
+
+        case Q_SO_SET_TX_ZCOPY:
+        {
+                int zcopy;
+                if (optlen != sizeof(so->tx_zcopy))
+                        return -EINVAL;
+
+                if (copy_from_user(&zcopy, optval, optlen))
+                        return -EFAULT;
+
+                so->tx_zcopy = zcopy ? 1 : 0;
+
+                pr_devel("[PFQ|%d] zero-copy Tx %s.\n", so->id, so->tx_zcopy ? "enabled" : "disabled");
         } break;
 
         case Q_SO_SET_RX_LEN:
@@ -583,10 +672,9 @@ int pfq_setsockopt(struct socket *sock,
 
                 so->weight = weight;
 
-		/* invalidate per-cpu sock mask cache
-                 *
-		 * pfq_invalidate_percpu_eligible_mask(so->id);
-                 */
+		/* rebuild the steering tables of the joined groups */
+
+		pfq_group_update_steering(so->id);
 
                 pr_devel("[PFQ|%d] new weight set to %d.\n", so->id, weight);
 
@@ -665,6 +753,45 @@ int pfq_setsockopt(struct socket *sock,
 
         } break;
 
+        case Q_SO_GROUP_EBPF:
+        {
+                struct pfq_so_ebpf ebpf;
+                struct bpf_prog *prog = NULL;
+		pfq_gid_t gid;
+
+                if (optlen != sizeof(ebpf))
+                        return -EINVAL;
+
+                if (copy_from_user(&ebpf, optval, optlen))
+                        return -EFAULT;
+
+		gid = (__force pfq_gid_t)ebpf.gid;
+
+		if (!pfq_group_has_joined(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] eBPF: gid=%d not joined!\n", so->id, ebpf.gid);
+			return -EACCES;
+		}
+
+		if (ebpf.mode < Q_EBPF_FILTER || ebpf.mode > Q_EBPF_CLASS) {
+                        printk(KERN_INFO "[PFQ|%d] eBPF: invalid mode=%d!\n", so->id, ebpf.mode);
+			return -EINVAL;
+		}
+
+                if (ebpf.fd >= 0) {
+                        prog = pfq_get_ebpf_prog(ebpf.fd);
+                        if (IS_ERR(prog)) {
+                                printk(KERN_INFO "[PFQ|%d] eBPF error: fd=%d is not a socket filter program (%ld)\n",
+                                       so->id, ebpf.fd, PTR_ERR(prog));
+                                return PTR_ERR(prog);
+                        }
+                }
+
+                pr_devel("[PFQ|%d] eBPF: gid=%d fd=%d mode=%d\n", so->id, ebpf.gid, ebpf.fd, ebpf.mode);
+
+                return pfq_group_set_ebpf(gid, prog, ebpf.mode);
+
+        } break;
+
         case Q_SO_GROUP_VLAN_FILT_TOGGLE:
         {
                 struct pfq_so_vlan_toggle vlan;
@@ -683,7 +810,8 @@ int pfq_setsockopt(struct socket *sock,
 			return -EACCES;
 		}
 
-                pfq_group_toggle_vlan_filters(gid, vlan.toggle);
+                if (!pfq_group_toggle_vlan_filters(gid, vlan.toggle))
+                        return -ENOMEM;
                 pr_devel("[PFQ|%d] vlan filters %s for gid=%d\n",
 			 so->id, (vlan.toggle ? "enabled" : "disabled"), vlan.gid);
 
@@ -693,6 +821,7 @@ int pfq_setsockopt(struct socket *sock,
         {
                 struct pfq_so_vlan_toggle filt;
                 pfq_gid_t gid;
+                int err;
 
                 if (optlen != sizeof(filt))
                         return -EINVAL;
@@ -719,16 +848,11 @@ int pfq_setsockopt(struct socket *sock,
                         return -EPERM;
                 }
 
-                if (filt.vid  == -1) { /* any */
-                        int i;
-                        for(i = 1; i < 4095; i++)
-			{
-                                pfq_group_set_vlan_filter(gid, filt.toggle, i);
-			}
-                }
-                else  {
-                        pfq_group_set_vlan_filter(gid, filt.toggle, filt.vid);
-		}
+                /* vid -1: any */
+
+                err = pfq_group_set_vlan_filter(gid, filt.toggle, filt.vid);
+                if (err < 0)
+                        return err;
 
                 pr_devel("[PFQ|%d] vlan filter vid %d set for gid=%d\n", so->id, filt.vid, filt.gid);
         } break;
@@ -749,7 +873,7 @@ int pfq_setsockopt(struct socket *sock,
 		}
 
 		if (bind.tid >= 0 &&
-		    so->txq_num_async >= Q_MAX_TX_QUEUES) {
+		    so->txq_num_async >= so->txq_max_async) {
 			printk(KERN_INFO "[PFQ|%d] Tx thread: max number of sock queues exceeded!\n", so->id);
 			return -EPERM;
 		}
@@ -793,6 +917,168 @@ int pfq_setsockopt(struct socket *sock,
 		pfq_sock_tx_unbind(so);
         } break;
 
+        case Q_SO_TX_RATE:
+        {
+                struct pfq_so_tx_rate rate;
+
+                if (optlen != sizeof(rate))
+                        return -EINVAL;
+
+                if (copy_from_user(&rate, optval, optlen))
+                        return -EFAULT;
+
+		if (rate.queue < -1 || rate.queue >= (int)so->txq_max_async) {
+			printk(KERN_INFO "[PFQ|%d] Tx rate: invalid queue (%d)!\n", so->id, rate.queue);
+			return -EINVAL;
+		}
+
+		if (rate.burst_pkts >= (1U << 31) || rate.burst_bytes >= (1U << 30)) {
+			printk(KERN_INFO "[PFQ|%d] Tx rate: burst too large!\n", so->id);
+			return -EINVAL;
+		}
+
+		pfq_tx_shaper_set(pfq_sock_tx_shaper(so, rate.queue), rate.pps, rate.bps, rate.burst_pkts, rate.burst_bytes);
+
+		pr_devel("[PFQ|%d] Tx[%d] rate: pps=%lu bps=%lu burst=%u pkts/%u bytes\n", so->id, rate.queue,
+			 rate.pps, rate.bps, rate.burst_pkts, rate.burst_bytes);
+        } break;
+
+        case Q_SO_SET_TX_QUEUES:
+        {
+                typeof(so->txq_max_async) num;
+                int err;
+
+                if (optlen != sizeof(num))
+                        return -EINVAL;
+                if (copy_from_user(&num, optval, optlen))
+                        return -EFAULT;
+
+                if (num > Q_MAX_TX_QUEUES) {
+                        printk(KERN_INFO "[PFQ|%d] invalid number of Tx queues=%zu (max %d)\n",
+                               so->id, num, Q_MAX_TX_QUEUES);
+                        return -EPERM;
+                }
+
+		if (pfq_sock_shared_queue(so) != NULL || so->txq_num_async) {
+			printk(KERN_INFO "[PFQ|%d] Tx queues: socket enabled or Tx queues bound!\n", so->id);
+			return -EBUSY;
+		}
+
+		if (num != so->txq_max_async) {
+			err = pfq_sock_tx_queues_alloc(so, num);
+			if (err < 0)
+				return err;
+		}
+
+                pr_devel("[PFQ|%d] Tx async queues: %zu\n", so->id, so->txq_max_async);
+        } break;
+
+        case Q_SO_SET_RX_RINGS:
+        {
+                typeof(so->rx_ring_num) num;
+
+                if (optlen != sizeof(num))
+                        return -EINVAL;
+                if (copy_from_user(&num, optval, optlen))
+                        return -EFAULT;
+
+                if (num == 0 || num > Q_MAX_RX_RINGS) {
+                        printk(KERN_INFO "[PFQ|%d] invalid number of Rx rings=%zu (max %d)\n",
+                               so->id, num, Q_MAX_RX_RINGS);
+                        return -EPERM;
+                }
+
+		if (pfq_sock_shared_queue(so) != NULL) {
+			printk(KERN_INFO "[PFQ|%d] Rx rings: socket enabled!\n", so->id);
+			return -EBUSY;
+		}
+
+		so->rx_ring_num = num;
+
+                pr_devel("[PFQ|%d] Rx rings: %zu\n", so->id, so->rx_ring_num);
+        } break;
+
+        case Q_SO_SET_RX_PACKED:
+        {
+                int packed;
+
+                if (optlen != sizeof(packed))
+                        return -EINVAL;
+                if (copy_from_user(&packed, optval, optlen))
+                        return -EFAULT;
+
+		if (pfq_sock_shared_queue(so) != NULL) {
+			printk(KERN_INFO "[PFQ|%d] Rx packed: socket enabled!\n", so->id);
+			return -EBUSY;
+		}
+
+		so->rx_packed = packed ? 1 : 0;
+
+                pr_devel("[PFQ|%d] Rx packed slots: %s\n", so->id, so->rx_packed ? "on" : "off");
+        } break;
+
+        case Q_SO_SET_RX_BACKPRESSURE:
+        {
+		struct pfq_so_rx_backpressure bp;
+
+                if (optlen != sizeof(bp))
+                        return -EINVAL;
+                if (copy_from_user(&bp, optval, optlen))
+                        return -EFAULT;
+
+		if (bp.watermark > 100) {
+			printk(KERN_INFO "[PFQ|%d] Rx back-pressure: invalid watermark=%u%%\n", so->id, bp.watermark);
+			return -EINVAL;
+		}
+
+		if (bp.hold_usec > Q_RX_HOLD_MAX_USEC) {
+			printk(KERN_INFO "[PFQ|%d] Rx back-pressure: invalid hold=%u usec (max %u)\n", so->id, bp.hold_usec, Q_RX_HOLD_MAX_USEC);
+			return -EINVAL;
+		}
+
+		so->rx_hold_ns = (u64)bp.hold_usec * NSEC_PER_USEC;
+		so->rx_watermark = bp.watermark;
+		if (pfq_sock_shared_queue(so) != NULL)
+			so->rx_watermark_level = pfq_mpsc_watermark_level(so);
+
+		smp_wmb();
+		so->rx_hold = bp.hold ? 1 : 0;
+
+                pr_devel("[PFQ|%d] Rx back-pressure: hold=%d (%u usec) watermark=%u%%\n",
+			 so->id, so->rx_hold, bp.hold_usec, so->rx_watermark);
+        } break;
+
+        case Q_SO_SET_RX_WAKEUP:
+        {
+		struct pfq_shared_queue *sq = pfq_sock_shared_queue(so);
+		struct pfq_so_rx_wakeup wk;
+		unsigned long data;
+		size_t n;
+
+                if (optlen != sizeof(wk))
+                        return -EINVAL;
+                if (copy_from_user(&wk, optval, optlen))
+                        return -EFAULT;
+
+		/* batches are timed from the next empty Rx ring: packets already pending
+		 * are due at once (packed rings, counted only while wakeups are on, are
+		 * also readable at once) */
+
+		for(n = 0; n < Q_MAX_RX_RINGS; n++)
+		{
+			data = sq && n < so->rx_ring_num ? __atomic_load_n(&sq->rx[n].shinfo, __ATOMIC_RELAXED) : 0;
+			so->rx_wakeup[n].first_ns = 0;
+			atomic64_set(&so->rx_wakeup[n].pending, (s64)PFQ_RX_WAKEUP_PENDING(PFQ_SHARED_QUEUE_VER(data), wk.packets));
+		}
+
+		smp_wmb();
+
+		so->rx_wakeup_pkts = wk.packets;
+		so->rx_wakeup_ns = (u64)wk.usec * NSEC_PER_USEC;
+
+                pr_devel("[PFQ|%d] Rx wakeup: packets=%u usec=%u\n", so->id, wk.packets, wk.usec);
+        } break;
+
         case Q_SO_TX_QUEUE_XMIT:
         {
 		int queue;
@@ -810,7 +1096,7 @@ int pfq_setsockopt(struct socket *sock,
 
 		if (queue == 0) { /* transmit Tx queue */
 
-			tx_response_t tx = pfq_sk_queue_xmit(so, -1, Q_NO_KTHREAD);
+			tx_response_t tx = pfq_sk_queue_xmit(so, -1, Q_NO_KTHREAD, NULL, 0);
 
 			sparse_add(so->stats, sent, tx.ok);
 			sparse_add(so->stats, fail, tx.fail);
@@ -820,6 +1106,11 @@ int pfq_setsockopt(struct socket *sock,
 			return 0;
 		}
 
+		if (queue > 0 && queue <= (int)so->txq_num_async) { /* kick the Tx thread of an async queue */
+
+			return pfq_wakeup_tx_thread(so->tx_async[queue-1].tid);
+		}
+
 		printk(KERN_INFO "[PFQ|%d] Tx queue: bad queue %d!\n", so->id, queue);
 		return -EPERM;
 
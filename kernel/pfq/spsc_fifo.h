@@ -26,6 +26,7 @@
 
 #ifdef __KERNEL__
 #include <linux/slab.h>
+#include <linux/topology.h>
 #include <pfq/alloc.h>
 #else
 #include <stdlib.h>
@@ -214,12 +215,70 @@ void pfq_spsc_consume(struct pfq_spsc_fifo *fifo)
 
 
 
+/* bulk operations: the indexes are read and published once per call */
+
+static inline
+size_t pfq_spsc_peek_bulk(struct pfq_spsc_fifo *fifo, void **ptrs, size_t n)
+{
+        size_t w = fifo->consumer.head_cache;
+        size_t r = __atomic_load_n(&fifo->tail, __ATOMIC_RELAXED);
+        size_t avail = pfq_spsc_distance(fifo, w, r), i;
+
+	if (avail < n) {
+		w = fifo->consumer.head_cache = __atomic_load_n(&fifo->head, __ATOMIC_ACQUIRE);
+		avail = pfq_spsc_distance(fifo, w, r);
+		if (avail < n)
+			n = avail;
+	}
+
+	for(i = 0; i < n; i++) {
+		ptrs[i] = fifo->ring[r];
+		r = pfq_spsc_next_index(fifo, r);
+	}
+
+	return n;
+}
+
+
+static inline
+void pfq_spsc_consume_bulk(struct pfq_spsc_fifo *fifo, size_t n)
+{
+	size_t next = fifo->tail + n;
+	if (next >= fifo->size)
+		next -= fifo->size;
+	__atomic_store_n(&fifo->tail, next, __ATOMIC_RELEASE);
+}
+
+
+static inline
+size_t pfq_spsc_push_bulk(struct pfq_spsc_fifo *fifo, void **ptrs, size_t n)
+{
+        size_t w = __atomic_load_n(&fifo->head, __ATOMIC_RELAXED);
+        size_t r = fifo->producer.tail_cache;
+        size_t room = fifo->size - 1 - pfq_spsc_distance(fifo, w, r), i;
+
+	if (room < n) {
+		r = fifo->producer.tail_cache = __atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE);
+		room = fifo->size - 1 - pfq_spsc_distance(fifo, w, r);
+		if (room < n)
+			n = room;
+	}
+
+	for(i = 0; i < n; i++) {
+		fifo->ring[w] = ptrs[i];
+		w = pfq_spsc_next_index(fifo, w);
+	}
+
+	__atomic_store_n(&fifo->head, w, __ATOMIC_RELEASE);
+	return n;
+}
+
 static inline
 struct pfq_spsc_fifo *
 pfq_spsc_init(size_t size, int cpu)
 {
 	struct pfq_spsc_fifo *fifo = (struct pfq_spsc_fifo *)
-		pfq_malloc_pages(sizeof(struct pfq_spsc_fifo) + sizeof(void *)*(size+1), GFP_KERNEL);
+		pfq_malloc_pages_node(sizeof(struct pfq_spsc_fifo) + sizeof(void *)*(size+1), GFP_KERNEL, cpu_to_node(cpu));
 	if (fifo != NULL)
 	{
 		fifo->size = size+1;
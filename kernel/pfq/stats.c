@@ -37,6 +37,12 @@ void pfq_kernel_stats_read(struct pfq_kernel_stats __percpu *kstats, struct pfq_
 
 	stats->frwd = (long unsigned)sparse_read(kstats, frwd);
 	stats->kern = (long unsigned)sparse_read(kstats, kern);
+
+	stats->timed    = (long unsigned)sparse_read(kstats, timed);
+	stats->late     = (long unsigned)sparse_read(kstats, late);
+	stats->lateness = (long unsigned)sparse_read(kstats, lateness);
+
+	stats->thrt = (long unsigned)sparse_read(kstats, thrt);
 }
 
 
@@ -55,6 +61,10 @@ void pfq_kernel_stats_reset(struct pfq_kernel_stats __percpu *stats)
 		local_set(&stat->fail, 0);
 		local_set(&stat->frwd, 0);
 		local_set(&stat->kern, 0);
+		local_set(&stat->timed, 0);
+		local_set(&stat->late, 0);
+		local_set(&stat->lateness, 0);
+		local_set(&stat->thrt, 0);
 	}
 }
 
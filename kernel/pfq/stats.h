@@ -42,6 +42,10 @@ struct pfq_kernel_stats
         local_t fail;		/* Tx failed due to hardware congestion */
         local_t frwd;		/* forwarded to devices */
         local_t kern;		/* passed to kernel */
+        local_t timed;		/* sent at their timestamp */
+        local_t late;		/* timed packets sent behind schedule */
+        local_t lateness;	/* total lateness of timed packets (nsec) */
+        local_t thrt;		/* packets delayed by the Tx token bucket */
 };
 
 
@@ -0,0 +1,145 @@
+/***************************************************************
+ *
+ * (C) 2011-16 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pfq/bitops.h>
+#include <pfq/sock.h>
+#include <pfq/steer.h>
+
+#include <linux/jhash.h>
+#include <linux/slab.h>
+
+
+#define PFQ_STEER_SEED_OFFSET	0x2545f491
+#define PFQ_STEER_SEED_SKIP	0x9e3779b9
+
+
+/*
+ * Maglev population: every socket walks its own permutation of the table
+ * (offset + k * skip, skip is odd and the table length a power of two) and
+ * claims the next free entry, as many times per round as its weight.
+ * Permutations only depend on the socket id, so that rebuilding the table
+ * for a slightly different set of sockets leaves most of the entries unchanged.
+ */
+
+struct pfq_steer_backend
+{
+	uint32_t	offset;
+	uint32_t	skip;
+	uint32_t	next;
+	int		weight;
+	int		id;
+};
+
+
+struct pfq_steer_table *
+pfq_steer_table_build(unsigned long class_mask, unsigned long sock_mask)
+{
+	struct pfq_steer_backend backend[Q_MAX_ID];
+	struct pfq_steer_table *table;
+	unsigned long bit;
+	int n, nback = 0, filled = 0;
+
+	if (!sock_mask)
+		return NULL;
+
+	table = kmalloc(sizeof(struct pfq_steer_table), GFP_KERNEL);
+	if (table == NULL) {
+		printk(KERN_WARNING "[PFQ] steering table: out of memory!\n");
+		return NULL;
+	}
+
+	table->class_mask = class_mask;
+	table->sock_mask  = sock_mask;
+	memset(table->entry, 0xff, sizeof(table->entry));
+
+	pfq_bitwise_foreach(sock_mask, bit,
+	{
+		int id = (int)pfq_ctz(bit);
+		struct pfq_sock *so;
+
+		rcu_read_lock();
+		so = pfq_sock_get_by_id((__force pfq_id_t)id);
+		backend[nback].weight = so ? so->weight : 1;
+		rcu_read_unlock();
+
+		backend[nback].offset = jhash_1word((u32)id, PFQ_STEER_SEED_OFFSET) & (Q_STEER_TABLE_LEN-1);
+		backend[nback].skip   = (jhash_1word((u32)id, PFQ_STEER_SEED_SKIP) & (Q_STEER_TABLE_LEN-1)) | 1;
+		backend[nback].next   = 0;
+		backend[nback].id     = id;
+		nback++;
+	});
+
+	while (filled < Q_STEER_TABLE_LEN)
+	{
+		for(n = 0; n < nback && filled < Q_STEER_TABLE_LEN; n++)
+		{
+			struct pfq_steer_backend *b = &backend[n];
+			int w;
+
+			for(w = 0; w < b->weight && filled < Q_STEER_TABLE_LEN; w++)
+			{
+				uint32_t c;
+				do {
+					c = (b->offset + b->next * b->skip) & (Q_STEER_TABLE_LEN-1);
+					b->next++;
+				}
+				while (table->entry[c] != 0xff);
+
+				table->entry[c] = (uint8_t)b->id;
+				filled++;
+			}
+		}
+	}
+
+	return table;
+}
+
+
+void
+pfq_steer_map_free(struct pfq_steer_map *map)
+{
+	size_t n;
+
+	if (map == NULL)
+		return;
+
+	for(n = 0; n < map->len; n++)
+		kfree(map->table[n]);
+	kfree(map);
+}
+
+
+static void
+pfq_steer_map_free_cb(struct rcu_head *rcu)
+{
+	pfq_steer_map_free(container_of(rcu, struct pfq_steer_map, rcu));
+}
+
+
+void
+pfq_steer_map_free_rcu(struct pfq_steer_map *map)
+{
+	if (map)
+		call_rcu(&map->rcu, pfq_steer_map_free_cb);
+}
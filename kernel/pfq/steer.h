@@ -0,0 +1,89 @@
+/***************************************************************
+ *
+ * (C) 2011-16 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#ifndef PFQ_STEER_H
+#define PFQ_STEER_H
+
+#include <pfq/define.h>
+#include <pfq/kcompat.h>
+
+#include <linux/types.h>
+#include <linux/rcupdate.h>
+
+
+/* consistent-hash (Maglev) steering table.
+ *
+ * Each socket owns a share of the entries proportional to its weight.
+ * When a socket joins or leaves, only the entries it owns (or that it
+ * takes over) change: about 1/N of the flows are moved.
+ */
+
+struct pfq_steer_table
+{
+	unsigned long	class_mask;		/* classes the table was built for */
+	unsigned long	sock_mask;		/* eligible sockets at build time */
+	uint8_t		entry[Q_STEER_TABLE_LEN];	/* socket ids */
+};
+
+
+/* steering tables of a group, one per (single or combined) class mask,
+ * published with RCU and replaced as a whole.
+ */
+
+struct pfq_steer_map
+{
+	struct rcu_head		rcu;
+	size_t			len;
+	struct pfq_steer_table	*table[Q_STEER_MAP_LEN];
+};
+
+
+extern struct pfq_steer_table *pfq_steer_table_build(unsigned long class_mask, unsigned long sock_mask);
+extern void pfq_steer_map_free(struct pfq_steer_map *map);
+extern void pfq_steer_map_free_rcu(struct pfq_steer_map *map);
+
+
+static inline
+struct pfq_steer_table *
+pfq_steer_map_lookup(struct pfq_steer_map const *map, unsigned long class_mask)
+{
+	size_t n;
+	for(n = 0; n < map->len; n++)
+	{
+		if (map->table[n]->class_mask == class_mask)
+			return map->table[n];
+	}
+	return NULL;
+}
+
+
+/* multiply-shift: the top bits of the product depend on every bit of the hash */
+
+static inline
+unsigned long pfq_steer_table_lookup(struct pfq_steer_table const *table, uint32_t hash)
+{
+	return 1UL << table->entry[(uint32_t)(hash * 0x9e3779b1U) >> (32 - Q_STEER_TABLE_BITS)];
+}
+
+
+#endif /* PFQ_STEER_H */
@@ -33,6 +33,8 @@
 #include <linux/kthread.h>
 #include <linux/mutex.h>
 #include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/slab.h>
 
 
 static DEFINE_MUTEX(pfq_thread_tx_pool_lock);
@@ -44,8 +46,8 @@ static struct pfq_thread_tx_data pfq_thread_tx_pool[Q_MAX_CPU] =
 		.id	= -1,
 		.cpu    = -1,
 		.task	= NULL,
-		.sock   = {NULL, NULL, NULL, NULL},
-		.sock_queue = {{-1}, {-1}, {-1}, {-1}}
+		.bindings = NULL,
+		.next	= 0
 	}
 };
 
@@ -64,10 +66,122 @@ pfq_thread_ping(const char *type, struct pfq_thread_data const *data)
 
 
 
+/*
+ * sleep until a timed packet is close to its deadline (the last
+ * Q_TX_BUSY_WAIT nsec are busy-waited by the transmit function)
+ */
+
+static void
+pfq_tx_thread_sleep_until(uint64_t deadline)
+{
+	int64_t delta = (int64_t)deadline - ktime_to_ns(ktime_get_real()) - Q_TX_BUSY_WAIT;
+	ktime_t expires;
+
+	if (delta <= 0) {
+		pfq_relax();
+		return;
+	}
+
+	expires = ns_to_ktime(min_t(int64_t, delta, Q_TX_MAX_SLEEP));
+
+	set_current_state(TASK_INTERRUPTIBLE);
+	schedule_hrtimeout_range(&expires, Q_TX_BUSY_WAIT/2, HRTIMER_MODE_REL);
+	__set_current_state(TASK_RUNNING);
+}
+
+
+/*
+ * set the kick flag of the shared queues bound to the thread:
+ * when set, producers wake the thread up after enqueuing packets.
+ */
+
+static void
+pfq_tx_thread_kick_flag(struct pfq_thread_tx_data *data, unsigned int value)
+{
+	struct pfq_tx_binding_list *list;
+	int n;
+
+	rcu_read_lock();
+	list = rcu_dereference(data->bindings);
+	for(n = 0; list && n < list->len; n++)
+	{
+		struct pfq_shared_tx_queue *tx_queue;
+
+		tx_queue = pfq_sock_tx_shared_queue(list->entry[n].sock, list->entry[n].sock_queue);
+		if (tx_queue)
+			__atomic_store_n(&tx_queue->cons.kick, value, __ATOMIC_RELAXED);
+	}
+	rcu_read_unlock();
+}
+
+
+static bool
+pfq_tx_thread_pending(struct pfq_thread_tx_data *data)
+{
+	struct pfq_tx_binding_list *list;
+	bool ret = false;
+	int n;
+
+	rcu_read_lock();
+	list = rcu_dereference(data->bindings);
+	for(n = 0; list && n < list->len; n++)
+	{
+		struct pfq_shared_tx_queue *tx_queue;
+
+		tx_queue = pfq_sock_tx_shared_queue(list->entry[n].sock, list->entry[n].sock_queue);
+		if (tx_queue && pfq_sk_queue_pending(tx_queue)) {
+			ret = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+
+/*
+ * park the thread until a producer kicks it (or Q_TX_PARK_TIMEOUT expires).
+ * The kick flag is published before the last check of the queues, so that
+ * a producer either sees the flag or its packets are seen here.
+ */
+
+static void
+pfq_tx_thread_park(struct pfq_thread_tx_data *data)
+{
+	pfq_tx_thread_kick_flag(data, 1);
+	smp_mb();
+
+	if (!pfq_tx_thread_pending(data))
+		wait_event_interruptible_timeout(data->waitqueue,
+						 atomic_read(&data->kicked) || kthread_should_stop(),
+						 msecs_to_jiffies(Q_TX_PARK_TIMEOUT));
+
+	atomic_set(&data->kicked, 0);
+	pfq_tx_thread_kick_flag(data, 0);
+}
+
+
+int
+pfq_wakeup_tx_thread(int tid)
+{
+	struct pfq_thread_tx_data *data;
+
+	if (tid < 0 || tid >= global->tx_cpu_nr)
+		return -ESRCH;
+
+	data = &pfq_thread_tx_pool[tid];
+
+	atomic_set(&data->kicked, 1);
+	wake_up_interruptible(&data->waitqueue);
+	return 0;
+}
+
+
 static int
 pfq_tx_thread(void *_data)
 {
 	struct pfq_thread_tx_data *data = (struct pfq_thread_tx_data *)_data;
+	ktime_t last_active = ktime_get();
 
 #ifdef PFQ_DEBUG
         int now = 0;
@@ -84,32 +198,48 @@ pfq_tx_thread(void *_data)
 
         for(;;)
 	{
-		/* transmit the registered socket's queues */
+		/* transmit the registered socket's queues (round-robin, Q_TX_QUEUE_BUDGET packets each):
+		 * the RCU read section covers a single queue, the list is looked up again for the next one */
+		struct pfq_tx_binding_list *list;
+		uint64_t deadline = 0;
 		bool reg = false;
 		int total_sent = 0, n;
 
-		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		for(n = 0;; n++)
 		{
-			struct pfq_sock *sock;
-			int sock_queue;
+			struct pfq_tx_binding *b;
+			uint64_t next = 0;
 			tx_response_t tx;
 
-			sock_queue = atomic_read(&data->sock_queue[n]);
-			smp_rmb();
-			sock = data->sock[n];
-
-			if (sock_queue != -1 && sock != NULL) {
-				reg = true;
-				tx = pfq_sk_queue_xmit(sock, sock_queue, data->cpu);
-				total_sent += tx.ok;
+			rcu_read_lock();
 
-				sparse_add(sock->stats,	  sent, tx.ok);
-				sparse_add(sock->stats,   fail, tx.fail);
-				sparse_add(global->percpu_stats,  sent, tx.ok);
-				sparse_add(global->percpu_stats,  fail, tx.fail);
+			list = rcu_dereference(data->bindings);
+			if (!list || n >= list->len) {
+				rcu_read_unlock();
+				break;
 			}
+
+			reg = true;
+
+			b = &list->entry[(data->next + n) % list->len];
+
+			tx = pfq_sk_queue_xmit(b->sock, b->sock_queue, data->cpu, &next, Q_TX_QUEUE_BUDGET);
+			total_sent += tx.ok;
+
+			if (next && (!deadline || next < deadline))
+				deadline = next;
+
+			sparse_add(b->sock->stats, sent, tx.ok);
+			sparse_add(b->sock->stats, fail, tx.fail);
+			sparse_add(global->percpu_stats,  sent, tx.ok);
+			sparse_add(global->percpu_stats,  fail, tx.fail);
+
+			rcu_read_unlock();
 		}
 
+		if (reg)
+			data->next++;
+
                 if (kthread_should_stop())
                         break;
 
@@ -120,8 +250,20 @@ pfq_tx_thread(void *_data)
 		}
 #endif
 
-		if (total_sent == 0)
-			pfq_relax();
+		if (total_sent == 0) {
+			if (deadline)
+				pfq_tx_thread_sleep_until(deadline);
+			else if (reg && global->tx_poll > 0 &&
+				 ktime_us_delta(ktime_get(), last_active) > global->tx_poll) {
+				pfq_tx_thread_park(data);
+				last_active = ktime_get();
+			}
+			else
+				pfq_relax();
+		}
+		else {
+			last_active = ktime_get();
+		}
 
 		if (!reg)
 			msleep(1);
@@ -137,7 +279,8 @@ int
 pfq_bind_tx_thread(int tid, struct pfq_sock *sock, int sock_queue)
 {
 	struct pfq_thread_tx_data *thread_data;
-	int n;
+	struct pfq_tx_binding_list *list, *old;
+	int len;
 
 	if (tid >= global->tx_cpu_nr) {
 		printk(KERN_INFO "[PFQ] Tx[%d] thread not available (%d Tx threads running)!\n", tid, global->tx_cpu_nr);
@@ -148,21 +291,30 @@ pfq_bind_tx_thread(int tid, struct pfq_sock *sock, int sock_queue)
 
 	mutex_lock(&pfq_thread_tx_pool_lock);
 
-	for(n = 0; n < Q_MAX_TX_QUEUES; n++)
-	{
-		if (atomic_read(&thread_data->sock_queue[n]) == -1)
-			break;
-	}
+	/* publish a copy of the list with the new queue appended */
+
+	old = rcu_dereference_protected(thread_data->bindings, lockdep_is_held(&pfq_thread_tx_pool_lock));
+	len = old ? old->len : 0;
 
-	if (n == Q_MAX_TX_QUEUES) {
+	list = kmalloc(sizeof(*list) + (len + 1) * sizeof(struct pfq_tx_binding), GFP_KERNEL);
+	if (!list) {
 		mutex_unlock(&pfq_thread_tx_pool_lock);
-		printk(KERN_INFO "[PFQ] Tx[%d] thread busy (no queue available)!\n", tid);
-		return -EBUSY;
+		printk(KERN_INFO "[PFQ] Tx[%d] thread: out of memory!\n", tid);
+		return -ENOMEM;
 	}
 
-	thread_data->sock[n] = sock;
-	smp_wmb();
-	atomic_set(&thread_data->sock_queue[n], sock_queue);
+	if (old)
+		memcpy(list->entry, old->entry, len * sizeof(struct pfq_tx_binding));
+
+	list->entry[len].sock = sock;
+	list->entry[len].sock_queue = sock_queue;
+	list->len = len + 1;
+
+	rcu_assign_pointer(thread_data->bindings, list);
+	if (old)
+		kfree_rcu(old, rcu);
+
+	pfq_wakeup_tx_thread(tid);
 
         mutex_unlock(&pfq_thread_tx_pool_lock);
         printk(KERN_INFO "[PFQ] Tx[%d] thread bound to sock_id = %d, queue = %d...\n", tid, sock->id, sock_queue);
@@ -173,27 +325,49 @@ pfq_bind_tx_thread(int tid, struct pfq_sock *sock, int sock_queue)
 int
 pfq_unbind_tx_thread(struct pfq_sock *sock)
 {
+	bool changed = false;
 	int n, i;
+
 	mutex_lock(&pfq_thread_tx_pool_lock);
 
 	for(n = 0; n < global->tx_cpu_nr; n++)
 	{
 		struct pfq_thread_tx_data *data = &pfq_thread_tx_pool[n];
+		struct pfq_tx_binding_list *list, *old;
+		int len = 0;
 
-		for(i = 0; i < Q_MAX_TX_QUEUES; i++)
-		{
-			if (atomic_read(&data->sock_queue[i]) != -1)
-			{
-				if (data->sock[i] == sock) {
-					atomic_set(&data->sock_queue[i], -1);
-					smp_wmb();
-					msleep(Q_GRACE_PERIOD);
-					data->sock[i] = NULL;
-				}
-			}
+		old = rcu_dereference_protected(data->bindings, lockdep_is_held(&pfq_thread_tx_pool_lock));
+		if (!old)
+			continue;
+
+		for(i = 0; i < old->len; i++)
+			if (old->entry[i].sock != sock)
+				len++;
+
+		if (len == old->len)
+			continue;
+
+		/* publish a copy of the list without the queues of this socket */
+
+		list = NULL;
+		if (len) {
+			list = kmalloc(sizeof(*list) + len * sizeof(struct pfq_tx_binding), GFP_KERNEL | __GFP_NOFAIL);
+			list->len = 0;
+			for(i = 0; i < old->len; i++)
+				if (old->entry[i].sock != sock)
+					list->entry[list->len++] = old->entry[i];
 		}
+
+		rcu_assign_pointer(data->bindings, list);
+		kfree_rcu(old, rcu);
+		changed = true;
 	}
 
+	/* wait for the Tx threads to leave the socket queues */
+
+	if (changed)
+		synchronize_rcu();
+
         mutex_unlock(&pfq_thread_tx_pool_lock);
         return 0;
 }
@@ -217,6 +391,9 @@ pfq_start_tx_threads(void)
 
 			data->id = n;
 			data->cpu = global->tx_cpu[n];
+
+			init_waitqueue_head(&data->waitqueue);
+			atomic_set(&data->kicked, 0);
 			data->task = kthread_create_on_node(pfq_tx_thread,
 							    data, node,
 							    "kpfq-Tx/%d", data->cpu);
@@ -255,7 +432,7 @@ pfq_stop_tx_threads(void)
 
 			if (data->task)
 			{
-				int i;
+				struct pfq_tx_binding_list *list;
 				pr_devel("[PFQ stopping Tx[%d] thread@%p\n", data->id, data->task);
 
 				kthread_stop(data->task);
@@ -263,11 +440,9 @@ pfq_stop_tx_threads(void)
 				data->cpu  = -1;
 				data->task = NULL;
 
-				for(i=0; i < Q_MAX_TX_QUEUES; ++i)
-				{
-					atomic_set(&data->sock_queue[i], -1);
-					data->sock[i] = NULL;
-				}
+				list = rcu_dereference_protected(data->bindings, 1);
+				RCU_INIT_POINTER(data->bindings, NULL);
+				kfree(list);
 			}
 		}
 	}
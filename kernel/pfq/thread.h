@@ -29,6 +29,8 @@
 #include <linux/kthread.h>
 #include <linux/mutex.h>
 #include <linux/rwsem.h>
+#include <linux/rcupdate.h>
+#include <linux/wait.h>
 
 
 struct pfq_sock;
@@ -39,6 +41,7 @@ extern int  pfq_start_tx_threads(void);
 extern void pfq_stop_tx_threads(void);
 extern int  pfq_bind_tx_thread(int tx_index, struct pfq_sock *sock, int sock_queue);
 extern int  pfq_unbind_tx_thread(struct pfq_sock *sock);
+extern int  pfq_wakeup_tx_thread(int tid);
 
 extern int pfq_check_threads_affinity(void);
 extern int pfq_check_napi_contexts(void);
@@ -51,6 +54,23 @@ struct pfq_thread_data
 };
 
 
+/* socket queues bound to a Tx thread: replaced (RCU) on bind/unbind */
+
+struct pfq_tx_binding
+{
+	struct pfq_sock *	sock;
+	int			sock_queue;
+};
+
+
+struct pfq_tx_binding_list
+{
+	struct rcu_head		rcu;
+	int			len;
+	struct pfq_tx_binding	entry[];
+};
+
+
 struct pfq_thread_tx_data
 {
 	int			id;
@@ -59,8 +79,13 @@ struct pfq_thread_tx_data
 
 	/* specific for Tx data */
 
-	struct pfq_sock *	sock[Q_MAX_TX_QUEUES];
-	atomic_t		sock_queue[Q_MAX_TX_QUEUES];
+	struct pfq_tx_binding_list __rcu *bindings;
+	unsigned int		next;		/* first queue served in the next round */
+
+	/* parking: the thread sleeps when idle for more than tx_poll usec */
+
+	wait_queue_head_t	waitqueue;
+	atomic_t		kicked;
 
 } ____pfq_cacheline_aligned;
 
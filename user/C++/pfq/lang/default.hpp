@@ -222,6 +222,10 @@ namespace pfq { namespace lang {
 
         auto is_ip          = predicate ("is_ip");
 
+        //! Evaluate to \c true if the Qbuff is an IPv6 packet.
+
+        auto is_ip6         = predicate ("is_ip6");
+
         //! Evaluate to \c true if the Qbuff is an UDP packet.
 
         auto is_udp         = predicate ("is_udp");
@@ -234,6 +238,10 @@ namespace pfq { namespace lang {
 
         auto is_icmp        = predicate ("is_icmp");
 
+        //! Evaluate to \c true if the Qbuff is an ICMPv6 packet.
+
+        auto is_icmp6       = predicate ("is_icmp6");
+
         //! Evaluate to \c true if the Qbuff is an UDP or TCP packet.
 
         auto is_flow        = predicate ("is_flow");
@@ -309,6 +317,32 @@ namespace pfq { namespace lang {
             return predicate("has_dst_addr", data);
         };
 
+        //! Evaluate to \c true if the source or destination IPv6 address matches the given network address. I.e.,
+        /*!
+         * Example:
+         *
+         * has_addr6 ({"2001:db8::",32})
+         */
+
+        auto has_addr6 = [] (CIDR6 data)
+        {
+            return predicate("has_addr6", data);
+        };
+
+        //! Evaluate to \c true if the source IPv6 address matches the given network address.
+
+        auto has_src_addr6 = [] (CIDR6 data)
+        {
+            return predicate("has_src_addr6", data);
+        };
+
+        //! Evaluate to \c true if the destination IPv6 address matches the given network address.
+
+        auto has_dst_addr6 = [] (CIDR6 data)
+        {
+            return predicate("has_dst_addr6", data);
+        };
+
         //! Evaluate to \c true if the Qbuff has the given \c mark, set by mark function.
         /*!
          * Example:
@@ -540,6 +574,16 @@ namespace pfq { namespace lang {
 
         auto steer_local_ip = [] (CIDR data) { return function("steer_local_ip", data); };
 
+        //! Dispatch the packet across the sockets, with a randomized algorithm that maintains the integrity of
+        //! IPv6 flows that belong to the given network (see \c steer_local_ip).
+        /*!
+         * Example:
+         *
+         * steer_local_ip6 "2001:db8::/32"
+         */
+
+        auto steer_local_ip6 = [] (CIDR6 data) { return function("steer_local_ip6", data); };
+
         //! Dispatch the packet across the sockets
         /*!
          * Dispatch with a randomized algorithm that guarantees
@@ -560,6 +604,17 @@ namespace pfq { namespace lang {
 
         auto steer_flow = function("steer_flow");
 
+        //! Dispatch the packet across the sockets, with the given hash family
+        /*!
+         * Like steer_flow, the hash family is one of Q_STEER_HASH_XOR (as steer_flow),
+         * Q_STEER_HASH_TOEPLITZ (symmetric Toeplitz, as NIC RSS) or Q_STEER_HASH_MIX
+         * (keyed symmetric multiply-xorshift). Example:
+         *
+         * steer_flow_hash (Q_STEER_HASH_TOEPLITZ)
+         */
+
+        auto steer_flow_hash = [] (int hash) { return function("steer_flow_hash", hash); };
+
         //! Dispatch the packet across the sockets
         /*!
          * Dispatch with a randomized algorithm that guarantees
@@ -663,6 +718,10 @@ namespace pfq { namespace lang {
 
         auto ip             = function("ip");
 
+        //! Evaluate to \c Pass Qbuff if it is an IPv6 packet, \c Drop it otherwise.
+
+        auto ip6            = function("ip6");
+
         //! Evaluate to \c Pass Qbuff if it is an UDP packet, \c Drop it otherwise.
 
         auto udp            = function("udp");
@@ -675,6 +734,10 @@ namespace pfq { namespace lang {
 
         auto icmp           = function("icmp");
 
+        //! Evaluate to \c Pass Qbuff if it is an ICMPv6 packet, \c Drop it otherwise.
+
+        auto icmp6          = function("icmp6");
+
         //! Evaluate to \c Pass Qbuff if it has a vlan tag, \c Drop it otherwise.
 
         auto vlan           = function("vlan");
@@ -959,6 +1022,27 @@ namespace pfq { namespace lang {
             return function("dst_addr", data);
         };
 
+        //! Monadic version of \c has_addr6 predicate.  \see has_addr6
+
+        auto addr6 = [] (CIDR6 data)
+        {
+            return function("addr6", data);
+        };
+
+        //! Monadic version of \c has_src_addr6 predicate.  \see has_src_addr6
+
+        auto src_addr6 = [] (CIDR6 data)
+        {
+            return function("src_addr6", data);
+        };
+
+        //! Monadic version of \c has_dst_addr6 predicate.  \see has_dst_addr6
+
+        auto dst_addr6 = [] (CIDR6 data)
+        {
+            return function("dst_addr6", data);
+        };
+
         //! Conditional execution of monadic NetFunctions.
         /*!
          * The function takes a predicate and evaluates to given the NetFunction when it evalutes to \c true,
@@ -1202,6 +1286,55 @@ namespace pfq { namespace lang {
                                     auto addrs = fmap(details::inet_addr, ips);
                                     return function("bloom_dst_filter", m, std::move(addrs), prefix);
                                 };
+
+        //! IPv6 counterpart of \c bloom: the addresses are IPv6 and the prefix ranges in [0,128].
+        /*!
+         * Example:
+         *
+         * when (bloom6 (1024, {"2001:db8::1", "2001:db8::2"}, 128), log_packet ) >> kernel
+         *
+         */
+
+        auto bloom6     = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                auto addrs = fmap([](std::string const &ip) { return ipv6_t{ip.c_str()}; }, ips);
+                                return predicate("bloom6", m, std::move(addrs), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_src.  \see bloom6
+
+        auto bloom6_src = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                auto addrs = fmap([](std::string const &ip) { return ipv6_t{ip.c_str()}; }, ips);
+                                return predicate("bloom6_src", m, std::move(addrs), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_dst.  \see bloom6
+
+        auto bloom6_dst = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                auto addrs = fmap([](std::string const &ip) { return ipv6_t{ip.c_str()}; }, ips);
+                                return predicate("bloom6_dst", m, std::move(addrs), prefix);
+                          };
+
+        //! Monadic counterpart of \c bloom6 function.  \see bloom6
+
+        auto bloom6_filter     = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                    auto addrs = fmap([](std::string const &ip) { return ipv6_t{ip.c_str()}; }, ips);
+                                    return function("bloom6_filter", m, std::move(addrs), prefix);
+                                };
+
+        //! Monadic counterpart of \c bloom6_src function.  \see bloom6_src
+
+        auto bloom6_src_filter = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                    auto addrs = fmap([](std::string const &ip) { return ipv6_t{ip.c_str()}; }, ips);
+                                    return function("bloom6_src_filter", m, std::move(addrs), prefix);
+                                };
+
+        //! Monadic counterpart of \c bloom6_dst function.  \see bloom6_dst
+
+        auto bloom6_dst_filter = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                    auto addrs = fmap([](std::string const &ip) { return ipv6_t{ip.c_str()}; }, ips);
+                                    return function("bloom6_dst_filter", m, std::move(addrs), prefix);
+                                };
+
         //
         // bloom filter, utility functions:
         //
@@ -152,6 +152,90 @@ namespace pfq { namespace lang
     }
 
 
+    // ipv6_t, network byte order type with converting constructor
+    //
+
+    struct ipv6_t
+    {
+        ipv6_t() = default;
+
+        ipv6_t(const char *addr)
+        {
+            if (inet_pton(AF_INET6, addr, &value) <= 0)
+                throw std::runtime_error("pfq::lang::ipv6_t");
+        }
+
+        struct in6_addr value;
+    };
+
+    inline std::string
+    show(ipv6_t value)
+    {
+        char buff[INET6_ADDRSTRLEN];
+        if (inet_ntop(AF_INET6, &value.value, buff, sizeof(buff)) == NULL)
+            throw std::runtime_error("pfq::lang::inet_ntop");
+
+        return buff;
+    }
+
+    inline std::string
+    pretty(ipv6_t value)
+    {
+        return show(value);
+    }
+
+    // CIDR6: ipv6 network address + prefix notation.
+    //
+
+    struct CIDR6
+    {
+        CIDR6() = default;
+
+        CIDR6(const char *a, int p)
+        : prefix(p)
+        {
+            if (inet_pton(AF_INET6, a, &addr) <= 0)
+                throw std::runtime_error("pfq::lang::CIDR6");
+        }
+
+        CIDR6(const char *descr)
+        {
+            const char *slash = strchr(descr, '/');
+            if (slash == nullptr)
+                throw std::runtime_error("CIDR6: bad format (slash missing)");
+
+            std::string a(descr, slash);
+
+            if (inet_pton(AF_INET6, a.c_str(), &addr) <= 0)
+                throw std::runtime_error("pfq::lang::CIDR6");
+
+            prefix = atoi(slash+1);
+        }
+
+        struct in6_addr addr;
+        int             prefix;
+    };
+
+
+    inline std::string
+    show(CIDR6 value)
+    {
+        char buff[INET6_ADDRSTRLEN];
+        if (inet_ntop(AF_INET6, &value.addr, buff, sizeof(buff)) == NULL)
+            throw std::runtime_error("pfq::lang::CIDR6::inet_ntop");
+        return "CIDR6{" + std::string{buff} + ',' + std::to_string(value.prefix) + '}';
+    }
+
+    inline std::string
+    pretty(CIDR6 value)
+    {
+        char buff[INET6_ADDRSTRLEN];
+        if (inet_ntop(AF_INET6, &value.addr, buff, sizeof(buff)) == NULL)
+            throw std::runtime_error("pfq::lang::CIDR6::inet_ntop");
+        return std::string{buff} + '/' + std::to_string(value.prefix);
+    }
+
+
     //
     // pfq-lang DSL...
     //
@@ -398,6 +398,61 @@ namespace pfq {
             throw system_error("PFQ: socket not open");
         }
 
+        // packed Rx queue: walk the packets reserved by the producers, waiting for their commit
+
+        size_t rx_packed_walk(char *queue, size_t reserved, uint32_t index, size_t &bytes) const
+        {
+            const size_t limit = data_->rx_queue_size - data_->rx_slot_size;
+            size_t off = 0, n = 0;
+
+            while (off < reserved && off <= limit)
+            {
+                auto hdr = reinterpret_cast<pfq_pkthdr *>(queue + off);
+
+                while (__atomic_load_n(&hdr->info.commit, __ATOMIC_ACQUIRE) != index)
+                    std::this_thread::yield();
+
+                off += PFQ_SHARED_QUEUE_PKTHDR_STRIDE(hdr);
+                n++;
+            }
+
+            bytes = off;
+            return n;
+        }
+
+        // batched wakeups: a ring already holding a batch (or full) is read without polling
+
+        bool rx_ring_readable(unsigned long int data) const
+        {
+            const size_t len = PFQ_SHARED_QUEUE_LEN(data);
+
+            if (data_->rx_packed)
+                return len > data_->rx_queue_size - data_->rx_slot_size;
+
+            return len >= data_->rx_slots || (data_->rx_wakeup_pkts != 0 && len >= data_->rx_wakeup_pkts);
+        }
+
+        // round-robin over the Rx rings: the first non-empty ring after the last one read
+
+        size_t rx_ring_select(struct pfq_shared_queue *q, unsigned long int &data) const
+        {
+            auto ring = data_->rx_ring;
+
+            data = 0;
+
+            for(size_t n = 0; n < data_->rx_rings; n++)
+            {
+                if (++ring == data_->rx_rings)
+                    ring = 0;
+
+                data = __atomic_load_n(&q->rx[ring].shinfo, __ATOMIC_RELAXED);
+                if (PFQ_SHARED_QUEUE_LEN(data))
+                    break;
+            }
+
+            return ring;
+        }
+
     public:
 
         //! Close the socket.
@@ -471,6 +526,46 @@ namespace pfq {
             return as<bool>(q, pfq_is_timestamping_enabled(q));
         }
 
+        //! Select the source of the Rx timestamp.
+        /*!
+         * Q_TSTAMP_OFF, Q_TSTAMP_SW, Q_TSTAMP_HW_RAW (NIC clock) or Q_TSTAMP_HW_SYS.
+         * Packets not stamped by the NIC carry the software timestamp.
+         */
+
+        void
+        timestamping_source(int source)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_timestamping_enable(q, source));
+        }
+
+        //! Return the source of the Rx timestamp.
+
+        int
+        timestamping_source() const
+        {
+            auto q = this->data();
+            return as<int>(q, pfq_is_timestamping_enabled(q));
+        }
+
+        //! Enable/disable zero-copy transmission from the shared Tx queues.
+
+        void
+        tx_zcopy_enable(bool value)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_tx_zcopy_enable(q, value));
+        }
+
+        //! Check whether zero-copy transmission is enabled.
+
+        bool
+        is_tx_zcopy_enabled() const
+        {
+            auto q = this->data();
+            return as<bool>(q, pfq_is_tx_zcopy_enabled(q));
+        }
+
         //! Set the weight of the socket for the steering phase.
 
         void
@@ -564,6 +659,120 @@ namespace pfq {
            return data()->tx_slots;
         }
 
+        //! Enable/disable packed Rx slots (to be set before the socket is enabled).
+        /*!
+         * Packets are stored back-to-back in the Rx queue; the net_queue
+         * iterators follow the stride of each packet.
+         */
+
+        void
+        rx_packed(bool value)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_set_rx_packed(q, value));
+        }
+
+        //! Return true if the Rx slots are packed.
+
+        bool
+        rx_packed() const
+        {
+            auto q = this->data();
+            return as<int>(q, pfq_get_rx_packed(q)) != 0;
+        }
+
+        //! Set the batched Rx wakeups of the socket.
+        /*!
+         * The socket becomes readable (poll/epoll on fd()) when packets packets
+         * are pending, or when the oldest pending packet has waited usec
+         * microseconds (0 disables each condition). With batched wakeups
+         * enabled, read() waits for the socket to be readable.
+         */
+
+        void
+        rx_wakeup(unsigned int packets, unsigned int usec)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_set_rx_wakeup(q, packets, usec));
+        }
+
+        //! Return the batched Rx wakeups of the socket.
+
+        pfq_so_rx_wakeup
+        rx_wakeup() const
+        {
+            auto q = this->data();
+            pfq_so_rx_wakeup wk;
+            throw_if(q, pfq_get_rx_wakeup(q, &wk.packets, &wk.usec));
+            return wk;
+        }
+
+        //! Set the Rx back-pressure of the socket.
+        /*!
+         * With hold, the packets that do not fit the Rx queue are held by the
+         * kernel for at most hold_usec microseconds (up to 1 second) and redelivered in order.
+         * Watermark (percent of the Rx queue, 0 = off) wakes up the consumer
+         * as the queue fills above it.
+         */
+
+        void
+        rx_backpressure(bool hold, unsigned int hold_usec, unsigned int watermark = 0)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_set_rx_backpressure(q, hold, hold_usec, watermark));
+        }
+
+        //! Return the Rx back-pressure of the socket.
+
+        pfq_so_rx_backpressure
+        rx_backpressure() const
+        {
+            auto q = this->data();
+            pfq_so_rx_backpressure bp;
+            throw_if(q, pfq_get_rx_backpressure(q, &bp.hold, &bp.hold_usec, &bp.watermark));
+            return bp;
+        }
+
+        //! Specify the number of Rx rings (to be set before the socket is enabled).
+        /*!
+         * Each producing cpu feeds the ring cpu % rings; read() serves the
+         * rings in round-robin.
+         */
+
+        void
+        rx_rings(size_t value)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_set_rx_rings(q, value));
+        }
+
+        //! Return the number of Rx rings of the socket.
+
+        size_t
+        rx_rings() const
+        {
+            auto q = this->data();
+            return as<size_t>(q, pfq_get_rx_rings(q));
+        }
+
+        //! Specify the number of async Tx queues (to be set before the socket is enabled).
+
+        void
+        tx_queues(size_t value)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_set_tx_queues(q, value));
+        }
+
+        //! Return the number of async Tx queues of the socket.
+
+        size_t
+        tx_queues() const
+        {
+            auto q = this->data();
+            return as<size_t>(q, pfq_get_tx_queues(q));
+        }
+
 
         //! Bind the main group of the socket to the given device/queue.
         /*!
@@ -658,6 +867,20 @@ namespace pfq {
             throw_if(q, pfq_unbind_tx(q));
         }
 
+        //! Set the rate of a Tx queue of the socket.
+        /*!
+         * The queue is shaped in kernel by a token bucket of 'pps' packets and/or 'bps' bits
+         * per second (0 = unlimited), with a depth of 'burst_pkts' packets and 'burst_bytes' bytes.
+         * The queue is 'no_kthread' for synchronous transmissions, 0.. for the async queues.
+         */
+
+        void
+        set_tx_rate(int queue, unsigned long pps, unsigned long bps = 0, unsigned int burst_pkts = 32, unsigned int burst_bytes = 0)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_set_tx_rate(q, queue, pps, bps, burst_pkts, burst_bytes));
+        }
+
         //! Join the group specified by the group id.
         /*!
          * If the policy is not specified, group_policy::shared is used by default.
@@ -818,6 +1041,28 @@ namespace pfq {
             throw_if(q, pfq_group_fprog_reset(q, gid));
         }
 
+        //! Attach an eBPF program (by file descriptor) to the given group.
+        /*!
+         * The return value of the program is a verdict (Q_EBPF_FILTER),
+         * a steering hash (Q_EBPF_STEER) or a class mask (Q_EBPF_CLASS).
+         */
+
+        void
+        set_group_ebpf(int gid, int fd, int mode = Q_EBPF_FILTER)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_group_ebpf(q, gid, fd, mode));
+        }
+
+        //! Detach the eBPF program from the given group.
+
+        void
+        reset_group_ebpf(int gid)
+        {
+            auto q = this->data();
+            throw_if(q, pfq_group_ebpf_reset(q, gid));
+        }
+
 
         //! Wait for packets.
         /*!
@@ -860,11 +1105,20 @@ namespace pfq {
 
             unsigned long int data, qver;
 
-            data = __atomic_load_n(&q->rx.shinfo, __ATOMIC_RELAXED);
-            if (PFQ_SHARED_QUEUE_LEN(data) == 0)
+            auto ring = this->rx_ring_select(q, data);
+
+            // batched wakeups: unless a ring is readable, wait for the kernel to report the socket readable
+
+            if (data_->rx_wakeup && !this->rx_ring_readable(data))
+            {
+                this->poll(microseconds);
+                ring = this->rx_ring_select(q, data);
+            }
+            if (PFQ_SHARED_QUEUE_LEN(data) == 0 && !data_->rx_wakeup)
             {
 #ifdef PFQ_USE_POLL
                 this->poll(microseconds);
+                ring = this->rx_ring_select(q, data);
 #else
                 usleep(10);
                 (void)microseconds;
@@ -874,39 +1128,61 @@ namespace pfq {
 
             qver = PFQ_SHARED_QUEUE_VER(data);
 
-            // at wrap-around reset Rx slots...
+            auto ring_addr = static_cast<char *>(data_->rx_queue_addr) + ring * data_->rx_queue_size * 2;
+
+            // at wrap-around reset Rx slots (packed queues at every swap, over the bytes
+            // used last time: a header may land on the stale payload of a previous round)...
             //
 
-            if (unlikely(((qver+1) & (PFQ_SHARED_QUEUE_VER_MASK^1))== 0))
+            if (unlikely(((qver+1) & (PFQ_SHARED_QUEUE_VER_MASK^1))== 0) || data_->rx_packed)
             {
-                auto raw = static_cast<char *>(data_->rx_queue_addr) + ((qver+1) & 1) * data_->rx_queue_size;
+                auto raw = ring_addr + ((qver+1) & 1) * data_->rx_queue_size;
                 auto end = raw + data_->rx_queue_size;
+                const size_t step = data_->rx_packed ? PFQ_SLOT_ALIGNMENT : data_->rx_slot_size;
                 const pfq_qver_t rst = qver & 1;
-                for(; raw < end; raw += data_->rx_slot_size)
+
+                if (likely(((qver+1) & (PFQ_SHARED_QUEUE_VER_MASK^1)) != 0))
+                    end = raw + data_->rx_used[ring];
+
+                for(; raw < end; raw += step)
                     reinterpret_cast<pfq_pkthdr *>(raw)->info.commit = rst;
             }
 
             // swap the net_queue...
             //
 
-            data = __atomic_exchange_n(&q->rx.shinfo, ((qver+1) << (PFQ_SHARED_QUEUE_LEN_SIZE<<3)), __ATOMIC_RELAXED);
+            data = __atomic_exchange_n(&q->rx[ring].shinfo, ((qver+1) << (PFQ_SHARED_QUEUE_LEN_SIZE<<3)), __ATOMIC_RELAXED);
+
+            data_->rx_ring = ring;
+
+            if (data_->rx_packed)
+                data_->rx_used[ring] = std::min(static_cast<size_t>(PFQ_SHARED_QUEUE_LEN(data)), data_->rx_queue_size);
+
+            if (data_->rx_packed)
+            {
+                auto queue = ring_addr + (qver & 1) * data_->rx_queue_size;
+                size_t bytes;
+                auto queue_len = this->rx_packed_walk(queue, PFQ_SHARED_QUEUE_LEN(data), static_cast<uint32_t>(qver), bytes);
+
+                return net_queue(queue, 0, queue_len, bytes, qver);
+            }
 
             auto queue_len = std::min( static_cast<size_t>(PFQ_SHARED_QUEUE_LEN(data))
                                       , data_->rx_slots);
 
-            return net_queue( static_cast<char *>(data_->rx_queue_addr) + (qver & 1) * data_->rx_queue_size
+            return net_queue( ring_addr + (qver & 1) * data_->rx_queue_size
                             , data_->rx_slot_size
                             , queue_len
                             , qver);
         }
 
-        //! Return the current commit version (used internally by the memory mapped queue).
+        //! Return the current commit version of the last Rx ring read (used internally by the memory mapped queue).
 
         pfq_qver_t
         current_commit() const
         {
             auto q = static_cast<struct pfq_shared_queue *>(data_->shm_addr);
-            auto data = __atomic_load_n(&q->rx.shinfo, __ATOMIC_RELAXED);
+            auto data = __atomic_load_n(&q->rx[data_->rx_ring].shinfo, __ATOMIC_RELAXED);
             return static_cast<pfq_qver_t>(PFQ_SHARED_QUEUE_VER(data));
         }
 
@@ -929,8 +1205,8 @@ namespace pfq {
             if (buff.second < data_->rx_slots * data_->rx_slot_size)
                 throw system_error("PFQ: buffer too small");
 
-            memcpy(buff.first, this_queue.data(), this_queue.slot_size() * this_queue.size());
-            return net_queue(buff.first, this_queue.slot_size(), this_queue.size(), this_queue.index());
+            memcpy(buff.first, this_queue.data(), this_queue.bytes());
+            return net_queue(buff.first, this_queue.slot_size(), this_queue.size(), this_queue.bytes(), this_queue.index());
         }
 
 
@@ -1151,6 +1427,11 @@ namespace pfq {
             auto index = __atomic_load_n(&tx->cons.index, __ATOMIC_RELAXED);
             if (index == __atomic_load_n(&tx->prod.index, __ATOMIC_RELAXED))
             {
+                // zero-copy: the next half is still referenced by the driver
+                //
+                if (__atomic_load_n(&tx->zcopy.pending[(index+1) & 1], __ATOMIC_ACQUIRE))
+                    return false;
+
                 ++index;
 
                 poff_addr = (index & 1) ? &tx->prod.off1 : &tx->prod.off0;
@@ -1190,6 +1471,17 @@ namespace pfq {
 			    memcpy(hdr+1, buf, caplen);
 
                 __atomic_store_n(poff_addr, offset + static_cast<ptrdiff_t>(data_->tx_slot_size), __ATOMIC_RELEASE);
+
+                // kick the Tx thread, if parked
+                //
+                if (tss >= 0)
+                {
+                    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                    if (__atomic_load_n(&tx->cons.kick, __ATOMIC_RELAXED) &&
+                        __atomic_exchange_n(&tx->cons.kick, 0, __ATOMIC_RELAXED))
+                        this->sync_queue(tss + 1);
+                }
+
                 return true;
             }
 
@@ -1199,7 +1491,8 @@ namespace pfq {
         //! Transmit the packets in the queue.
         /*!
          * Transmit the packets in the queue of the socket. 'queue = 0' is the
-         * queue of the socket enabled for synchronous transmission.
+         * queue of the socket enabled for synchronous transmission, 'queue = n'
+         * wakes up the Tx thread of the async queue n-1.
          */
 
         void
@@ -1228,7 +1521,11 @@ namespace pfq {
                    << "disc:" << rhs.disc << ' '
                    << "fail:" << rhs.fail << ' '
                    << "frwd:" << rhs.frwd << ' '
-                   << "kern:" << rhs.kern;
+                   << "kern:" << rhs.kern << ' '
+                   << "timed:" << rhs.timed << ' '
+                   << "late:" << rhs.late << ' '
+                   << "lateness:" << rhs.lateness << ' '
+                   << "thrt:" << rhs.thrt;
     }
 
     inline pfq_stats&
@@ -1245,6 +1542,11 @@ namespace pfq {
         lhs.frwd += rhs.frwd;
         lhs.kern += rhs.kern;
 
+        lhs.timed    += rhs.timed;
+        lhs.late     += rhs.late;
+        lhs.lateness += rhs.lateness;
+        lhs.thrt     += rhs.thrt;
+
         return lhs;
     }
 
@@ -1262,6 +1564,11 @@ namespace pfq {
         lhs.frwd -= rhs.frwd;
         lhs.kern -= rhs.kern;
 
+        lhs.timed    -= rhs.timed;
+        lhs.late     -= rhs.late;
+        lhs.lateness -= rhs.lateness;
+        lhs.thrt     -= rhs.thrt;
+
         return lhs;
     }
 
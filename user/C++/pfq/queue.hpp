@@ -61,7 +61,7 @@ namespace pfq {
             operator++()
             {
                 hdr_ = reinterpret_cast<pfq_pkthdr *>(
-                        reinterpret_cast<char *>(hdr_) + slot_size_);
+                        reinterpret_cast<char *>(hdr_) + (likely(slot_size_) ? slot_size_ : PFQ_SHARED_QUEUE_PKTHDR_STRIDE(hdr_)));
                 return *this;
             }
 
@@ -137,7 +137,7 @@ namespace pfq {
             operator++()
             {
                 hdr_ = reinterpret_cast<pfq_pkthdr *>(
-                        reinterpret_cast<char *>(hdr_) + slot_size_);
+                        reinterpret_cast<char *>(hdr_) + (likely(slot_size_) ? slot_size_ : PFQ_SHARED_QUEUE_PKTHDR_STRIDE(hdr_)));
                 return *this;
             }
 
@@ -200,6 +200,7 @@ namespace pfq {
         : addr_(nullptr)
         , slot_size_(0)
         , queue_len_(0)
+        , bytes_(0)
         , index_(0)
         {}
 
@@ -210,6 +211,18 @@ namespace pfq {
         : addr_(addr)
         , slot_size_(slot_size)
         , queue_len_(queue_len)
+        , bytes_(queue_len * slot_size)
+        , index_(index)
+        {}
+
+        //! Constructor (packed queue: slot_size is 0 and packets follow their stride)
+        //
+
+        net_queue(void *addr, size_t slot_size, size_t queue_len, size_t bytes, size_t index)
+        : addr_(addr)
+        , slot_size_(slot_size)
+        , queue_len_(queue_len)
+        , bytes_(bytes)
         , index_(index)
         {}
 
@@ -246,7 +259,7 @@ namespace pfq {
             return index_;
         }
 
-        //! Return the size of the queue slot, in bytes.
+        //! Return the size of the queue slot, in bytes (0 for packed queues).
 
         size_t
         slot_size() const
@@ -254,6 +267,14 @@ namespace pfq {
             return slot_size_;
         }
 
+        //! Return the number of bytes spanned by the packets.
+
+        size_t
+        bytes() const
+        {
+            return bytes_;
+        }
+
         //! Return the pointer to the packet.
 
         const void *
@@ -290,7 +311,7 @@ namespace pfq {
         end()
         {
             return iterator(reinterpret_cast<pfq_pkthdr *>(
-                        static_cast<char *>(addr_) + queue_len_ * slot_size_), slot_size_, index_);
+                        static_cast<char *>(addr_) + bytes_), slot_size_, index_);
         }
 
         //! Return a constant iterator past to the end of the queue.
@@ -299,7 +320,7 @@ namespace pfq {
         end() const
         {
             return const_iterator(reinterpret_cast<pfq_pkthdr *>(
-                        static_cast<char *>(addr_) + queue_len_ * slot_size_), slot_size_, index_);
+                        static_cast<char *>(addr_) + bytes_), slot_size_, index_);
         }
 
         //! Return a constant iterator to the first slot of an non-empty queue.
@@ -319,13 +340,14 @@ namespace pfq {
         cend() const
         {
             return const_iterator(reinterpret_cast<pfq_pkthdr *>(
-                        static_cast<char *>(addr_) + queue_len_ * slot_size_), slot_size_, index_);
+                        static_cast<char *>(addr_) + bytes_), slot_size_, index_);
         }
 
     private:
         void    *addr_;
         size_t  slot_size_;
         size_t  queue_len_;
+        size_t  bytes_;
         size_t  index_;
     };
 
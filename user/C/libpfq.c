@@ -181,6 +181,9 @@ pfq_open_group(unsigned long class_mask, int group_policy, size_t caplen, size_t
 	}
 
 	q->rx_slots = rx_slots;
+	q->rx_rings = 1;
+	q->rx_wakeup = 0;
+	q->rx_wakeup_pkts = 0;
 
 	/* set caplen */
 
@@ -308,7 +311,7 @@ const char *size_to_string(size_t size)
 int
 pfq_enable(pfq_t *q)
 {
-	size_t sock_mem; socklen_t size = sizeof(sock_mem);
+	size_t sock_mem, hdr_size; socklen_t size = sizeof(sock_mem);
 	char filename[256], *hugepages_mpoint;
         char *pfq_hugepages;
 
@@ -406,10 +409,19 @@ pfq_enable(pfq_t *q)
 		q->shm_hugepages_size = 0;
 	}
 
-	q->rx_queue_addr = (char *)(q->shm_addr) + sizeof(struct pfq_shared_queue);
+	/* the header is followed by the async Tx queues negotiated with the kernel */
+
+	hdr_size = PFQ_SHARED_QUEUE_HDR_SIZE(((struct pfq_shared_queue *)q->shm_addr)->tx_async_num);
+
+	q->rx_rings  = ((struct pfq_shared_queue *)q->shm_addr)->rx_ring_num;
+	q->rx_ring   = 0;
+	q->rx_packed = (int)((struct pfq_shared_queue *)q->shm_addr)->rx[0].packed;
+	memset(q->rx_used, 0, sizeof(q->rx_used));
+
+	q->rx_queue_addr = (char *)(q->shm_addr) + hdr_size;
 	q->rx_queue_size = q->rx_slots * q->rx_slot_size;
 
-	q->tx_queue_addr = (char *)(q->shm_addr) + sizeof(struct pfq_shared_queue) + q->rx_queue_size * 2;
+	q->tx_queue_addr = (char *)(q->shm_addr) + hdr_size + q->rx_queue_size * 2 * q->rx_rings;
 	q->tx_queue_size = q->tx_slots * q->tx_slot_size;
 
 	return Q_OK(q);
@@ -494,6 +506,28 @@ pfq_is_timestamping_enabled(pfq_t const *q)
 }
 
 
+int
+pfq_tx_zcopy_enable(pfq_t *q, int value)
+{
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_TX_ZCOPY, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: set zero-copy Tx mode");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_is_tx_zcopy_enabled(pfq_t const *q)
+{
+	int ret; socklen_t size = sizeof(int);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_TX_ZCOPY, &ret, &size) == -1) {
+	        return Q_ERROR(q, "PFQ: get zero-copy Tx mode");
+	}
+	return Q_VALUE(q, ret);
+}
+
+
 int
 pfq_set_weight(pfq_t *q, int value)
 {
@@ -629,6 +663,125 @@ pfq_set_rx_slots(pfq_t *q, size_t value)
 }
 
 
+int
+pfq_set_rx_rings(pfq_t *q, size_t value)
+{
+	int enabled = pfq_is_enabled(q);
+	if (enabled == 1) {
+		return Q_ERROR(q, "PFQ: enabled (Rx rings could not be set)");
+	}
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_RINGS, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx rings error");
+	}
+
+	q->rx_rings = value;
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_rx_rings(pfq_t const *q)
+{
+	size_t ret; socklen_t size = sizeof(ret);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_RINGS, &ret, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get Rx rings error");
+	}
+	return Q_VALUE(q, (int)ret);
+}
+
+
+int
+pfq_set_rx_packed(pfq_t *q, int value)
+{
+	int enabled = pfq_is_enabled(q);
+	if (enabled == 1) {
+		return Q_ERROR(q, "PFQ: enabled (Rx packed slots could not be set)");
+	}
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_PACKED, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx packed error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_rx_packed(pfq_t const *q)
+{
+	int ret; socklen_t size = sizeof(ret);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_PACKED, &ret, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get Rx packed error");
+	}
+	return Q_VALUE(q, ret);
+}
+
+
+int
+pfq_set_rx_backpressure(pfq_t *q, int hold, unsigned int hold_usec, unsigned int watermark)
+{
+	struct pfq_so_rx_backpressure bp = { hold, hold_usec, watermark };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_BACKPRESSURE, &bp, sizeof(bp)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx back-pressure error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_rx_backpressure(pfq_t const *q, int *hold, unsigned int *hold_usec, unsigned int *watermark)
+{
+	struct pfq_so_rx_backpressure bp; socklen_t size = sizeof(bp);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_BACKPRESSURE, &bp, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get Rx back-pressure error");
+	}
+
+	if (hold)
+		*hold = bp.hold;
+	if (hold_usec)
+		*hold_usec = bp.hold_usec;
+	if (watermark)
+		*watermark = bp.watermark;
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_set_rx_wakeup(pfq_t *q, unsigned int packets, unsigned int usec)
+{
+	struct pfq_so_rx_wakeup wk = { packets, usec };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_WAKEUP, &wk, sizeof(wk)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx wakeup error");
+	}
+
+	q->rx_wakeup = packets || usec;
+	q->rx_wakeup_pkts = packets;
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_rx_wakeup(pfq_t const *q, unsigned int *packets, unsigned int *usec)
+{
+	struct pfq_so_rx_wakeup wk; socklen_t size = sizeof(wk);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_WAKEUP, &wk, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get Rx wakeup error");
+	}
+
+	if (packets)
+		*packets = wk.packets;
+	if (usec)
+		*usec = wk.usec;
+
+	return Q_OK(q);
+}
+
+
 int
 pfq_set_tx_slots(pfq_t *q, size_t value)
 {
@@ -652,6 +805,32 @@ pfq_get_tx_slots(pfq_t const *q)
 }
 
 
+int
+pfq_set_tx_queues(pfq_t *q, size_t value)
+{
+	int enabled = pfq_is_enabled(q);
+	if (enabled == 1) {
+		return Q_ERROR(q, "PFQ: enabled (Tx queues could not be set)");
+	}
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_TX_QUEUES, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: set Tx queues error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_tx_queues(pfq_t const *q)
+{
+	size_t ret; socklen_t size = sizeof(ret);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_TX_QUEUES, &ret, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get Tx queues error");
+	}
+	return Q_VALUE(q, (int)ret);
+}
+
+
 size_t
 pfq_get_rx_slot_size(pfq_t const *q)
 {
@@ -1393,6 +1572,26 @@ pfq_group_fprog_reset(pfq_t *q, int gid)
 }
 
 
+int
+pfq_group_ebpf(pfq_t *q, int gid, int fd, int mode)
+{
+	struct pfq_so_ebpf ebpf = { .gid = gid, .fd = fd, .mode = mode };
+
+        if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_EBPF, &ebpf, sizeof(ebpf)) == -1) {
+		return Q_ERROR(q, "PFQ: set group eBPF program error");
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_group_ebpf_reset(pfq_t *q, int gid)
+{
+	return pfq_group_ebpf(q, gid, -1, Q_EBPF_FILTER);
+}
+
+
 int
 pfq_join_group(pfq_t *q, int gid, unsigned long class_mask, int group_policy)
 {
@@ -1519,54 +1718,146 @@ int pfq_vlan_reset_filter(pfq_t *q, int gid, int vid)
 }
 
 
+/* round-robin over the Rx rings: the first non-empty ring after the last one read */
+
+static size_t
+pfq_rx_ring_select(pfq_t *q, struct pfq_shared_queue *qd, unsigned long int *data)
+{
+	size_t n, ring = q->rx_ring;
+
+	*data = 0;
+
+	for(n = 0; n < q->rx_rings; n++)
+	{
+		if (++ring == q->rx_rings)
+			ring = 0;
+
+		*data = __atomic_load_n(&qd->rx[ring].shinfo, __ATOMIC_RELAXED);
+		if (PFQ_SHARED_QUEUE_LEN(*data))
+			break;
+	}
+
+	return ring;
+}
+
+
+/* batched wakeups: a ring already holding a batch (or full) is read without polling */
+
+static inline int
+pfq_rx_ring_readable(pfq_t const *q, unsigned long int data)
+{
+	size_t len = PFQ_SHARED_QUEUE_LEN(data);
+
+	if (q->rx_packed)
+		return len > q->rx_queue_size - q->rx_slot_size;
+
+	return len >= q->rx_slots || (q->rx_wakeup_pkts != 0 && len >= q->rx_wakeup_pkts);
+}
+
+
+/* packed Rx queue: walk the packets reserved by the producers, waiting for their
+ * commit; a packet starts only where a full slot fits (as in the kernel) */
+
+static size_t
+pfq_rx_packed_walk(pfq_t *q, char *queue, size_t reserved, uint32_t index, size_t *bytes)
+{
+	const size_t limit = q->rx_queue_size - q->rx_slot_size;
+	size_t off = 0, n = 0;
+
+	while (off < reserved && off <= limit)
+	{
+		struct pfq_pkthdr *hdr = (struct pfq_pkthdr *)(queue + off);
+
+		while (__atomic_load_n(&hdr->info.commit, __ATOMIC_ACQUIRE) != index)
+			pfq_relax();
+
+		off += PFQ_SHARED_QUEUE_PKTHDR_STRIDE(hdr);
+		n++;
+	}
+
+	*bytes = off;
+	return n;
+}
+
+
 int
 pfq_read(pfq_t *q, struct pfq_net_queue *nq, long int microseconds)
 {
 	struct pfq_shared_queue * qd = (struct pfq_shared_queue *)(q->shm_addr);
 	unsigned long int data, qver;
+	char * ring_addr;
+	size_t ring;
 
         if (unlikely(qd == NULL)) {
 		return Q_ERROR(q, "PFQ: read: socket not enabled");
 	}
 
-	data = __atomic_load_n(&qd->rx.shinfo, __ATOMIC_RELAXED);
+	ring = pfq_rx_ring_select(q, qd, &data);
+
+	/* batched wakeups: unless a ring is readable, wait for the kernel to report the socket readable */
+
+	if (q->rx_wakeup && !pfq_rx_ring_readable(q, data)) {
+		if (pfq_poll(q, microseconds) < 0)
+			return Q_ERROR(q, "PFQ: poll error");
+		ring = pfq_rx_ring_select(q, qd, &data);
+	}
 
-	if (unlikely(PFQ_SHARED_QUEUE_LEN(data) == 0)) {
+	if (unlikely(PFQ_SHARED_QUEUE_LEN(data) == 0 && !q->rx_wakeup)) {
 #ifdef PFQ_USE_POLL
 		if (pfq_poll(q, microseconds) < 0)
 			return Q_ERROR(q, "PFQ: poll error");
+		ring = pfq_rx_ring_select(q, qd, &data);
 #else
 		(void)microseconds;
 		nq->len = 0;
+		nq->bytes = 0;
 		return Q_VALUE(q, (int)0);
 #endif
 	}
 
-        /* at wrap-around reset Rx slots... */
+        /* at wrap-around reset Rx slots (packed queues at every swap, over the bytes
+	 * used last time: a header may land on the stale payload of a previous round)... */
 
 	qver = PFQ_SHARED_QUEUE_VER(data);
+	ring_addr = (char *)(q->rx_queue_addr) + ring * q->rx_queue_size * 2;
 
-        if (unlikely(((qver+1) & (PFQ_SHARED_QUEUE_VER_MASK^1))== 0))
+        if (unlikely(((qver+1) & (PFQ_SHARED_QUEUE_VER_MASK^1))== 0) || q->rx_packed)
         {
-            char * raw = (char *)(q->rx_queue_addr) + ((qver+1) & 1) * q->rx_queue_size;
+            char * raw = ring_addr + ((qver+1) & 1) * q->rx_queue_size;
             char * end = raw + q->rx_queue_size;
+            const size_t step = q->rx_packed ? PFQ_SLOT_ALIGNMENT : q->rx_slot_size;
             const pfq_qver_t rst = qver & 1;
-            for(; raw < end; raw += q->rx_slot_size)
+
+            if (likely(((qver+1) & (PFQ_SHARED_QUEUE_VER_MASK^1)) != 0))
+                end = raw + q->rx_used[ring];
+
+            for(; raw < end; raw += step)
                 ((struct pfq_pkthdr *)raw)->info.commit = rst;
         }
 
 	/* swap the queue... */
 
-        data = __atomic_exchange_n(&qd->rx.shinfo, ((qver+1) << (PFQ_SHARED_QUEUE_LEN_SIZE<<3)), __ATOMIC_RELAXED);
+        data = __atomic_exchange_n(&qd->rx[ring].shinfo, ((qver+1) << (PFQ_SHARED_QUEUE_LEN_SIZE<<3)), __ATOMIC_RELAXED);
+
+	q->rx_ring = ring;
 
-	size_t queue_len = min(PFQ_SHARED_QUEUE_LEN(data), q->rx_slots);
+	if (q->rx_packed)
+		q->rx_used[ring] = min(PFQ_SHARED_QUEUE_LEN(data), q->rx_queue_size);
 
-	nq->queue = (char *)(q->rx_queue_addr) + (qver & 1) * q->rx_queue_size;
+	nq->queue = ring_addr + (qver & 1) * q->rx_queue_size;
 	nq->index = (unsigned int)qver;
-	nq->len   = queue_len;
-        nq->slot_size = q->rx_slot_size;
 
-	return Q_VALUE(q, (int)queue_len);
+	if (q->rx_packed) {
+		nq->len = pfq_rx_packed_walk(q, nq->queue, PFQ_SHARED_QUEUE_LEN(data), nq->index, &nq->bytes);
+		nq->slot_size = 0;
+	}
+	else {
+		nq->len   = min(PFQ_SHARED_QUEUE_LEN(data), q->rx_slots);
+		nq->bytes = nq->len * q->rx_slot_size;
+		nq->slot_size = q->rx_slot_size;
+	}
+
+	return Q_VALUE(q, (int)nq->len);
 }
 
 
@@ -1580,7 +1871,7 @@ pfq_recv(pfq_t *q, void *buf, size_t buflen, struct pfq_net_queue *nq, long int
 	if (pfq_read(q, nq, microseconds) < 0)
 		return -1;
 
-	memcpy(buf, nq->queue, q->rx_slot_size * nq->len);
+	memcpy(buf, nq->queue, nq->bytes);
 	return Q_OK(q);
 }
 
@@ -1642,6 +1933,18 @@ pfq_unbind_tx(pfq_t *q)
 }
 
 
+int
+pfq_set_tx_rate(pfq_t *q, int queue, unsigned long pps, unsigned long bps, unsigned int burst_pkts, unsigned int burst_bytes)
+{
+	struct pfq_so_tx_rate rate = { queue, pps, bps, burst_pkts, burst_bytes };
+
+        if (setsockopt(q->fd, PF_Q, Q_SO_TX_RATE, &rate, sizeof(rate)) == -1)
+		return Q_ERROR(q, "PFQ: Tx rate error");
+
+	return Q_OK(q);
+}
+
+
 int
 pfq_send_raw( pfq_t *q
 	    , const void *buf
@@ -1677,6 +1980,12 @@ pfq_send_raw( pfq_t *q
 
 	index = __atomic_load_n(&tx->cons.index, __ATOMIC_RELAXED);
 	if (index == __atomic_load_n(&tx->prod.index, __ATOMIC_RELAXED)) {
+
+		/* zero-copy: the next half is still referenced by the driver */
+
+		if (__atomic_load_n(&tx->zcopy.pending[(index+1) & 1], __ATOMIC_ACQUIRE))
+			return Q_VALUE(q, 0);
+
 		++index;
 		poff_addr = (index & 1) ? &tx->prod.off1 : &tx->prod.off0;
                 __atomic_store_n(poff_addr, 0, __ATOMIC_RELEASE);
@@ -1700,6 +2009,16 @@ pfq_send_raw( pfq_t *q
 		hdr->info.data.copies  = copies;
 		__builtin_memcpy(hdr+1, buf, caplen);
                 __atomic_store_n(poff_addr, offset + (ptrdiff_t)q->tx_slot_size, __ATOMIC_RELEASE);
+
+		/* kick the Tx thread, if parked */
+
+		if (tss >= 0) {
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&tx->cons.kick, __ATOMIC_RELAXED) &&
+			    __atomic_exchange_n(&tx->cons.kick, 0, __ATOMIC_RELAXED))
+				pfq_sync_queue(q, tss + 1);
+		}
+
 		return Q_VALUE(q, (int)len);
 	}
 
@@ -26,6 +26,8 @@
 
 #include <stddef.h>
 
+#include <linux/pf_q.h>
+
 /*! PFQ descriptor. */
 
 typedef struct pfq_data_int pfq_t;
@@ -41,7 +43,8 @@ struct pfq_net_queue
 {
 	pfq_iterator_t queue;		/* net queue */
 	size_t         len;		/* number of packets in the queue */
-	size_t         slot_size;
+	size_t         bytes;		/* bytes spanned by the packets */
+	size_t         slot_size;	/* 0 for packed queues (variable-length slots) */
 	uint32_t       index;		/* current queue index */
 };
 
@@ -65,6 +68,13 @@ struct pfq_data_int
 	size_t rx_slots;
 	size_t rx_slot_size;
 
+	size_t rx_rings;
+	size_t rx_ring;		/* last Rx ring read */
+	size_t rx_used[Q_MAX_RX_RINGS];	/* packed queues: bytes reserved in the last half read of each ring */
+	int    rx_packed;
+	int    rx_wakeup;	/* batched Rx wakeups: read waits for the socket to be readable */
+	unsigned int rx_wakeup_pkts;
+
         size_t tx_slots;
 	size_t tx_slot_size;
 
@@ -50,6 +50,7 @@ pfq_net_queue_init(struct pfq_net_queue *nq)
 {
 	nq->queue     = NULL;
 	nq->len	      = 0;
+	nq->bytes     = 0;
 	nq->slot_size = 0;
 	nq->index     = 0;
 }
@@ -69,19 +70,21 @@ static inline
 pfq_iterator_t
 pfq_net_queue_end(struct pfq_net_queue const *nq)
 {
-        return nq->queue + nq->len * nq->slot_size;
+        return nq->queue + nq->bytes;
 }
 
-/*! Return an iterator to the next slot. */
+/*! Return an iterator to the next slot (packed queues follow the stride of the packet). */
 
 static inline
 pfq_iterator_t
 pfq_net_queue_next(struct pfq_net_queue const *nq, pfq_iterator_t iter)
 {
-        return iter + nq->slot_size;
+        if (likely(nq->slot_size != 0))
+                return iter + nq->slot_size;
+        return iter + PFQ_SHARED_QUEUE_PKTHDR_STRIDE((struct pfq_pkthdr const *)iter);
 }
 
-/*! Return an iterator to the previous slot. */
+/*! Return an iterator to the previous slot (fixed-size slots only). */
 
 static inline
 pfq_iterator_t
@@ -323,15 +326,36 @@ extern int pfq_is_enabled(pfq_t const *q);
 
 
 /*! Enable/disable timestamping for packets. */
+/*!
+ * The value selects the source of the Rx timestamp: Q_TSTAMP_OFF, Q_TSTAMP_SW (1),
+ * Q_TSTAMP_HW_RAW (NIC clock) or Q_TSTAMP_HW_SYS (NIC time in the system clock).
+ * Hardware timestamps require the NIC to be configured (SIOCSHWTSTAMP); packets
+ * not stamped by the NIC carry the software timestamp. The timestamp is stored
+ * in the packet header as 64-bit nanoseconds (see PFQ_PKTHDR_TSTAMP_SEC/NSEC).
+ */
 
 extern int pfq_timestamping_enable(pfq_t *q, int value);
 
 
-/*! Check whether timestamping for packets is enabled. */
+/*! Return the source of the Rx timestamp (Q_TSTAMP_OFF if disabled). */
 
 extern int pfq_is_timestamping_enabled(pfq_t const *q);
 
 
+/*! Enable/disable zero-copy transmission from the shared Tx queues. */
+/*!
+ * Packets are referenced by the driver rather than copied: a half of
+ * the Tx queue is reused only when the driver has released all its packets.
+ */
+
+extern int pfq_tx_zcopy_enable(pfq_t *q, int value);
+
+
+/*! Check whether zero-copy transmission is enabled. */
+
+extern int pfq_is_tx_zcopy_enabled(pfq_t const *q);
+
+
 /*! Set the weight of the socket for the steering phase. */
 
 extern int pfq_set_weight(pfq_t *q, int value);
@@ -376,6 +400,71 @@ extern int pfq_set_rx_slots(pfq_t *q, size_t value);
 extern size_t pfq_get_rx_slots(pfq_t const *q);
 
 
+/*! Specify the number of Rx rings (to be set before the socket is enabled). */
+/*!
+ * Each ring is fed by the cpus n with n % rings == index: with one ring per
+ * Rx cpu the producers never share a cache line. pfq_read serves the rings
+ * in round-robin; the number of slots is per ring.
+ */
+
+extern int pfq_set_rx_rings(pfq_t *q, size_t value);
+
+
+/*! Return the number of Rx rings of the socket. */
+
+extern int pfq_get_rx_rings(pfq_t const *q);
+
+
+/*! Enable/disable packed Rx slots (to be set before the socket is enabled). */
+/*!
+ * Packets are stored back-to-back, each taking PFQ_SHARED_QUEUE_SLOT_SIZE(caplen)
+ * bytes of the queue: small packets no longer consume a full slot. The memory
+ * of the queue is unchanged (Rx slots * slot size); the net queue iterators
+ * follow the stride of each packet. Space reserved for packets the kernel
+ * failed to copy is filled with empty headers (caplen and len 0).
+ */
+
+extern int pfq_set_rx_packed(pfq_t *q, int value);
+
+
+/*! Return 1 if the Rx slots are packed, 0 otherwise. */
+
+extern int pfq_get_rx_packed(pfq_t const *q);
+
+
+/*! Set the batched Rx wakeups of the socket. */
+/*!
+ * The socket becomes readable (poll/epoll on pfq_get_fd) when packets packets
+ * are pending, or when the oldest pending packet has waited usec microseconds
+ * (0 disables each condition; both 0 restore the default: readable as soon as
+ * a packet is queued). With batched wakeups enabled, pfq_read waits for the
+ * socket to be readable, up to its timeout.
+ */
+
+extern int pfq_set_rx_wakeup(pfq_t *q, unsigned int packets, unsigned int usec);
+
+
+/*! Get the batched Rx wakeups of the socket (NULL arguments are ignored). */
+
+extern int pfq_get_rx_wakeup(pfq_t const *q, unsigned int *packets, unsigned int *usec);
+
+
+/*! Set the Rx back-pressure of the socket. */
+/*!
+ * With hold enabled, the packets that do not fit the Rx queue are copied
+ * and held by the kernel (per cpu, up to a bounded number) for at most
+ * hold_usec microseconds (up to 1 second), then redelivered in order. Watermark (percent
+ * of the Rx queue, 0 = off) wakes up the consumer as the queue fills above it.
+ */
+
+extern int pfq_set_rx_backpressure(pfq_t *q, int hold, unsigned int hold_usec, unsigned int watermark);
+
+
+/*! Get the Rx back-pressure of the socket (NULL arguments are ignored). */
+
+extern int pfq_get_rx_backpressure(pfq_t const *q, int *hold, unsigned int *hold_usec, unsigned int *watermark);
+
+
 /*! Return the size of a Rx slot, in bytes. */
 
 extern size_t pfq_get_rx_slot_size(pfq_t const *q);
@@ -391,6 +480,20 @@ extern int pfq_set_tx_slots(pfq_t *q, size_t value);
 extern size_t pfq_get_tx_slots(pfq_t const *q);
 
 
+/*! Specify the number of async Tx queues (one per Tx thread binding). */
+/*!
+ * The default is Q_DEF_TX_QUEUES (max Q_MAX_TX_QUEUES). It must be set
+ * before the socket is enabled, and before any queue is bound to a Tx thread.
+ */
+
+extern int pfq_set_tx_queues(pfq_t *q, size_t value);
+
+
+/*! Return the number of async Tx queues of the socket. */
+
+extern int pfq_get_tx_queues(pfq_t const *q);
+
+
 /*! Return the size of a Tx slot, in bytes. */
 
 extern size_t pfq_get_tx_slots(pfq_t const *q);
@@ -457,6 +560,17 @@ extern int pfq_bind_tx(pfq_t *q, const char *dev, int queue, int core);
 extern int pfq_unbind_tx(pfq_t *q);
 
 
+/*! Set the rate of a Tx queue of the socket. */
+/*!
+ * The kernel shapes the given Tx queue (Q_NO_KTHREAD for the synchronous queue,
+ * 0.. for the async queues, in binding order) with a token bucket: 'pps' packets
+ * per second and/or 'bps' bits per second (0 means unlimited), with a bucket
+ * depth of 'burst_pkts' packets and 'burst_bytes' bytes.
+ */
+
+extern int pfq_set_tx_rate(pfq_t *q, int queue, unsigned long pps, unsigned long bps, unsigned int burst_pkts, unsigned int burst_bytes);
+
+
 /*! Join the group with the given class mask and group policy */
 
 extern int pfq_join_group(pfq_t *q, int gid, unsigned long class_mask, int group_policy);
@@ -516,6 +630,22 @@ extern int pfq_group_fprog(pfq_t *q, int gid, struct sock_fprog const *);
 extern int pfq_group_fprog_reset(pfq_t *q, int gid);
 
 
+/*! Attach an eBPF program (BPF_PROG_TYPE_SOCKET_FILTER) to the given group. */
+/*!
+ * The program is passed by file descriptor. Its return value is used according
+ * to the mode: Q_EBPF_FILTER (0 drops the packet), Q_EBPF_STEER (steering hash)
+ * or Q_EBPF_CLASS (class mask). In the last two cases 0 drops the packet, and
+ * the fanout can be refined by the pfq-lang computation of the group.
+ */
+
+extern int pfq_group_ebpf(pfq_t *q, int gid, int fd, int mode);
+
+
+/*! Detach the eBPF program from the given group. */
+
+extern int pfq_group_ebpf_reset(pfq_t *q, int gid);
+
+
 /*! Enable/disable vlan filtering for the given group. */
 
 extern int pfq_vlan_filters_enable(pfq_t *q, int gid, int toggle);
@@ -605,6 +735,10 @@ extern int pfq_get_group_counters(pfq_t const *q, int gid, struct pfq_counters *
 
 
 /*! Transmit the packets in the queue. */
+/*!
+ * 'queue = 0' transmits the queue of the socket enabled for synchronous
+ * transmission; 'queue = n' wakes up the Tx thread of the async queue n-1.
+ */
 
 extern int pfq_sync_queue(pfq_t *q, int queue);
 
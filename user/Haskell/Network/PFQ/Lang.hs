@@ -50,6 +50,8 @@ module Network.PFQ.Lang
 
       IPv4(..)
     , CIDR(..)
+    , IPv6(..)
+    , CIDR6(..)
     , Argument(..)
     , Pretty(..)
     , Function(..)
@@ -153,6 +155,8 @@ instance FromJSON Argument where
         | type_ == "Word8"  -> (ArgData :: Word8  -> Argument)     <$>  (v .: "argValue")
         | type_ == "IPv4"   -> (ArgData :: IPv4   -> Argument)     <$>  (v .: "argValue")
         | type_ == "CIDR"   -> (ArgData :: CIDR   -> Argument)     <$>  (v .: "argValue")
+        | type_ == "IPv6"   -> (ArgData :: IPv6   -> Argument)     <$>  (v .: "argValue")
+        | type_ == "CIDR6"  -> (ArgData :: CIDR6  -> Argument)     <$>  (v .: "argValue")
         | type_ == "String" -> (ArgString :: String -> Argument)   <$>  (v .: "argValue")
         | type_ == "Fun"    -> (ArgFunPtr :: Int    -> Argument)   <$>  (v .: "argValue")
         | "[" `isPrefixOf` type_ ->
@@ -168,6 +172,8 @@ instance FromJSON Argument where
                 | type_ == "[Word8]"  -> (ArgVector  :: [Word8]  -> Argument) <$> (v .: "argValue")
                 | type_ == "[IPv4]"   -> (ArgVector  :: [IPv4]   -> Argument) <$> (v .: "argValue")
                 | type_ == "[CIDR]"   -> (ArgVector  :: [CIDR]   -> Argument) <$> (v .: "argValue")
+                | type_ == "[IPv6]"   -> (ArgVector  :: [IPv6]   -> Argument) <$> (v .: "argValue")
+                | type_ == "[CIDR6]"  -> (ArgVector  :: [CIDR6]  -> Argument) <$> (v .: "argValue")
                 | type_ == "[String]" -> (ArgStrings :: [String] -> Argument) <$> (v .: "argValue")
                 | otherwise -> error $ "FromJSON: Argument type " ++ type_ ++ " not supported!"
         | null type_          -> return ArgNull
@@ -36,9 +36,11 @@ module Network.PFQ.Lang.Default
       -- | Collection of predicates used in conditional expressions.
 
       is_ip
+    , is_ip6
     , is_udp
     , is_tcp
     , is_icmp
+    , is_icmp6
     , is_flow
     , is_l3_proto
     , is_l4_proto
@@ -59,6 +61,9 @@ module Network.PFQ.Lang.Default
     , has_addr
     , has_src_addr
     , has_dst_addr
+    , has_addr6
+    , has_src_addr6
+    , has_dst_addr6
 
     , has_state
     , has_mark
@@ -128,9 +133,11 @@ module Network.PFQ.Lang.Default
 
     , Network.PFQ.Lang.Default.filter
     , ip
+    , ip6
     , udp
     , tcp
     , icmp
+    , icmp6
     , vlan
     , l3_proto
     , l4_proto
@@ -148,6 +155,9 @@ module Network.PFQ.Lang.Default
     , addr
     , src_addr
     , dst_addr
+    , addr6
+    , src_addr6
+    , dst_addr6
 
         -- * Steering functions
         -- | Monadic functions used to dispatch packets across sockets.
@@ -163,7 +173,9 @@ module Network.PFQ.Lang.Default
     , steer_p2p
     , double_steer_ip
     , steer_local_ip
+    , steer_local_ip6
     , steer_flow
+    , steer_flow_hash
     , steer_local_net
     , steer_field
     , double_steer_field
@@ -197,6 +209,12 @@ module Network.PFQ.Lang.Default
     , bloom_filter
     , bloom_src_filter
     , bloom_dst_filter
+    , bloom6
+    , bloom6_src
+    , bloom6_dst
+    , bloom6_filter
+    , bloom6_src_filter
+    , bloom6_dst_filter
     , bloomCalcN
     , bloomCalcM
     , bloomCalcP
@@ -213,6 +231,7 @@ module Network.PFQ.Lang.Default
 
 
 import           Network.PFQ.Lang
+import           Network.PFQ.Types (inet6AtoN)
 
 import           Data.Word
 
@@ -311,6 +330,9 @@ p `all_bit` x = Predicate "all_bit" p x () () () () () ()
 -- | Evaluate to /True/ if the Qbuff is an IPv4 packet.
 is_ip = Predicate "is_ip" () () () () () () () ()
 
+-- | Evaluate to /True/ if the Qbuff is an IPv6 packet.
+is_ip6 = Predicate "is_ip6" () () () () () () () ()
+
 -- | Evaluate to /True/ if the Qbuff is an UDP packet.
 is_udp = Predicate "is_udp" () () () () () () () ()
 
@@ -320,6 +342,9 @@ is_tcp = Predicate "is_tcp" () () () () () () () ()
 -- | Evaluate to /True/ if the Qbuff is an ICMP packet.
 is_icmp = Predicate "is_icmp" () () () () () () () ()
 
+-- | Evaluate to /True/ if the Qbuff is an ICMPv6 packet.
+is_icmp6 = Predicate "is_icmp6" () () () () () () () ()
+
 -- | Evaluate to /True/ if the Qbuff is an UDP or TCP packet.
 is_flow = Predicate "is_flow" () () () () () () () ()
 
@@ -413,6 +438,23 @@ has_addr a       = Predicate "has_addr"     a () () () () () () ()
 has_src_addr a   = Predicate "has_src_addr" a () () () () () () ()
 has_dst_addr a   = Predicate "has_dst_addr" a () () () () () () ()
 
+-- | Evaluate to /True/ if the source or destination IPv6 address matches the given network address. I.e.,
+--
+-- > has_addr6 "2001:db8::/32"
+-- > has_addr6 (CIDR6 ("2001:db8::", 32))
+
+has_addr6 :: CIDR6 -> NetPredicate
+
+-- | Evaluate to /True/ if the source IPv6 address matches the given network address.
+has_src_addr6 :: CIDR6 -> NetPredicate
+
+-- | Evaluate to /True/ if the destination IPv6 address matches the given network address.
+has_dst_addr6 :: CIDR6 -> NetPredicate
+
+has_addr6 a      = Predicate "has_addr6"     a () () () () () () ()
+has_src_addr6 a  = Predicate "has_src_addr6" a () () () () () () ()
+has_dst_addr6 a  = Predicate "has_dst_addr6" a () () () () () () ()
+
 -- | Evaluate to the mark set by 'mark' function. By default packets are marked with 0.
 get_mark = Property "get_mark" () () () () () () () ()
 
@@ -533,6 +575,12 @@ double_steer_ip = Function "double_steer_ip" () () () () () () () () :: NetFunct
 steer_local_ip :: CIDR -> NetFunction
 steer_local_ip d = Function "steer_local_ip" d () () () () () () () :: NetFunction
 
+-- | IPv6 counterpart of 'steer_local_ip'.
+--
+-- > steer_local_ip6 "2001:db8::/32"
+steer_local_ip6 :: CIDR6 -> NetFunction
+steer_local_ip6 d = Function "steer_local_ip6" d () () () () () () () :: NetFunction
+
 -- | Dispatch the packet across the sockets
 -- with a randomized algorithm that guarantees
 -- TCP/UDP flows consistency.
@@ -540,6 +588,14 @@ steer_local_ip d = Function "steer_local_ip" d () () () () () () () :: NetFuncti
 -- > steer_flow >-> log_msg "Steering a flow"
 steer_flow = Function "steer_flow" () () () () () () () () :: NetFunction
 
+-- | Like 'steer_flow', with the given hash family:
+-- 0 (xor, as steer_flow), 1 (symmetric Toeplitz, as NIC RSS) or
+-- 2 (keyed symmetric multiply-xorshift).
+--
+-- > steer_flow_hash 1
+steer_flow_hash :: Int -> NetFunction
+steer_flow_hash h = Function "steer_flow_hash" h () () () () () () () :: NetFunction
+
 -- | Dispatch the packet across the sockets
 -- with a randomized algorithm that guarantees
 -- RTP/RTCP flows consistency.
@@ -607,6 +663,9 @@ filter p = Function "filter" p () () () () () () ()
 -- | Evaluate to /Pass Qbuff/ if it is an IPv4 packet, /Drop/ it otherwise.
 ip = Function "ip" () () () () () () () () :: NetFunction
 
+-- | Evaluate to /Pass Qbuff/ if it is an IPv6 packet, /Drop/ it otherwise.
+ip6 = Function "ip6" () () () () () () () () :: NetFunction
+
 -- | Evaluate to /Pass Qbuff/ if it is an UDP packet, /Drop/ it otherwise.
 udp = Function "udp" () () () () () () () () :: NetFunction
 
@@ -616,6 +675,9 @@ tcp = Function "tcp" () () () () () () () () :: NetFunction
 -- | Evaluate to /Pass Qbuff/ if it is an ICMP packet, /Drop/ it otherwise.
 icmp = Function "icmp" () () () () () () () () :: NetFunction
 
+-- | Evaluate to /Pass Qbuff/ if it is an ICMPv6 packet, /Drop/ it otherwise.
+icmp6 = Function "icmp6" () () () () () () () () :: NetFunction
+
 -- | Evaluate to /Pass Qbuff/ if it has a vlan tag, /Drop/ it otherwise.
 vlan = Function "vlan" () () () () () () () () :: NetFunction
 
@@ -817,6 +879,21 @@ addr net   = Function "addr" net () () () () () () ()
 src_addr net = Function "src_addr" net () () () () () () ()
 dst_addr net = Function "dst_addr" net () () () () () () ()
 
+-- | Monadic version of 'has_addr6' predicate.
+--
+-- > addr6 "2001:db8::/32" >-> log_packet
+addr6 :: CIDR6 -> NetFunction
+
+-- | Monadic version of 'has_src_addr6' predicate.
+src_addr6 :: CIDR6 -> NetFunction
+
+-- | Monadic version of 'has_dst_addr6' predicate.
+dst_addr6 :: CIDR6 -> NetFunction
+
+addr6 net     = Function "addr6" net () () () () () () ()
+src_addr6 net = Function "src_addr6" net () () () () () () ()
+dst_addr6 net = Function "dst_addr6" net () () () () () () ()
+
 -- | Conditional execution of monadic NetFunctions.
 --
 -- The function takes a predicate and evaluates to given the NetFunction when it evalutes to /True/,
@@ -928,6 +1005,40 @@ bloom_filter m hs p     = let ips = unsafePerformIO (mapM inet_addr hs) in Funct
 bloom_src_filter m hs p = let ips = unsafePerformIO (mapM inet_addr hs) in Function "bloom_src_filter" m ips p () () () () ()
 bloom_dst_filter m hs p = let ips = unsafePerformIO (mapM inet_addr hs) in Function "bloom_dst_filter" m ips p () () () () ()
 
+-- | IPv6 counterpart of 'bloom': the addresses are IPv6 and the prefix ranges in [0,128].
+--
+-- > when (bloom6 1024 ["2001:db8::1", "2001:db8::2"] 128) log_packet >-> kernel
+{-# NOINLINE bloom6 #-}
+bloom6 :: Int -> [HostName] -> Int -> NetPredicate
+
+-- | IPv6 counterpart of 'bloom_src'.
+{-# NOINLINE bloom6_src #-}
+bloom6_src :: Int -> [HostName] -> Int -> NetPredicate
+
+-- | IPv6 counterpart of 'bloom_dst'.
+{-# NOINLINE bloom6_dst #-}
+bloom6_dst :: Int -> [HostName] -> Int -> NetPredicate
+
+-- | Monadic counterpart of 'bloom6' function.
+{-# NOINLINE bloom6_filter #-}
+bloom6_filter :: Int -> [HostName] -> Int -> NetFunction
+
+-- | Monadic counterpart of 'bloom6_src' function.
+{-# NOINLINE bloom6_src_filter #-}
+bloom6_src_filter :: Int -> [HostName] -> Int -> NetFunction
+
+-- | Monadic counterpart of 'bloom6_dst' function.
+{-# NOINLINE bloom6_dst_filter #-}
+bloom6_dst_filter :: Int -> [HostName] -> Int -> NetFunction
+
+bloom6 m hs p     = let ips = unsafePerformIO (mapM inet6AtoN hs) in Predicate "bloom6" m ips p () () () () ()
+bloom6_src m hs p = let ips = unsafePerformIO (mapM inet6AtoN hs) in Predicate "bloom6_src" m ips p () () () () ()
+bloom6_dst m hs p = let ips = unsafePerformIO (mapM inet6AtoN hs) in Predicate "bloom6_dst" m ips p () () () () ()
+
+bloom6_filter m hs p     = let ips = unsafePerformIO (mapM inet6AtoN hs) in Function "bloom6_filter" m ips p () () () () ()
+bloom6_src_filter m hs p = let ips = unsafePerformIO (mapM inet6AtoN hs) in Function "bloom6_src_filter" m ips p () () () () ()
+bloom6_dst_filter m hs p = let ips = unsafePerformIO (mapM inet6AtoN hs) in Function "bloom6_dst_filter" m ips p () () () () ()
+
 -- bloom filter, utility functions:
 
 bloomK = 4
@@ -37,8 +37,12 @@ module Network.PFQ.Types
   (
     IPv4(..)
   , CIDR(..)
+  , IPv6(..)
+  , CIDR6(..)
   , inetAtoN
   , inetNtoA
+  , inet6AtoN
+  , inet6NtoA
   ) where
 
 import GHC.Generics
@@ -46,6 +50,7 @@ import GHC.Generics
 import Data.Aeson
 import Data.Typeable
 import Data.String
+import Data.Word
 import Data.List
 import Data.Maybe (isJust, fromJust)
 import Control.Monad (when)
@@ -67,6 +72,7 @@ import Foreign.C.Types
 import Foreign.C.String
 import Foreign.Ptr
 import Foreign.Marshal.Alloc
+import Foreign.Marshal.Array
 
 
 -- | IPv4 data type
@@ -108,6 +114,56 @@ instance ToJSON CIDR
 instance FromJSON CIDR
 
 
+-- | IPv6 data type (16 bytes, network byte order)
+
+newtype IPv6 = IPv6 { getHostAddress6 :: [Word8] } deriving (Generic, Typeable)
+
+instance IsString IPv6 where
+  fromString xs = unsafePerformIO $ inet6AtoN xs
+
+instance Show IPv6 where
+    show a = unsafePerformIO $ inet6NtoA a
+
+instance ToJSON IPv6
+instance FromJSON IPv6
+
+instance Storable IPv6 where
+    sizeOf _    = 16
+    alignment _ = 4
+    peek p      = fmap IPv6 (peekArray 16 (castPtr p))
+    poke p (IPv6 xs) = pokeArray (castPtr p) (take 16 (xs ++ repeat 0))
+
+
+-- | CIDR6 data-type
+
+newtype CIDR6 = CIDR6 { getNetworkPair6 :: (IPv6, Int) } deriving (Generic, Typeable)
+
+
+instance Show CIDR6 where
+    show (CIDR6 (addr,prefix)) = show addr ++ "/" ++ show prefix
+
+instance IsString CIDR6 where
+  fromString xs = CIDR6 (fromString addr, read $ tail prefix)
+    where (addr, prefix) = if isJust slash
+                            then splitAt (fromJust slash) xs
+                            else error "CIDR6: bad format (slash missing)"
+          slash = elemIndex '/' xs
+
+instance ToJSON CIDR6
+instance FromJSON CIDR6
+
+-- layout of the kernel struct CIDR6: struct in6_addr addr; int prefix.
+
+instance Storable CIDR6 where
+    sizeOf _    = 20
+    alignment _ = 4
+    peek p      = do
+        a <- peekByteOff p 0
+        n <- peekByteOff p 16 :: IO CInt
+        return $ CIDR6 (a, fromIntegral n)
+    poke p (CIDR6 (a, n)) = pokeByteOff p 0 a >> pokeByteOff p 16 (fromIntegral n :: CInt)
+
+
 -- Thread-safe utility functions for IPv4 conversion to String and viceversa
 
 inetAtoN :: String -> IO IPv4
@@ -129,6 +185,27 @@ inetNtoA (IPv4 h) =
     peekCString str
 
 
+-- Thread-safe utility functions for IPv6 conversion to String and viceversa
+
+inet6AtoN :: String -> IO IPv6
+inet6AtoN xs =
+  withCString xs $ \str ->
+    allocaBytes 16 $ \addr -> do
+      r <- inet_pton (packFamily AF_INET6) str addr
+      when (r /= 1) $ error "inet6AtoN: bad address format"
+      fmap IPv6 (peekArray 16 (castPtr addr))
+
+
+inet6NtoA :: IPv6 -> IO String
+inet6NtoA (IPv6 xs) =
+  allocaArray 16 $ \ptr -> do
+  pokeArray ptr (take 16 (xs ++ repeat (0 :: Word8)))
+  allocaBytes 46 $ \str -> do
+    p <- inet_ntop (packFamily AF_INET6) (castPtr ptr) str 46
+    when (p == nullPtr) $ error "inet6NtoA: bad IPv6 format"
+    peekCString str
+
+
 -- FFI network functions:
 
 foreign import ccall unsafe "inet_ntop"
@@ -1121,8 +1121,8 @@ pfq_read_linux(pcap_t *handle, int max_packets, pcap_handler callback, u_char *u
 
 		h = (struct pfq_pkthdr *)pfq_pkt_header(it);
 
-		pcap_h.ts.tv_sec  = h->tstamp.tv.sec;
-		pcap_h.ts.tv_usec = h->tstamp.tv.nsec / 1000;
+		pcap_h.ts.tv_sec  = PFQ_PKTHDR_TSTAMP_SEC(h);
+		pcap_h.ts.tv_usec = PFQ_PKTHDR_TSTAMP_NSEC(h) / 1000;
 		pcap_h.caplen     = h->caplen;
 		pcap_h.len        = h->len;
 
@@ -0,0 +1,151 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <utility>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/bpf.h>
+
+#include <pfq/pfq.hpp>
+
+// load a socket filter that returns the given constant
+
+static int
+load_ebpf(int ret)
+{
+    struct bpf_insn prog[] = {
+        { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, ret },
+        { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 }
+    };
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+    attr.insns     = reinterpret_cast<uint64_t>(prog);
+    attr.insn_cnt  = sizeof(prog)/sizeof(prog[0]);
+    attr.license   = reinterpret_cast<uint64_t>("GPL");
+
+    int fd = static_cast<int>(syscall(__NR_bpf, BPF_PROG_LOAD, &attr, sizeof(attr)));
+    if (fd < 0)
+        throw std::runtime_error("BPF_PROG_LOAD: " + std::string(strerror(errno)));
+
+    return fd;
+}
+
+
+// send n UDP datagrams over the loopback
+
+static void
+send_loopback(int n)
+{
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("socket: " + std::string(strerror(errno)));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(9);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    char msg[64] = { 0 };
+
+    for(int i = 0; i < n; i++)
+        sendto(fd, msg, sizeof(msg), 0, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+
+    close(fd);
+}
+
+
+// run the loopback traffic through an eBPF program returning ret, in the given mode:
+// return the packets dropped by the group and those received by the socket
+
+static std::pair<unsigned long, unsigned long>
+run_loopback(int ret, int mode, int n)
+{
+    pfq::socket q(128);
+
+    q.bind("lo", pfq::any_queue);
+
+    int fd = load_ebpf(ret);
+    q.set_group_ebpf(q.group_id(), fd, mode);
+    close(fd);
+
+    auto before = q.group_stats(q.group_id());
+
+    send_loopback(n);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    auto after = q.group_stats(q.group_id());
+
+    return std::make_pair(after.drop - before.drop, q.stats().recv);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+        throw std::runtime_error(std::string("usage: ").append(argv[0]).append(" dev"));
+
+    pfq::socket r(128);
+
+    r.bind(argv[1], pfq::any_queue);
+
+    r.timestamping_enable(true);
+
+    int modes[] = { Q_EBPF_FILTER, Q_EBPF_STEER, Q_EBPF_CLASS };
+
+    for(auto mode : modes)
+    {
+        int fd = load_ebpf(1);
+
+        r.set_group_ebpf(r.group_id(), fd, mode);
+
+        close(fd);
+
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        r.reset_group_ebpf(r.group_id());
+    }
+
+    // an invalid mode must be rejected...
+
+    int fd = load_ebpf(1);
+
+    try {
+        r.set_group_ebpf(r.group_id(), fd, 42);
+        throw std::runtime_error("set_group_ebpf: invalid mode accepted!");
+    }
+    catch(pfq::system_error &) { }
+
+    close(fd);
+
+    // the programs filter the traffic of the group...
+
+    const int n = 100;
+
+    for(auto mode : modes)
+    {
+        auto drop = run_loopback(0, mode, n);
+        if (drop.first < n || drop.second != 0)
+            throw std::runtime_error("eBPF mode " + std::to_string(mode) + ": packets not dropped (drop=" +
+                                     std::to_string(drop.first) + " recv=" + std::to_string(drop.second) + ")");
+
+        auto pass = run_loopback(1, mode, n);
+        if (pass.first != 0 || pass.second < n)
+            throw std::runtime_error("eBPF mode " + std::to_string(mode) + ": packets not accepted (drop=" +
+                                     std::to_string(pass.first) + " recv=" + std::to_string(pass.second) + ")");
+    }
+
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <memory>
+#include <cstdlib>
 
 #include <pfq/pfq.hpp>
 #include <pfq/lang/default.hpp>
@@ -17,6 +19,43 @@ check_computation(pfq::socket &q, Comp comp)
 }
 
 
+// filter over a chain of 'and' nodes that share their operands: the code
+// emitted for the predicate doubles at each level and overflows the code
+// buffer, so the engine falls back to the tree evaluation.
+
+void
+check_computation_overflow(pfq::socket &q, size_t levels)
+{
+    const size_t size = levels + 2;
+
+    std::unique_ptr<pfq_lang_computation_descr, decltype(free) *> prg (
+        reinterpret_cast<pfq_lang_computation_descr *>(::calloc(1, sizeof(size_t) * 2 + sizeof(pfq_lang_functional_descr) * size)),
+        free);
+
+    prg->size = size;
+    prg->entry_point = 0;
+
+    for(size_t n = 0; n < size; n++)
+        prg->fun[n].next = -1;
+
+    prg->fun[0].symbol = "filter";
+    prg->fun[0].arg[0] = { nullptr, 1, -1 };
+
+    for(size_t n = 1; n <= levels; n++)
+    {
+        prg->fun[n].symbol = "and";
+        prg->fun[n].arg[0] = { nullptr, n+1, -1 };
+        prg->fun[n].arg[1] = { nullptr, n+1, -1 };
+    }
+
+    prg->fun[size-1].symbol = "is_ip";
+
+    std::cout << "filter (is_ip & is_ip & ...) [" << levels << " shared levels]" << std::endl;
+
+    q.set_group_computation(q.group_id(), prg.get());
+}
+
+
 int
 main()
 {
@@ -31,6 +70,22 @@ main()
     check_computation(q, filter(is_tcp ^ has_mark(11) ));
     check_computation(q, filter(is_ip & ( is_tcp | is_udp) ));
 
+    // short-circuit jumps:
+
+    check_computation(q, filter(is_ip & is_tcp & has_port(80) ));
+    check_computation(q, filter(is_udp | is_tcp | is_icmp ));
+    check_computation(q, filter((is_ip & is_tcp) | (is_ip6 & is_udp) ));
+    check_computation(q, filter(not_(is_tcp & has_port(22)) ));
+    check_computation(q, filter(is_ip & not_(is_udp | is_icmp) ));
+
+    // IPv6 predicates:
+
+    check_computation(q, filter(is_ip6));
+    check_computation(q, filter(is_icmp6));
+    check_computation(q, filter(has_addr6(CIDR6{"2001:db8::", 32}) ));
+    check_computation(q, filter(has_src_addr6("2001:db8::/32") & has_dst_addr6("fe80::/10") ));
+    check_computation(q, filter(bloom6(1024, {"2001:db8::1", "2001:db8::2"}, 128) ));
+
     // computations:
 
     check_computation(q, ip >> udp >> inc(2) );
@@ -38,6 +93,30 @@ main()
     check_computation(q, unless (is_ip, ip >> double_steer_ip) );
     check_computation(q, conditional (is_ip, double_steer_ip, drop  ) );
 
+    // when/unless/conditional lowering:
+
+    check_computation(q, when   (is_ip & is_tcp, ip >> steer_flow) >> inc(1) );
+    check_computation(q, unless (is_ip | is_ip6, drop) >> inc(1) );
+    check_computation(q, conditional (is_ip, steer_flow, conditional (is_ip6, steer_local_ip6("2001:db8::/32"), drop)) );
+    check_computation(q, conditional (is_tcp, when (has_port(80), inc(1)), unless (is_udp, drop)) >> kernel );
+
+    // IPv6 functions:
+
+    check_computation(q, ip6 >> icmp6 >> inc(1) );
+    check_computation(q, addr6("2001:db8::/32") >> src_addr6("2001:db8::/32") >> dst_addr6("fe80::/10") );
+    check_computation(q, steer_local_ip6("2001:db8::/32") );
+    check_computation(q, bloom6_filter(1024, {"2001:db8::1", "2001:db8::2"}, 64) );
+
+    // flow steering:
+
+    check_computation(q, steer_flow_hash(Q_STEER_HASH_XOR) );
+    check_computation(q, steer_flow_hash(Q_STEER_HASH_TOEPLITZ) );
+    check_computation(q, ip >> steer_flow_hash(Q_STEER_HASH_MIX) );
+
+    // code buffer overflow (fallback to the tree evaluation):
+
+    check_computation_overflow(q, 8);
+
     return 0;
 }
 
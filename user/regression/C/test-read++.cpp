@@ -35,10 +35,10 @@ main(int argc, char *argv[])
 
             auto h = *it;
 
-            printf("mark:%d state:0x%x caplen:%d len:%d ifindex:%d hw_queue:%d tstamp: %u:%u [commit:%d]-> ",
+            printf("mark:%d state:0x%x caplen:%d len:%d ifindex:%d hw_queue:%d tstamp: %llu:%09llu [commit:%d]-> ",
 					h.info.data.mark, h.info.data.state,
 				    h.caplen, h.len, h.info.ifindex, h.info.queue,
-                    h.tstamp.tv.sec, h.tstamp.tv.nsec, h.info.commit);
+                    (unsigned long long)PFQ_PKTHDR_TSTAMP_SEC(&h), (unsigned long long)PFQ_PKTHDR_TSTAMP_NSEC(&h), h.info.commit);
 
 			const char *buff = static_cast<char *>(it.data());
 
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <pfq/pfq.h>
+
+/* packed Rx slots across many queue swaps: the loopback carries datagrams of
+ * mixed sizes whose payload is made of small 32-bit words (the values of the
+ * queue versions), so that a stale commit left in a previous round would be
+ * taken for a committed header. The reader must never hang nor walk garbage. */
+
+#define SWAPS		4096
+#define CAPLEN		256
+
+static void
+sender(void)
+{
+	struct sockaddr_in addr;
+	uint32_t msg[1400/4];
+	unsigned int n;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		exit(1);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(9);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	for(n = 0;; n++)
+	{
+		size_t x, len = 4 + (n * 7919) % sizeof(msg);
+
+		for(x = 0; x < len/4; x++)
+			msg[x] = (uint32_t)((n + x) & 0xff);
+
+		sendto(fd, msg, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+
+		if ((n % 64) == 0)
+			usleep(100);
+	}
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	const char *dev = argc > 1 ? argv[1] : "lo";
+	size_t swaps = 0, packets = 0;
+	pid_t pid;
+
+	pfq_t *p = pfq_open(CAPLEN, 256, 64, 1024);
+	if (p == NULL) {
+		printf("error: %s\n", pfq_error(p));
+		return -1;
+	}
+
+	if (pfq_set_rx_packed(p, 1) < 0 || pfq_enable(p) < 0 ||
+	    pfq_bind(p, dev, Q_ANY_QUEUE) < 0) {
+		printf("error: %s\n", pfq_error(p));
+		return -1;
+	}
+
+	pid = fork();
+	if (pid == 0)
+		sender();
+
+	/* a reader waiting on a commit that never comes is killed by the alarm */
+
+	alarm(120);
+
+	printf("reading %d swaps from %s (packed slots)...\n", SWAPS, dev);
+
+	while (swaps < SWAPS)
+	{
+		struct pfq_net_queue nq;
+		pfq_iterator_t it, it_e;
+		size_t n = 0, bytes = 0;
+
+		if (pfq_read(p, &nq, 100000) < 0) {
+			printf("error: %s\n", pfq_error(p));
+			break;
+		}
+
+		if (nq.len == 0) {
+			pfq_yield();
+			continue;
+		}
+
+		it = pfq_net_queue_begin(&nq);
+		it_e = pfq_net_queue_end(&nq);
+
+		for(; it < it_e; it = pfq_net_queue_next(&nq, it), n++)
+		{
+			const struct pfq_pkthdr *h = pfq_pkt_header(it);
+
+			while (!pfq_pkt_ready(&nq, it))
+				pfq_yield();
+
+			if (h->caplen > CAPLEN || h->caplen > h->len) {
+				printf("error: swap %zu packet %zu: bad header (caplen:%d len:%d)!\n",
+				       swaps, n, h->caplen, h->len);
+				goto fail;
+			}
+
+			bytes += PFQ_SHARED_QUEUE_PKTHDR_STRIDE(h);
+		}
+
+		if (n != nq.len || bytes != nq.bytes) {
+			printf("error: swap %zu: walked %zu packets/%zu bytes (queue %zu/%zu)!\n",
+			       swaps, n, bytes, nq.len, nq.bytes);
+			goto fail;
+		}
+
+		packets += nq.len;
+		swaps++;
+	}
+
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+
+	printf("%zu swaps, %zu packets: ok\n", swaps, packets);
+	pfq_close(p);
+	return 0;
+
+fail:
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	pfq_close(p);
+	return -1;
+}
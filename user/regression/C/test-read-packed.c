@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pfq/pfq.h>
+
+#define MIN(a,b) (a < b ? a : b)
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s dev\n", argv[0]);
+		return 0;
+	}
+
+	pfq_t *p = pfq_open(64, 4096, 64, 1024);
+	if (p == NULL) {
+		printf("error: %s\n", pfq_error(p));
+		return -1;
+	}
+
+	if (pfq_set_rx_packed(p, 1) < 0) {
+		printf("error: %s\n", pfq_error(p));
+		return -1;
+	}
+
+	if (pfq_enable(p) < 0) {
+		printf("error: %s\n", pfq_error(p));
+		return -1;
+	}
+
+	if (pfq_get_rx_packed(p) != 1) {
+		printf("error: packed Rx slots not enabled!\n");
+		return -1;
+	}
+
+	if (pfq_bind(p, argv[1], Q_ANY_QUEUE) < 0) {
+		printf("error: %s\n", pfq_error(p));
+		return -1;
+	}
+
+	printf("reading from %s (packed slots)...\n", argv[1]);
+
+	for(;;) {
+
+		struct pfq_net_queue nq;
+		pfq_iterator_t it, it_e;
+		size_t n = 0;
+
+		int many = pfq_read(p, &nq, 1000000);
+		if (many < 0) {
+			printf("error: %s\n", pfq_error(p));
+			break;
+		}
+
+		if (nq.len == 0) {
+			pfq_yield();
+			continue;
+		}
+
+		if (nq.slot_size != 0) {
+			printf("error: packed queue with slot size %zu!\n", nq.slot_size);
+			return -1;
+		}
+
+		printf("queue size: %zd bytes: %zu\n", nq.len, nq.bytes);
+
+		it = pfq_net_queue_begin(&nq);
+		it_e = pfq_net_queue_end(&nq);
+
+		/* the packets are back-to-back: the strides must add up to the bytes of the queue */
+
+		for(; it < it_e; it = pfq_net_queue_next(&nq, it), n++)
+		{
+			int x;
+
+			while (!pfq_pkt_ready(&nq, it))
+				pfq_yield();
+
+			const struct pfq_pkthdr *h = pfq_pkt_header(it);
+
+			if ((size_t)(it - pfq_net_queue_begin(&nq)) % PFQ_SLOT_ALIGNMENT) {
+				printf("error: packet %zu: misaligned slot!\n", n);
+				return -1;
+			}
+
+			printf("caplen:%d len:%d stride:%zu -> ", h->caplen, h->len,
+			       (size_t)PFQ_SHARED_QUEUE_PKTHDR_STRIDE(h));
+
+			const char *buff = pfq_pkt_data(it);
+
+			for(x=0; x < MIN(h->caplen, 34); x++)
+			{
+				printf("%2x ", (unsigned char)buff[x]);
+			}
+			printf("\n");
+		}
+
+		if (it != it_e || n != nq.len) {
+			printf("error: walked %zu packets (queue size %zu)!\n", n, nq.len);
+			return -1;
+		}
+	}
+
+	pfq_close(p);
+	return 0;
+}
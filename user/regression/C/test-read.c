@@ -67,9 +67,9 @@ main(int argc, char *argv[])
 
 			const struct pfq_pkthdr *h = pfq_pkt_header(it);
 
-			printf("caplen:%d len:%d ifindex:%d hw_queue:%d tstamp: %u:%u -> ",
+			printf("caplen:%d len:%d ifindex:%d hw_queue:%d tstamp: %llu:%09llu -> ",
 					h->caplen, h->len, h->info.ifindex, h->info.queue,
-                                        h->tstamp.tv.sec, h->tstamp.tv.nsec);
+                                        (unsigned long long)PFQ_PKTHDR_TSTAMP_SEC(h), (unsigned long long)PFQ_PKTHDR_TSTAMP_NSEC(h));
 
 			const char *buff = pfq_pkt_data(it);
 
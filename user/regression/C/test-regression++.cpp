@@ -229,6 +229,27 @@ auto g = Group("PFQ")
     })
 
 
+    .Single("unbind_device_from_any", []
+    {
+        pfq::socket x(pfq::group_policy::shared, 64);
+
+        // a group bound to any device cannot be unbound from a single one...
+
+        x.bind("any");
+        AssertThrow(x.unbind(DEV.c_str()));
+        AssertThrow(x.unbind(DEV.c_str(), 0));
+        x.unbind("any");
+
+        x.bind("any", 0);
+        AssertThrow(x.unbind(DEV.c_str(), 0));
+        x.unbind("any", 0);
+
+        x.bind(DEV.c_str());
+        x.unbind(DEV.c_str(), 0);
+        x.unbind(DEV.c_str());
+    })
+
+
     .Single("poll", []
     {
         pfq::socket x;
@@ -35,10 +35,10 @@ main(int argc, char *argv[])
             {
                     while(!it.ready());
 
-                    printf("vlan_vid:%d vlan_prio:%d caplen:%d len:%d ifindex:%d hw_queue:%d tstamp: %u:%u -> ",
+                    printf("vlan_vid:%d vlan_prio:%d caplen:%d len:%d ifindex:%d hw_queue:%d tstamp: %llu:%09llu -> ",
                            it->info.vlan.vid, it->info.vlan.prio,
                            it->caplen, it->len, it->info.ifindex, it->info.queue,
-                                it->tstamp.tv.sec, it->tstamp.tv.nsec);
+                                (unsigned long long)PFQ_PKTHDR_TSTAMP_SEC(&*it), (unsigned long long)PFQ_PKTHDR_TSTAMP_NSEC(&*it));
                     char *buff = static_cast<char *>(it.data());
 
                     for(int x=0; x < std::min<int>(it->caplen, 18); x++)
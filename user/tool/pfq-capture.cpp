@@ -223,12 +223,12 @@ namespace thread
                         const unsigned char *buff = static_cast<unsigned char *>(it.data());
 
                         if (m_file)
-                            pcap_write_(buff, h.len, h.caplen, h.tstamp.tv.sec, h.tstamp.tv.nsec/1000);
+                            pcap_write_(buff, h.len, h.caplen, static_cast<uint32_t>(PFQ_PKTHDR_TSTAMP_SEC(&h)), static_cast<uint32_t>(PFQ_PKTHDR_TSTAMP_NSEC(&h)/1000));
 
                         if (opt::dump) {
-                            printf("%d:%d [%d] (%d/%d)",
-                                            h.tstamp.tv.sec,
-                                            h.tstamp.tv.nsec,
+                            printf("%llu:%09llu [%d] (%d/%d)",
+                                            (unsigned long long)PFQ_PKTHDR_TSTAMP_SEC(&h),
+                                            (unsigned long long)PFQ_PKTHDR_TSTAMP_NSEC(&h),
                                             h.info.ifindex,
                                             h.caplen,
                                             h.len);
@@ -584,7 +584,7 @@ try
         std::cout << "*** Warning: HugePages not mounted ***" << std::endl;
 
     unsigned long long sum, flow, old = 0;
-    pfq_stats sum_stats, old_stats = {0,0,0,0,0,0,0,0};
+    pfq_stats sum_stats, old_stats = {};
 
     signal(SIGINT, sighandler);
 
@@ -606,7 +606,7 @@ try
 
         sum = 0;
         flow = 0;
-        sum_stats = {0,0,0,0,0,0,0,0};
+        sum_stats = {};
 
         std::for_each(thread_ctx.begin(), thread_ctx.end(), [&](const thread::context *c) {
             sum += c->read();
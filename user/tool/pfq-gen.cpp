@@ -129,6 +129,7 @@ namespace opt
     bool   poisson     = false;
     bool   interactive = false;
     bool   checksum    = false;
+    bool   kernel_rate = false;
 
     double rate = 0;
 
@@ -268,6 +269,12 @@ namespace thread
                 std::cout << x  << ' ';
             std::cout << "}" << std::endl;
 
+            // map as many async Tx queues as the bindings to the kthreads
+            //
+            auto nasync = std::count_if(kthread.begin(), kthread.end(), [](int t) { return t >= 0; });
+            if (nasync > Q_DEF_TX_QUEUES)
+                q.tx_queues(static_cast<size_t>(nasync));
+
             for(unsigned int n = 0; n < m_bind.dev.front().queue.size(); n++)
             {
                 std::cout << "tx_bind    : " << m_bind.dev.front().name << ':' << m_bind.dev.front().queue[n];
@@ -279,6 +286,18 @@ namespace thread
                 q.bind_tx (m_bind.dev.front().name.c_str(), m_bind.dev.front().queue[n], kthread.at(n));
             }
 
+            // shape the Tx queues in kernel, splitting the rate among them
+            //
+            if (opt::kernel_rate && opt::rate != 0.0)
+            {
+                auto nq  = m_bind.dev.front().queue.size();
+                auto pps = static_cast<unsigned long>(opt::rate * 1000000 / nq);
+                int  async = 0;
+
+                for(unsigned int n = 0; n < nq; n++)
+                    q.set_tx_rate(kthread.at(n) >= 0 ? async++ : pfq::no_kthread, pps);
+            }
+
             m_pfq = std::move(q);
         }
 
@@ -321,7 +340,7 @@ namespace thread
         std::tuple<pfq_stats, uint64_t, uint64_t, uint64_t, uint64_t>
         stats() const
         {
-            pfq_stats ret = {0,0,0,0,0,0,0,0};
+            pfq_stats ret = {};
 
             ret += m_pfq.stats();
 
@@ -348,7 +367,7 @@ namespace thread
             auto now   = std::chrono::system_clock::now();
             auto len   = opt::len;
 
-            auto rc = opt::rate != 0.0;
+            auto rc = opt::rate != 0.0 && !opt::kernel_rate;
 
             uint32_t rand_mask = ((1ULL << opt::rand_depth)-1);
 
@@ -414,7 +433,7 @@ namespace thread
 
             size_t idx = 0;
 
-            auto rc = opt::rate != 0.0;
+            auto rc = opt::rate != 0.0 && !opt::kernel_rate;
 
             for(size_t n = 0; n < opt::npackets;)
             {
@@ -544,7 +563,7 @@ namespace thread
             struct pcap_pkthdr *hdr;
             u_char *data;
 
-            auto rc = opt::rate != 0.0;
+            auto rc = opt::rate != 0.0 && !opt::kernel_rate;
             uint32_t rand_mask = ((1ULL << opt::rand_depth)-1);
             auto rand_flow_mask = ((1ULL << opt::rand_flow_depth)-1);
 
@@ -704,6 +723,7 @@ void usage(std::string name)
         "    --rate DOUBLE              Packet rate in Mpps\n"
         "    --interactive              Transmit a packet at time\n"
         " -a --active-tstamp            Use active timestamp as rate control\n"
+        "    --kernel-rate              Enforce the rate with the kernel token bucket of the Tx queues\n"
         " -p --poisson                  Use a Poisson process for inter-packet gaps, implies -a\n"
         " -S --queue-sync INT           Set queue sync value, used to Tx sync\n"
         " -t --thread BINDING\n\n"
@@ -994,6 +1014,12 @@ try
             continue;
         }
 
+        if ( any_strcmp(argv[i], "--kernel-rate") )
+        {
+            opt::kernel_rate = true;
+            continue;
+        }
+
         if ( any_strcmp(argv[i], "-p", "--poisson") )
         {
             opt::poisson = true;
@@ -1117,7 +1143,7 @@ try
     std::cout << "copies     : "  << opt::copies << std::endl;
 
     if (opt::rate != 0.0)
-        std::cout << "rate       : "  << opt::rate << " Mpps" << std::endl;
+        std::cout << "rate       : "  << opt::rate << " Mpps" << (opt::kernel_rate ? " (kernel)" : "") << std::endl;
 
     if (opt::active_ts && !opt::poisson)
         std::cout << "timestamp  : active!" << std::endl;
@@ -1159,7 +1185,7 @@ try
         t->detach();
     });
 
-    pfq_stats cur, prec = {0,0,0,0,0,0,0,0};
+    pfq_stats cur, prec = {};
 
     uint64_t sent, sent_ = 0;
     uint64_t band, band_ = 0;
@@ -1176,7 +1202,7 @@ try
     {
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
-        cur = {0,0,0,0,0,0,0,0};
+        cur = {};
         sent = 0;
         band = 0;
         gros = 0;
@@ -1232,7 +1258,7 @@ try
     std::cout << "Shutting down sockets in 1 sec..." << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
-    cur  = {0,0,0,0,0,0,0,0};
+    cur  = {};
     sent = 0;
 
     std::for_each(thread_ctx.begin(), thread_ctx.end(), [&](const thread::context *c)